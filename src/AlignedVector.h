@@ -9,16 +9,145 @@
 // at your option. This file may not be copied, modified, or distributed
 // except according to those terms.
 
+
 #ifndef ALIGNEDVECTOR_H
 #define ALIGNEDVECTOR_H
 
 #include <algorithm>
 #include <cstring>
+#include <new>
+#include <vector>
 #ifdef __linux
 #include <cstdlib>
+#elif defined _WIN32
+#include <malloc.h>
 #endif
 
-//Really inefficient vector container that guarantees the data is 32-byte aligned.
+//Source of 32-byte aligned float storage for AlignedVector.
+class AlignedAllocator
+{
+	public:
+		static constexpr unsigned int ALIGNMENT = 32;
+		static constexpr unsigned int ALIGNMENT_FLOATS = ALIGNMENT / sizeof(float);
+
+		virtual ~AlignedAllocator()
+		{
+		}
+
+		virtual float* Allocate(const unsigned int count) = 0;
+		virtual void Free(float* data,const unsigned int count) = 0;
+
+		static AlignedAllocator& Heap(); //Every allocation is its own heap block.
+};
+
+class AlignedHeapAllocator : public AlignedAllocator
+{
+	public:
+		float* Allocate(const unsigned int count) override
+		{
+			float* data = nullptr;
+#ifdef __linux
+			if(posix_memalign(reinterpret_cast<void**>(&data),ALIGNMENT,std::max(count,1u) * sizeof(float)) != 0)
+				data = nullptr;
+#elif defined _WIN32
+			data = reinterpret_cast<float*>(_aligned_malloc(std::max(count,1u) * sizeof(float),ALIGNMENT));
+#else
+#error Platform not supported.
+#endif
+			return data;
+		}
+		void Free(float* data,const unsigned int) override
+		{
+#ifdef __linux
+			::free(data);
+#elif defined _WIN32
+			_aligned_free(data);
+#else
+#error Platform not supported.
+#endif
+		}
+};
+
+inline AlignedAllocator& AlignedAllocator::Heap()
+{
+	static AlignedHeapAllocator allocator;
+	return allocator;
+}
+
+//Hands out blocks back to back from large slabs and releases them all at once when destroyed. Lots
+//of small buffers that live and die together, like training samples, then cost one heap block per
+//slab instead of one each. Freeing a block only gives the space back if it was the last one handed
+//out so reserve() the final size up front instead of growing a vector in place. Not thread safe.
+//Vectors using an arena must not outlive it.
+class AlignedArena : public AlignedAllocator
+{
+	public:
+		static constexpr unsigned int DEFAULT_SLAB_SIZE = 1024 * 1024; //4MB of floats.
+
+		AlignedArena(const unsigned int slabSize = DEFAULT_SLAB_SIZE)
+			: slabs(),
+			  slabSize(slabSize),
+			  next(nullptr),
+			  remaining(0)
+		{
+		}
+		~AlignedArena() override
+		{
+			for(float* slab : slabs)
+			{
+				Heap().Free(slab,0);
+			}
+		}
+
+		float* Allocate(const unsigned int count) override
+		{
+			const unsigned int alignedCount = AlignedCount(count);
+			if(alignedCount > remaining)
+			{
+				//Whatever is left of the current slab is abandoned.
+				const unsigned int newSlabSize = std::max(alignedCount,slabSize);
+				float* slab = Heap().Allocate(newSlabSize);
+				if(slab == nullptr)
+					return nullptr;
+				slabs.push_back(slab);
+				next = slab;
+				remaining = newSlabSize;
+			}
+
+			float* data = next;
+			next += alignedCount;
+			remaining -= alignedCount;
+			return data;
+		}
+		void Free(float* data,const unsigned int count) override
+		{
+			const unsigned int alignedCount = AlignedCount(count);
+			if(data + alignedCount == next)
+			{
+				next = data;
+				remaining += alignedCount;
+			}
+		}
+	private:
+		std::vector<float*> slabs;
+		unsigned int slabSize;
+		float* next;
+		unsigned int remaining;
+
+		static unsigned int AlignedCount(const unsigned int count)
+		{
+			return (std::max(count,1u) + ALIGNMENT_FLOATS - 1) / ALIGNMENT_FLOATS * ALIGNMENT_FLOATS;
+		}
+
+		AlignedArena(const AlignedArena&)=delete;
+		AlignedArena& operator=(AlignedArena&)=delete;
+};
+
+//Vector of floats that guarantees the data is 32-byte aligned. Capacity grows geometrically so
+//building one a value at a time is linear. Storage comes from the heap unless an allocator is
+//given. Copies always use the heap so they can outlive the original's allocator. Elements added by
+//resize() are uninitialized. Throws std::bad_alloc when out of memory. Moves never throw so
+//std::vector moves, rather than copies, them when it grows.
 class AlignedVector
 {
 	public:
@@ -27,31 +156,42 @@ class AlignedVector
 
 		AlignedVector()
 			: data(nullptr),
-			  dataSize(0)
+			  dataSize(0),
+			  dataCapacity(0),
+			  allocator(&AlignedAllocator::Heap())
+		{
+		}
+		explicit AlignedVector(AlignedAllocator& allocator)
+			: data(nullptr),
+			  dataSize(0),
+			  dataCapacity(0),
+			  allocator(&allocator)
 		{
 		}
-		AlignedVector(const unsigned int size,const float value)
+		AlignedVector(const unsigned int size,const float value,AlignedAllocator& allocator = AlignedAllocator::Heap())
 			: data(nullptr),
-			  dataSize(0)
+			  dataSize(0),
+			  dataCapacity(0),
+			  allocator(&allocator)
 		{
 			resize(size);
-			for(unsigned int x = 0;x < size;x++)
-			{
-				data[x] = value;
-			}
+			std::fill(data,data + size,value);
 		}
 		AlignedVector(const AlignedVector& other)
 			: data(nullptr),
-			  dataSize(0)
+			  dataSize(0),
+			  dataCapacity(0),
+			  allocator(&AlignedAllocator::Heap())
 		{
 			copy(other);
 		}
-		AlignedVector(AlignedVector&& other)
+		AlignedVector(AlignedVector&& other) noexcept
 			: data(nullptr),
-			  dataSize(0)
+			  dataSize(0),
+			  dataCapacity(0),
+			  allocator(&AlignedAllocator::Heap())
 		{
-			std::swap(data,other.data);
-			std::swap(dataSize,other.dataSize);
+			swap(other);
 		}
 		~AlignedVector()
 		{
@@ -65,6 +205,12 @@ class AlignedVector
 			copy(other);
 			return *this;
 		}
+		AlignedVector& operator=(AlignedVector&& other) noexcept
+		{
+			//The old storage is released with other.
+			swap(other);
+			return *this;
+		}
 		float& operator[](const unsigned int index)
 		{
 			return data[index];
@@ -73,34 +219,46 @@ class AlignedVector
 		{
 			return data[index];
 		}
+		void reserve(const unsigned int newCapacity)
+		{
+			if(newCapacity > dataCapacity)
+				reallocate(newCapacity);
+		}
 		void resize(const unsigned int newSize)
 		{
-			if(newSize == dataSize)
-				return;
-
-			float* newData = nullptr;
-#ifdef __linux
-			posix_memalign(reinterpret_cast<void**>(&newData),32,newSize * sizeof(float));
-#elif defined _WIN32
-			newData = reinterpret_cast<float*>(_aligned_malloc(newSize * sizeof(float),32));
-#else
-#error Platform not supported.
-#endif
-			memcpy(newData,data,std::min(dataSize,newSize) * sizeof(float));
-			free();
-
-			data = newData;
+			reserve(newSize);
 			dataSize = newSize;
 		}
 		void push_back(const float value)
 		{
-			resize(dataSize + 1);
-			data[dataSize - 1] = value;
+			if(dataSize == dataCapacity)
+				reallocate(dataCapacity != 0 ? dataCapacity * 2 : AlignedAllocator::ALIGNMENT_FLOATS);
+			data[dataSize] = value;
+			dataSize += 1;
+		}
+		void clear()
+		{
+			dataSize = 0;
+		}
+		void swap(AlignedVector& other) noexcept
+		{
+			std::swap(data,other.data);
+			std::swap(dataSize,other.dataSize);
+			std::swap(dataCapacity,other.dataCapacity);
+			std::swap(allocator,other.allocator);
 		}
 		unsigned int size() const
 		{
 			return dataSize;
 		}
+		unsigned int capacity() const
+		{
+			return dataCapacity;
+		}
+		bool empty() const
+		{
+			return dataSize == 0;
+		}
 		float* begin() const
 		{
 			return data;
@@ -120,22 +278,35 @@ class AlignedVector
 	private:
 		float* data;
 		unsigned int dataSize;
+		unsigned int dataCapacity;
+		AlignedAllocator* allocator;
 
 		void copy(const AlignedVector& other)
 		{
 			resize(other.dataSize);
-			memcpy(data,other.data,dataSize * sizeof(float));
+			if(dataSize != 0)
+				memcpy(data,other.data,dataSize * sizeof(float));
 		}
-		void free()
+		void reallocate(const unsigned int newCapacity)
 		{
+			//Same as std::vector. The current storage is left as is.
+			float* newData = allocator->Allocate(newCapacity);
+			if(newData == nullptr)
+				throw std::bad_alloc();
 
-#ifdef __linux
-			::free(data);
-#elif defined _WIN32
-			_aligned_free(data);
-#else
-#error Platform not supported.
-#endif
+			if(dataSize != 0)
+				memcpy(newData,data,std::min(dataSize,newCapacity) * sizeof(float));
+			free();
+
+			data = newData;
+			dataCapacity = newCapacity;
+		}
+		void free()
+		{
+			if(data != nullptr)
+				allocator->Free(data,dataCapacity);
+			data = nullptr;
+			dataCapacity = 0;
 		}
 };
 
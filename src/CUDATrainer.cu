@@ -16,11 +16,10 @@
 #include <ctime>
 #include <cuda_runtime.h>
 #include <cuda.h>
+#include "CUDATrainer.h"
 #include "NeuralNetworkData.h"
 
 
-static const char* TRAINING_DATA_FILE_PATH = "training.dat";
-
 //CUDA block and thread counts here were manually tuned for a GTX 660.
 static const unsigned int PROCESS_NEURON_WEIGHTS_BLOCK_COUNT = 80;
 static const unsigned int PROCESS_NEURON_WEIGHTS_THREAD_COUNT = 128;
@@ -78,7 +77,7 @@ __global__ void UpdateOutputLayer(float* previousLayerOutput,float* layerOutput,
 	}
 }
 
-__global__ void UpdateHiddenLayer(float* previousLayerOutput,float* layerOutput,float* layerWeights,float* nextLayerWeights,float* layerErrors,float* nextLayerErrors,unsigned int neuronCount,unsigned int nextLayerNeuronCount,unsigned int weightCount)
+__global__ void UpdateHiddenLayer(float* previousLayerOutput,float* layerOutput,float* layerWeights,float* nextLayerWeights,float* layerErrors,float* nextLayerErrors,unsigned int neuronCount,unsigned int nextLayerNeuronCount,unsigned int nextLayerStride,unsigned int weightCount)
 {
 	__shared__ float sharedErrors[UPDATE_HIDDEN_LAYER_THREAD_COUNT];
 	for(unsigned int neuronIndex = blockIdx.x;neuronIndex < neuronCount;neuronIndex += gridDim.x)
@@ -86,7 +85,7 @@ __global__ void UpdateHiddenLayer(float* previousLayerOutput,float* layerOutput,
 		float error = 0.0f;
 		for(unsigned int x = threadIdx.x;x < nextLayerNeuronCount;x += blockDim.x)
 		{
-			error += nextLayerErrors[x] * nextLayerWeights[x * nextLayerNeuronCount + neuronIndex];
+			error += nextLayerErrors[x] * nextLayerWeights[x * nextLayerStride + neuronIndex];
 		}
 		sharedErrors[threadIdx.x] = error;
 		__syncthreads();
@@ -140,25 +139,29 @@ static void FetchWeightsFromGPU(const std::vector<float*>& deviceLayerWeights,Ne
 	for(unsigned int l = 0;l < nnData.layers.size();l++)
 	{
 		Layer& layer = nnData.layers[l];
-		assert(!layer.empty());
-		const unsigned int neuronSize = layer[0].size();
+		assert(layer.neuronCount != 0);
 
-		for(unsigned int x = 0;x < layer.size();x++)
-		{
-			const cudaError_t err = cudaMemcpy(&layer[x][0],&deviceLayerWeights[l][x * neuronSize],neuronSize * sizeof(float),cudaMemcpyDeviceToHost);
-			CheckCudaError(err);
-		}
+		const cudaError_t err = cudaMemcpy(&layer.weights[0],deviceLayerWeights[l],layer.weights.size() * sizeof(float),cudaMemcpyDeviceToHost);
+		CheckCudaError(err);
 	}
 }
 
-int main(int argc,char* argv[])
+bool CUDADeviceAvailable()
+{
+	int deviceCount = 0;
+	return cudaGetDeviceCount(&deviceCount) == cudaSuccess && deviceCount > 0;
+}
+
+int TrainWithCUDA(NeuralNetworkData& nnData,const std::function<void(const NeuralNetworkData&)>& saveCheckpoint)
 {
-	//Load existing neural network from file to resume with.
-	NeuralNetworkData nnData;
-	if(!nnData.LoadFromBinary(TRAINING_DATA_FILE_PATH))
+	//The kernels below only implement sigmoid.
+	for(const Layer& layer : nnData.layers)
 	{
-		std::cerr << "Could not load training data." << std::endl;
-		return -1;
+		if(layer.activation != Activation::Sigmoid)
+		{
+			std::cerr << "Only sigmoid activations can be trained with CUDA." << std::endl;
+			return -1;
+		}
 	}
 
 	cudaError_t err = cudaSuccess;
@@ -184,7 +187,7 @@ int main(int argc,char* argv[])
 	for(unsigned int x = 0;x < nnData.trainingData.size();x++)
 	{
 		float* deviceInput = nullptr;
-		err = cudaMalloc(reinterpret_cast<void**>(&deviceInput),nnData.layers[0][0].size() * sizeof(float));
+		err = cudaMalloc(reinterpret_cast<void**>(&deviceInput),nnData.layers[0].stride * sizeof(float));
 		CheckCudaError(err);
 		deviceTrainingInputs.push_back(deviceInput);
 
@@ -202,7 +205,7 @@ int main(int argc,char* argv[])
 		const Layer& layer = nnData.layers[x];
 
 		float* deviceWeights = nullptr;
-		err = cudaMalloc(reinterpret_cast<void**>(&deviceWeights),layer.size() * layer[0].size() * sizeof(float));
+		err = cudaMalloc(reinterpret_cast<void**>(&deviceWeights),layer.weights.size() * sizeof(float));
 		CheckCudaError(err);
 		deviceLayerWeights.push_back(deviceWeights);
 
@@ -220,7 +223,7 @@ int main(int argc,char* argv[])
 	//Transfer data to GPU.
 	for(unsigned int x = 0;x < nnData.trainingData.size();x++)
 	{
-		err = cudaMemcpy(deviceTrainingInputs[x],&nnData.trainingData[x].first[0],nnData.layers[0][0].size() * sizeof(float),cudaMemcpyHostToDevice);
+		err = cudaMemcpy(deviceTrainingInputs[x],&nnData.trainingData[x].first[0],nnData.layers[0].stride * sizeof(float),cudaMemcpyHostToDevice);
 		CheckCudaError(err);
 
 		AlignedVector expectedOutput;
@@ -231,20 +234,16 @@ int main(int argc,char* argv[])
 
 	for(unsigned int x = 0;x < nnData.layers.size();x++)
 	{
-		const std::vector<AlignedVector>& layer = nnData.layers[x];
-		const unsigned int spanSize = layer[0].size() * sizeof(float);
-		for(unsigned int y = 0;y < layer.size();y++)
-		{
-			err = cudaMemcpy(&deviceLayerWeights[x][y * layer[0].size()],&layer[y][0],spanSize,cudaMemcpyHostToDevice);
-			CheckCudaError(err);
-		}
+		const Layer& layer = nnData.layers[x];
+		err = cudaMemcpy(deviceLayerWeights[x],&layer.weights[0],layer.weights.size() * sizeof(float),cudaMemcpyHostToDevice);
+		CheckCudaError(err);
 
 		err = cudaMemcpy(deviceLayerOutputs[x],&nnData.layerOutputs[x][0],nnData.layerOutputs[x].size() * sizeof(float),cudaMemcpyHostToDevice);
 		CheckCudaError(err);
 	}
 
 	//Run kernels.
-	std::vector<float> outputErrors(nnData.layers.back().size());
+	std::vector<float> outputErrors(nnData.layers.back().neuronCount);
 	for(unsigned int x = 0;x < 1001;x++)
 	{
 		const auto startMS = Milliseconds();
@@ -254,8 +253,8 @@ int main(int argc,char* argv[])
 			//Perform forward pass.
 			for(unsigned int l = 0;l < nnData.layers.size();l++)
 			{
-				const unsigned int neuronCount = nnData.layers[l].size();
-				const unsigned int weightCount = nnData.layers[l][0].size();
+				const unsigned int neuronCount = nnData.layers[l].neuronCount;
+				const unsigned int weightCount = nnData.layers[l].stride;
 				float* inputValues = nullptr;
 				if(l == 0)
 					inputValues = deviceTrainingInputs[y];
@@ -276,8 +275,8 @@ int main(int argc,char* argv[])
 																									deviceExpectedOutputs[y],
 																									deviceLayerWeights.back(),
 																									deviceLayerErrors.back(),
-																									nnData.layers.back().size(),
-																									nnData.layers.back()[0].size());
+																									nnData.layers.back().neuronCount,
+																									nnData.layers.back().stride);
 			err = cudaGetLastError();
 			CheckCudaError(err);
 
@@ -295,9 +294,10 @@ int main(int argc,char* argv[])
 																										deviceLayerWeights[l + 1],
 																										deviceLayerErrors[l],
 																										deviceLayerErrors[l + 1],
-																										nnData.layers[l].size(),
-																										nnData.layers[l + 1].size(),
-																										nnData.layers[l][0].size());
+																										nnData.layers[l].neuronCount,
+																										nnData.layers[l + 1].neuronCount,
+																										nnData.layers[l + 1].stride,
+																										nnData.layers[l].stride);
 				err = cudaGetLastError();
 				CheckCudaError(err);
 			}
@@ -316,8 +316,8 @@ int main(int argc,char* argv[])
 		if(totalError < 1.0f || ((x % 100) == 0 && x != 0))
 		{
 			FetchWeightsFromGPU(deviceLayerWeights,nnData);
-			nnData.SaveAsBinary(TRAINING_DATA_FILE_PATH);
-			std::cout << "Saved." << std::endl;
+			saveCheckpoint(nnData);
+			std::cout << "Checkpointed." << std::endl;
 		}
 	}
 
@@ -0,0 +1,27 @@
+// Copyright 2017 James Bendig. See the COPYRIGHT file at the top-level
+// directory of this distribution.
+//
+// Licensed under:
+//   the MIT license
+//     <LICENSE-MIT or https://opensource.org/licenses/MIT>
+//   or the Apache License, Version 2.0
+//     <LICENSE-APACHE or https://www.apache.org/licenses/LICENSE-2.0>,
+// at your option. This file may not be copied, modified, or distributed
+// except according to those terms.
+
+
+#ifndef CUDATRAINER_H
+#define CUDATRAINER_H
+
+#include <functional>
+
+struct NeuralNetworkData;
+
+bool CUDADeviceAvailable();
+
+//Trains nnData on the first CUDA device by per-sample back propagation, handing the weights to
+//saveCheckpoint every 100 epochs. Only sigmoid layers are supported. Returns the exit code for
+//train_neural_network.
+int TrainWithCUDA(NeuralNetworkData& nnData,const std::function<void(const NeuralNetworkData&)>& saveCheckpoint);
+
+#endif
@@ -11,9 +11,24 @@
 
 #include "CachedPuzzleSolver.h"
 #include <algorithm>
-#include <numeric>
 #include "Solve.h"
 
+//Give up on a puzzle that takes longer than this. Real puzzles are solved in microseconds so
+//anything slower is almost certainly a bad OCR read.
+static constexpr std::chrono::milliseconds MAXIMUM_SOLVE_TIME(500);
+static constexpr unsigned long long MAXIMUM_SOLVE_NODES = 1000000;
+
+//Puzzles differing by fewer digits than this are assumed to be the same puzzle with OCR mistakes.
+static constexpr unsigned int NEAR_MATCH_DIGIT_COUNT = 4;
+static_assert(NEAR_MATCH_DIGIT_COUNT <= SolutionCache::CHUNK_COUNT,"Near matches must be found through the chunk index.");
+
+//Most puzzles waiting on or being solved at once. Once full, the oldest request is abandoned
+//because the camera has probably moved on from it.
+static constexpr unsigned int MAXIMUM_PENDING_REQUESTS = 16;
+
+//Most solutions kept around. A kiosk can run for days so the cache must not grow forever.
+static constexpr unsigned int SOLUTION_CACHE_CAPACITY = 4096;
+
 
 static Game DigitsToGame(const std::vector<unsigned char>& digits)
 {
@@ -30,24 +45,51 @@ static Game DigitsToGame(const std::vector<unsigned char>& digits)
 	return game;
 }
 
-static std::vector<unsigned char> GameToDigits(const Game& game)
+static PuzzleKey GameToPuzzleKey(const Game& game)
 {
-	std::vector<unsigned char> digits;
+	PuzzleKey key;
 	for(unsigned int y = 0;y < 9;y++)
 	{
 		for(unsigned int x = 0;x < 9;x++)
 		{
-			const unsigned char digit = game.Get(x,y);
-			digits.push_back(digit);
+			key.Set(y * 9 + x,game.Get(x,y));
 		}
 	}
 
-	return digits;
+	return key;
+}
+
+static std::optional<SolutionStore> OpenSolutionStore(const std::string& basePath)
+{
+	//Fall back to read-only when the store can't be written, such as when it's on a shared read-only
+	//mount or another process is writing to it. Without a store, puzzles are only cached in memory.
+	std::optional<SolutionStore> store = SolutionStore::Open(basePath,false);
+	if(store)
+		return store;
+	return SolutionStore::Open(basePath,true);
 }
 
 CachedPuzzleSolver::CachedPuzzleSolver()
-	: solvedPuzzles()
+	: solvedPuzzles(SOLUTION_CACHE_CAPACITY),
+	  solutionStore(),
+	  threadPool(std::max(ThreadPool::HardwareThreadCount() / 2,1u)) //Leave room for the video processing.
+{
+}
+
+CachedPuzzleSolver::CachedPuzzleSolver(const std::string& storeBasePath)
+	: solvedPuzzles(SOLUTION_CACHE_CAPACITY),
+	  solutionStore(OpenSolutionStore(storeBasePath)),
+	  threadPool(std::max(ThreadPool::HardwareThreadCount() / 2,1u))
+{
+}
+
+CachedPuzzleSolver::~CachedPuzzleSolver()
 {
+	//Don't wait on solves nobody needs anymore.
+	for(auto& request : pendingRequests)
+	{
+		request.second->cancelled = true;
+	}
 }
 
 bool CachedPuzzleSolver::Solve(const std::vector<unsigned char>& digits,std::vector<unsigned char>& solution)
@@ -57,15 +99,8 @@ bool CachedPuzzleSolver::Solve(const std::vector<unsigned char>& digits,std::vec
 	//solutions) AND the maximum number of recently used solutions has not been reached.
 	UpdateRecentlyUsedSolutions updateRecentlyUsedSolutions(recentlyUsedSolutions);
 
-	//Grab and cache results if a previous puzzle was solved since last call.
-	if(solvingFuture.valid() && solvingFuture.wait_for(std::chrono::seconds(0)) == std::future_status::ready)
-	{
-		if(solvingFuture.get())
-		{
-			//Cache solution to save time and so it can be used when requested later.
-			solvedPuzzles[solvingDigits] = {GameToDigits(solvingGame),0};
-		}
-	}
+	//Grab and cache results of puzzles solved since last call.
+	CollectFinishedRequests();
 
 	//Is this a valid puzzle?
 	if(digits.size() != 81)
@@ -79,81 +114,139 @@ bool CachedPuzzleSolver::Solve(const std::vector<unsigned char>& digits,std::vec
 	if(!Solvable(game))
 		return false;
 
-	//Does the puzzle have a solution that can be found in a reasonable amount of time?
-	const unsigned int nonZeroDigits = std::accumulate(digits.begin(),digits.end(),0,[](const unsigned char previous,const unsigned char digit) {
-		return previous + (digit > 0);
-	});
-	if(nonZeroDigits < 21)
-		return false;
-
 	//Has this puzzle already been solved once? Use the previous solution.
-	auto iter = solvedPuzzles.find(digits);
-	if(iter != solvedPuzzles.end())
+	const PuzzleKey puzzle(digits);
+	SolutionCache::Entry* entry = solvedPuzzles.Find(puzzle);
+	if(entry != nullptr)
 	{
-		solution = iter->second.digits;
+		solution = entry->solution.Digits();
 
-		updateRecentlyUsedSolutions.AddSolution(iter);
+		updateRecentlyUsedSolutions.AddSolution(entry);
 		return true;
 	}
 
-	//If the most common recently used solution is a near match, assume that's the solution we
-	//want. This just means one or more digits were OCR'd incorrectly.
-	SolutionMap::const_iterator mostRecentlyUsedSolution;
-	if(GetMostLikelySolution(mostRecentlyUsedSolution))
+	//Maybe it was solved during a previous run.
+	PuzzleKey storedSolution;
+	if(solutionStore && solutionStore->Find(puzzle,storedSolution))
 	{
-		unsigned int differentDigitCount = 0;
-		for(unsigned int x = 0;x < digits.size();x++)
-		{
-			if(digits[x] != mostRecentlyUsedSolution->first[x])
-				differentDigitCount += 1;
-		}
+		solution = storedSolution.Digits();
 
-		if(differentDigitCount < 4)
-		{
-			solution = mostRecentlyUsedSolution->second.digits;
-			return true;
-		}
+		entry = solvedPuzzles.Insert(puzzle,storedSolution);
+		if(entry != nullptr)
+			updateRecentlyUsedSolutions.AddSolution(entry);
+		return true;
 	}
 
-	//If a puzzle is currently being solved in the background, discard the requested solve attempt.
-	//New puzzles should be infrequent enough that there is no reason to queue them up. Finding the
-	//solution asynchronously prevents the video from locking the GUI.
-	if(solvingFuture.valid())
-		return false;
+	//If a previously solved puzzle is a near match, assume that's the solution we want. This just
+	//means one or more digits were OCR'd incorrectly.
+	entry = solvedPuzzles.FindNearest(puzzle,NEAR_MATCH_DIGIT_COUNT - 1);
+	if(entry != nullptr)
+	{
+		solution = entry->solution.Digits();
 
-	//Solve the puzzle in a background thread.
-	solvingDigits = digits;
-	solvingGame = game;
-	solvingFuture = std::async(std::launch::async,[this]() {
-		return ::Solve(solvingGame);
-	});
+		updateRecentlyUsedSolutions.AddSolution(entry);
+		return true;
+	}
+
+	//Solve the puzzle in the background. Finding the solution asynchronously prevents the video
+	//from locking the GUI.
+	QueueRequest(puzzle,game);
 
 	return false;
 }
 
 bool CachedPuzzleSolver::GetMostLikelySolution(std::vector<unsigned char>& solution) const
 {
-	SolutionMap::const_iterator solutionIter;
-	if(!GetMostLikelySolution(solutionIter))
+	const SolutionCache::Entry* entry = GetMostLikelySolutionEntry();
+	if(entry == nullptr)
 		return false;
 
-	solution = solutionIter->second.digits;
+	solution = entry->solution.Digits();
 	return true;
 }
 
-bool CachedPuzzleSolver::GetMostLikelySolution(SolutionMap::const_iterator& solutionIter) const
+const SolutionCache::Entry* CachedPuzzleSolver::GetMostLikelySolutionEntry() const
 {
-	std::deque<SolutionMap::iterator>::const_iterator mostRecentlyUsedSolution = std::max_element(recentlyUsedSolutions.cbegin(),recentlyUsedSolutions.cend(),[](const auto& lhs,const auto& rhs) {
-		return lhs->second.recentlyUsedCount < rhs->second.recentlyUsedCount;
+	std::deque<SolutionCache::Entry*>::const_iterator mostRecentlyUsedSolution = std::max_element(recentlyUsedSolutions.cbegin(),recentlyUsedSolutions.cend(),[](const auto& lhs,const auto& rhs) {
+		return lhs->useCount < rhs->useCount;
 	});
 	if(mostRecentlyUsedSolution == recentlyUsedSolutions.cend())
-		return false;
+		return nullptr;
 
-	solutionIter = *mostRecentlyUsedSolution;
-	return true;
+	return *mostRecentlyUsedSolution;
+}
+
+void CachedPuzzleSolver::CollectFinishedRequests()
+{
+	std::vector<std::shared_ptr<SolveRequest>> requests;
+	{
+		std::lock_guard<std::mutex> lock(finishedRequestsMutex);
+		requests.swap(finishedRequests);
+	}
+
+	for(const std::shared_ptr<SolveRequest>& request : requests)
+	{
+		//Abandoned requests were already removed from the pending list.
+		if(request->cancelled)
+			continue;
+
+		pendingRequests.erase(request->puzzle);
+		pendingRequestOrder.erase(std::find(pendingRequestOrder.begin(),pendingRequestOrder.end(),request));
+
+		//Cache solution to save time and so it can be used when requested later.
+		if(request->solved)
+		{
+			const PuzzleKey solution = GameToPuzzleKey(request->game);
+			solvedPuzzles.Insert(request->puzzle,solution);
+			if(solutionStore)
+				solutionStore->Append(request->puzzle,solution);
+		}
+	}
+}
+
+void CachedPuzzleSolver::QueueRequest(const PuzzleKey& puzzle,const Game& game)
+{
+	//Consecutive frames usually read the same digits. Only solve them once.
+	if(pendingRequests.find(puzzle) != pendingRequests.end())
+		return;
+
+	if(pendingRequestOrder.size() >= MAXIMUM_PENDING_REQUESTS)
+	{
+		std::shared_ptr<SolveRequest> oldestRequest = pendingRequestOrder.front();
+		oldestRequest->cancelled = true;
+		pendingRequests.erase(oldestRequest->puzzle);
+		pendingRequestOrder.pop_front();
+	}
+
+	std::shared_ptr<SolveRequest> request(new SolveRequest);
+	request->puzzle = puzzle;
+	request->game = game;
+	request->cancelled = false;
+	request->solved = false;
+	pendingRequests[puzzle] = request;
+	pendingRequestOrder.push_back(request);
+
+	threadPool.Submit([this,request]() {
+		if(!request->cancelled)
+		{
+			SolveBudget budget;
+			budget.SetCancelFlag(&request->cancelled);
+			budget.SetMaximumNodes(MAXIMUM_SOLVE_NODES);
+			budget.SetMaximumTime(MAXIMUM_SOLVE_TIME);
+
+			//A puzzle with more than one solution almost always means a digit was missed during
+			//OCR. Rejecting it is cheap and avoids caching (and displaying) a solution to the wrong
+			//puzzle.
+			const unsigned int solutionCount = CountSolutions(request->game,2,budget);
+			request->solved = solutionCount == 1 && !budget.Exhausted();
+		}
+
+		std::lock_guard<std::mutex> lock(finishedRequestsMutex);
+		finishedRequests.push_back(request);
+	});
 }
 
-CachedPuzzleSolver::UpdateRecentlyUsedSolutions::UpdateRecentlyUsedSolutions(std::deque<CachedPuzzleSolver::SolutionMap::iterator>& recentlyUsedSolutions)
+CachedPuzzleSolver::UpdateRecentlyUsedSolutions::UpdateRecentlyUsedSolutions(std::deque<SolutionCache::Entry*>& recentlyUsedSolutions)
 	: recentlyUsedSolutions(&recentlyUsedSolutions)
 {
 }
@@ -163,15 +256,15 @@ CachedPuzzleSolver::UpdateRecentlyUsedSolutions::~UpdateRecentlyUsedSolutions()
 	PopSolution();
 }
 
-void CachedPuzzleSolver::UpdateRecentlyUsedSolutions::AddSolution(CachedPuzzleSolver::SolutionMap::iterator& iter)
+void CachedPuzzleSolver::UpdateRecentlyUsedSolutions::AddSolution(SolutionCache::Entry* entry)
 {
 	constexpr unsigned int MAXIMUM_RECENTLY_USED_SOLUTIONS = 10;
 
 	if(recentlyUsedSolutions == nullptr)
 		return;
 
-	iter->second.recentlyUsedCount += 1;
-	recentlyUsedSolutions->push_back(iter);
+	entry->useCount += 1;
+	recentlyUsedSolutions->push_back(entry);
 	if(recentlyUsedSolutions->size() > MAXIMUM_RECENTLY_USED_SOLUTIONS)
 		PopSolution();
 	recentlyUsedSolutions = nullptr;
@@ -182,7 +275,7 @@ void CachedPuzzleSolver::UpdateRecentlyUsedSolutions::PopSolution()
 	if(recentlyUsedSolutions == nullptr || recentlyUsedSolutions->empty())
 		return;
 
-	recentlyUsedSolutions->front()->second.recentlyUsedCount -= 1;
+	recentlyUsedSolutions->front()->useCount -= 1;
 	recentlyUsedSolutions->pop_front();
 	recentlyUsedSolutions = nullptr;
 }
@@ -12,46 +12,63 @@
 #ifndef CACHEDPUZZLESOLVER_H
 #define CACHEDPUZZLESOLVER_H
 
+#include <atomic>
 #include <deque>
-#include <future>
-#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
 #include <vector>
 #include "Game.h"
+#include "SolutionCache.h"
+#include "SolutionStore.h"
+#include "ThreadPool.h"
 
 class CachedPuzzleSolver
 {
 	public:
 		CachedPuzzleSolver();
+		explicit CachedPuzzleSolver(const std::string& storeBasePath); //Also remember solutions between runs. See SolutionStore.
+		~CachedPuzzleSolver();
 
 		bool Solve(const std::vector<unsigned char>& digits,std::vector<unsigned char>& solution);
 		bool GetMostLikelySolution(std::vector<unsigned char>& solution) const;
 	private:
-		struct Solution
-		{
-			std::vector<unsigned char> digits;
-			unsigned int recentlyUsedCount;
-		};
-		using SolutionMap = std::map<std::vector<unsigned char>,Solution>;
 		class UpdateRecentlyUsedSolutions
 		{
 			public:
-				UpdateRecentlyUsedSolutions(std::deque<CachedPuzzleSolver::SolutionMap::iterator>& recentlyUsedSolutions);
+				UpdateRecentlyUsedSolutions(std::deque<SolutionCache::Entry*>& recentlyUsedSolutions);
 				~UpdateRecentlyUsedSolutions();
 
-				void AddSolution(CachedPuzzleSolver::SolutionMap::iterator& iter);
+				void AddSolution(SolutionCache::Entry* entry);
 			private:
-				std::deque<CachedPuzzleSolver::SolutionMap::iterator>* recentlyUsedSolutions;
+				std::deque<SolutionCache::Entry*>* recentlyUsedSolutions;
 
 				void PopSolution();
 		};
 
-		SolutionMap solvedPuzzles;
-		std::deque<SolutionMap::iterator> recentlyUsedSolutions;
-		std::vector<unsigned char> solvingDigits;
-		Game solvingGame;
-		std::future<bool> solvingFuture;
+		struct SolveRequest
+		{
+			PuzzleKey puzzle;
+			Game game;
+			std::atomic<bool> cancelled;
+			bool solved;
+		};
+
+		SolutionCache solvedPuzzles;
+		std::deque<SolutionCache::Entry*> recentlyUsedSolutions; //Entries are pinned while listed here.
+		std::optional<SolutionStore> solutionStore;
+		std::unordered_map<PuzzleKey,std::shared_ptr<SolveRequest>,PuzzleKey::Hasher> pendingRequests; //Keyed by puzzle so repeats are only solved once.
+		std::deque<std::shared_ptr<SolveRequest>> pendingRequestOrder; //Oldest first.
+		std::mutex finishedRequestsMutex;
+		std::vector<std::shared_ptr<SolveRequest>> finishedRequests; //Written by the solver threads.
+		ThreadPool threadPool; //Declared last so the workers are joined before anything they use is destroyed.
+
+		void CollectFinishedRequests();
+		void QueueRequest(const PuzzleKey& puzzle,const Game& game);
 
-		bool GetMostLikelySolution(SolutionMap::const_iterator& solutionIter) const;
+		const SolutionCache::Entry* GetMostLikelySolutionEntry() const;
 };
 
 #endif
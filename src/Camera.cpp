@@ -29,8 +29,8 @@
 #include "ImageProcessing.h"
 
 #ifdef __linux
-template <void(*ProcessFunc)(const unsigned char*,Image&)>
-static bool CaptureAndProcessFrame(const int fd,const v4l2_format& format,std::vector<unsigned char>& buffer,Image& frame)
+template <auto ProcessFunc,class Format>
+static bool CaptureAndProcessFrame(const int fd,const v4l2_format& format,std::vector<unsigned char>& buffer,Image<Format>& frame)
 {
 	assert(buffer.size() == format.fmt.pix.sizeimage);
 
@@ -38,17 +38,14 @@ static bool CaptureAndProcessFrame(const int fd,const v4l2_format& format,std::v
 	if(bytesRead == -1)
 		return false;
 
-	frame.width = format.fmt.pix.width;
-	frame.height = format.fmt.pix.height;
-	frame.data.resize(frame.width * frame.height * 3);
-
+	frame.Resize(format.fmt.pix.width,format.fmt.pix.height);
 	ProcessFunc(&buffer[0],frame);
 
 	return true;
 }
 #elif defined _WIN32
-template <void(*ProcessFunc)(const BYTE*,Image&)>
-static bool CaptureAndProcessFrame(const ComPtr<IMFSourceReader>& sourceReader,const unsigned int frameWidth,const unsigned int frameHeight,Image& frame)
+template <auto ProcessFunc,class Format>
+static bool CaptureAndProcessFrame(const ComPtr<IMFSourceReader>& sourceReader,const unsigned int frameWidth,const unsigned int frameHeight,Image<Format>& frame)
 {
 	ComPtr<IMFSample> sample = NullComPtr<IMFSample>();
 	while(sample == nullptr)
@@ -70,9 +67,7 @@ static bool CaptureAndProcessFrame(const ComPtr<IMFSourceReader>& sourceReader,c
 	DWORD bufferDataLength = 0;
 	TRY_COM_BOOL(buffer->Lock(&bufferData,nullptr,&bufferDataLength));
 
-	frame.width = frameWidth;
-	frame.height = frameHeight;
-	frame.data.resize(frame.width * frame.height * 3);
+	frame.Resize(frameWidth,frameHeight);
 	ProcessFunc(bufferData,frame);
 
 	buffer->Unlock();
@@ -201,7 +196,7 @@ std::optional<Camera> Camera::Open(const std::string& devicePath)
 #elif defined _WIN32
 #define CAPTURE_AND_PROCESS_FRAME_PARAMS sourceReader,frameWidth,frameHeight,frame
 #endif
-bool Camera::CaptureFrameRGB(Image& frame)
+bool Camera::CaptureFrameRGB(Image<RGB8>& frame)
 {
 	switch(videoFormat)
 	{
@@ -218,7 +213,7 @@ bool Camera::CaptureFrameRGB(Image& frame)
 	};
 }
 
-bool Camera::CaptureFrameGreyscale(Image& frame)
+bool Camera::CaptureFrameGreyscale(Image<Gray8>& frame)
 {
 	switch(videoFormat)
 	{
@@ -14,6 +14,7 @@
 
 #include <vector>
 #include <optional>
+#include "Image.h"
 #ifdef __linux
 #include <linux/videodev2.h>
 #elif defined _WIN32
@@ -23,8 +24,6 @@ struct IMFSourceReader;
 #error "Platform not supported"
 #endif
 
-struct Image;
-
 class Camera
 {
 	public:
@@ -34,8 +33,8 @@ class Camera
 		static std::optional<Camera> Open(const std::string& devicePath);
 		//TODO: Support camera enumeration.
 
-		bool CaptureFrameRGB(Image& frame);
-		bool CaptureFrameGreyscale(Image& frame);
+		bool CaptureFrameRGB(Image<RGB8>& frame);
+		bool CaptureFrameGreyscale(Image<Gray8>& frame);
 	private:
 #ifdef __linux
 		int fd;
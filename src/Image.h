@@ -15,32 +15,90 @@
 #include <vector>
 #include <cassert>
 
+//Pixel formats. Channel is the type of a single value and CHANNELS is how many make up a pixel.
+struct Gray8
+{
+	typedef unsigned char Channel;
+	static constexpr unsigned int CHANNELS = 1;
+};
+
+struct Gray16
+{
+	typedef unsigned short Channel;
+	static constexpr unsigned int CHANNELS = 1;
+};
+
+struct GrayF
+{
+	typedef float Channel;
+	static constexpr unsigned int CHANNELS = 1;
+};
+
+struct RGB8
+{
+	typedef unsigned char Channel;
+	static constexpr unsigned int CHANNELS = 3;
+};
+
+//Image with the channels of each pixel interleaved. Rows start stride channel values apart, which
+//is width * CHANNELS unless Resize() was asked to pad them out. Stride is always a whole number of
+//pixels.
+template <class Format>
 struct Image
 {
+	typedef typename Format::Channel Channel;
+	static constexpr unsigned int CHANNELS = Format::CHANNELS;
+
 	unsigned int width;
 	unsigned int height;
-	std::vector<unsigned char> data;
+	unsigned int stride;
+	std::vector<Channel> data;
 
 	Image()
 		: width(0),
 		  height(0),
+		  stride(0),
 		  data()
 	{
 	}
 
 	Image(const unsigned int width,const unsigned int height)
-		: width(width),
-		  height(height),
-		  data(width * height * 3)
+		: width(0),
+		  height(0),
+		  stride(0),
+		  data()
+	{
+		Resize(width,height);
+	}
+
+	//Rows are padded to a multiple of rowAlignment pixels.
+	void Resize(const unsigned int width,const unsigned int height,const unsigned int rowAlignment = 1)
+	{
+		this->width = width;
+		this->height = height;
+		stride = (width + rowAlignment - 1) / rowAlignment * rowAlignment * CHANNELS;
+		data.resize(stride * height);
+	}
+
+	template <class OtherFormat>
+	void MatchSize(const Image<OtherFormat>& other)
+	{
+		Resize(other.width,other.height);
+	}
+
+	Channel* Row(const unsigned int y)
+	{
+		return &data[y * stride];
+	}
+
+	const Channel* Row(const unsigned int y) const
 	{
+		return &data[y * stride];
 	}
 
-	void MatchSize(const Image& other)
+	bool Packed() const
 	{
-		width = other.width;
-		height = other.height;
-		data.resize(width * height * 3);
-		assert(data.size() == other.data.size());
+		return stride == width * CHANNELS;
 	}
 };
 
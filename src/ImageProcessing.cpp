@@ -15,6 +15,12 @@
 #include <stack>
 #include <cmath>
 #include <cstring>
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define GAUSSIAN_SSE2
+#endif
+
+static constexpr unsigned int GAUSSIAN_WEIGHT_ONE = 65535; //Fixed point 1.0 of GaussianBlur weights.
 
 template <class T>
 static T Clamp(const T value,const T minimum,const T maximum)
@@ -22,16 +28,28 @@ static T Clamp(const T value,const T minimum,const T maximum)
 	return std::min(std::max(value,minimum),maximum);
 }
 
+static unsigned int BorderIndex(int index,const unsigned int size,const BorderMode borderMode)
+{
+	//Reflecting can land outside again when the image is narrower than the blur.
+	const int last = static_cast<int>(size) - 1;
+	while(index < 0 || index > last)
+	{
+		if(borderMode == BorderMode::Replicate || last == 0)
+			return Clamp(index,0,last);
+		index = index < 0 ? -index : 2 * last - index;
+	}
+
+	return index;
+}
+
 template <class T>
 static unsigned char ClampToU8(const T value)
 {
 	return static_cast<unsigned char>(Clamp(value,static_cast<T>(0),static_cast<T>(255)));
 }
 
-static void Histogram(const Image& image,std::vector<float>& normalizedHistogram)
+static void Histogram(const Image<Gray8>& image,std::vector<float>& normalizedHistogram)
 {
-	//Note: Assumes image is greyscale.
-	
 	normalizedHistogram.resize(256);
 	std::fill(normalizedHistogram.begin(),normalizedHistogram.end(),0.0f);
 
@@ -40,10 +58,13 @@ static void Histogram(const Image& image,std::vector<float>& normalizedHistogram
 		return;
 
 	//Count the pixels.
-	for(unsigned int x = 0;x < pixelCount;x++)
+	for(unsigned int y = 0;y < image.height;y++)
 	{
-		const unsigned int index = x * 3;
-		normalizedHistogram[image.data[index]] += 1.0f;
+		const unsigned char* row = image.Row(y);
+		for(unsigned int x = 0;x < image.width;x++)
+		{
+			normalizedHistogram[row[x]] += 1.0f;
+		}
 	}
 
 	//Normalize the histogram so the sum of all of the steps equal 1.0.
@@ -100,28 +121,37 @@ static unsigned char OtsusMethod(const std::vector<float>& normalizedHistogram)
 	return std::accumulate(betweenClassVarianceIndexes.begin(),betweenClassVarianceIndexes.end(),0) / betweenClassVarianceIndexes.size();
 }
 
-static void NonMaximumSuppression(const std::vector<float>& gradient,const unsigned int width,const unsigned int height,std::vector<unsigned char>& nonMaximumSuppression,const unsigned char lowThreshold,const unsigned char highThreshold)
+//Pixel values written by NonMaximumSuppression() and updated by ConnectivityAnalysis().
+static constexpr unsigned char WEAK_EDGE = 1;
+static constexpr unsigned char VISITED_EDGE = 254; //Strong edge that has already been flood filled from.
+static constexpr unsigned char STRONG_EDGE = 255;
+
+static void NonMaximumSuppression(const Image<GrayF>& gradientMagnitude,const Image<GrayF>& gradientAngle,Image<Gray8>& nonMaximumSuppression,const unsigned char lowThreshold,const unsigned char highThreshold)
 {
 	//Based on Digital Image Processing Third Edition. Chapter 10.2. Page 721.
 
-	assert(gradient.size() == width * height * 2);
+	assert(gradientMagnitude.width == gradientAngle.width && gradientMagnitude.height == gradientAngle.height);
 
 	//Perform Non-Maximum Suppression and Hysterasis Thresholding.
-	nonMaximumSuppression.resize(width * height * 3);
-	std::fill(nonMaximumSuppression.begin(),nonMaximumSuppression.end(),0);
+	const unsigned int width = gradientMagnitude.width;
+	const unsigned int height = gradientMagnitude.height;
+	nonMaximumSuppression.MatchSize(gradientMagnitude);
+	std::fill(nonMaximumSuppression.data.begin(),nonMaximumSuppression.data.end(),0);
 	for(unsigned int y = 1;y < height - 1;y++)
 	{
+		const float* above = gradientMagnitude.Row(y - 1);
+		const float* center = gradientMagnitude.Row(y);
+		const float* below = gradientMagnitude.Row(y + 1);
+		const float* angles = gradientAngle.Row(y);
+		unsigned char* output = nonMaximumSuppression.Row(y);
 		for(unsigned int x = 1;x < width - 1;x++)
 		{
-			const unsigned int inputIndex = (y * width + x) * 2;
-			const unsigned int outputIndex = (y * width + x) * 3;
-
-			const float magnitude = gradient[inputIndex + 0];
+			const float magnitude = center[x];
 
 			//Discretize angle into one of four fixed steps to indicate which direction the edge is
 			//running along: horizontal, vertical, left-to-right diagonal, or right-to-left
 			//diagonal. The edge direction is 90 degrees from the gradient angle.
-			float angle = gradient[inputIndex + 1];
+			float angle = angles[x];
 
 			//The input angle is in the range of [-pi,pi] but negative angles represent the same
 			//edge direction as angles 180 degrees apart.
@@ -137,49 +167,33 @@ static void NonMaximumSuppression(const std::vector<float>& gradient,const unsig
 			//of the edge have smaller magnitudes. This keeps the edges thin.
 			bool suppress = false;
 			if(direction == 0) //Vertical edge.
-				suppress = magnitude < gradient[inputIndex - 2] ||
-						   magnitude < gradient[inputIndex + 2];
+				suppress = magnitude < center[x - 1] ||
+						   magnitude < center[x + 1];
 			else if(direction == 1) //Right-to-left diagonal edge.
-				suppress = magnitude < gradient[inputIndex - width * 2 - 2] ||
-						   magnitude < gradient[inputIndex + width * 2 + 2];
+				suppress = magnitude < above[x - 1] ||
+						   magnitude < below[x + 1];
 			else if(direction == 2) //Horizontal edge.
-				suppress = magnitude < gradient[inputIndex - width * 2] ||
-						   magnitude < gradient[inputIndex + width * 2];
+				suppress = magnitude < above[x] ||
+						   magnitude < below[x];
 			else if(direction == 3) //Left-to-right diagonal edge.
-				suppress = magnitude < gradient[inputIndex - width * 2 + 2] ||
-						   magnitude < gradient[inputIndex + width * 2 - 2];
-
-			if(suppress || magnitude < lowThreshold)
-			{
-				nonMaximumSuppression[outputIndex + 0] = 0;
-				nonMaximumSuppression[outputIndex + 1] = 0;
-				nonMaximumSuppression[outputIndex + 2] = 0;
-			}
-			else
-			{
-				//Use thresholding to indicate strong and weak edges. Strong edges are assumed to be
-				//valid edges. Connectivity analysis is used to check if a weak edge is connected to
-				//a strong edge indiciating that the weak edge is also a valid edge.
-				nonMaximumSuppression[outputIndex + 0] = magnitude >= highThreshold ? 255 : 0; //Strong
-				nonMaximumSuppression[outputIndex + 1] = magnitude < highThreshold ? 255 : 0; //Weak
-				nonMaximumSuppression[outputIndex + 2] = 0;
-			}
+				suppress = magnitude < above[x + 1] ||
+						   magnitude < below[x - 1];
+
+			//Use thresholding to indicate strong and weak edges. Strong edges are assumed to be
+			//valid edges. Connectivity analysis is used to check if a weak edge is connected to a
+			//strong edge indiciating that the weak edge is also a valid edge.
+			if(!suppress && magnitude >= lowThreshold)
+				output[x] = magnitude >= highThreshold ? STRONG_EDGE : WEAK_EDGE;
 		}
 	}
 }
 
-static void ConnectivityAnalysis(Image& image)
+static void ConnectivityAnalysis(Image<Gray8>& image)
 {
 	assert(image.width >= 1 && image.height >= 1);
 
-	//Input image should be output of NonMaximumSuppression().
-	//Channel 0: Strong edge pixels.
-	//Channel 1: Weak edge pixels.
-	//Channel 2: Should be set to 0. Will be used to indicate an edge that has been previously
-	//           visited.
-	//Output image will have all weak edges connected to strong edges set to strong edges
-	//themselves. Meaning only the first channel will have useful data and the other remaining
-	//channels should be ignored.
+	//Input image should be output of NonMaximumSuppression(). Output image will have all weak
+	//edges connected to strong edges set to 255 and everything else set to 0.
 
 	//Keep track of coordinates that should be searched in case they are connected.
 	std::stack<std::pair<unsigned int,unsigned int>> searchStack;
@@ -202,14 +216,13 @@ static void ConnectivityAnalysis(Image& image)
 	{
 		for(unsigned int x = 1;x < image.width - 1;x++)
 		{
-			const unsigned int index = (y * image.width + x) * 3;
-
 			//Skip pixels that are not strong edges or have been previously visited.
-			if(image.data[index + 0] == 0 || image.data[index + 2] == 255)
+			unsigned char& pixel = image.Row(y)[x];
+			if(pixel != STRONG_EDGE)
 				continue;
 
 			//Mark pixel as visited to save time flood filling later.
-			image.data[index + 2] = 255;
+			pixel = VISITED_EDGE;
 
 			//Flood fill all connected weak edges.
 			PushSearchConnected(x,y);
@@ -221,14 +234,12 @@ static void ConnectivityAnalysis(Image& image)
 				//Skip pixels that are not weak edges.
 				const unsigned int x = coordinates.first;
 				const unsigned int y = coordinates.second;
-				const unsigned int index = (y * image.width + x) * 3;
-				if(image.data[index + 1] == 0)
+				unsigned char& pixel = image.Row(y)[x];
+				if(pixel != WEAK_EDGE)
 					continue;
 
 				//Promote to strong edge and mark visited to save time flood filling later.
-				image.data[index + 0] = 255;
-				image.data[index + 1] = 0;
-				image.data[index + 2] = 255;
+				pixel = VISITED_EDGE;
 
 				//Search around this coordinate as well. This will waste time checking the previous
 				//coordinate again but it's fast enough.
@@ -236,66 +247,76 @@ static void ConnectivityAnalysis(Image& image)
 			}
 		}
 	}
+
+	//Every strong edge has been visited. Weak edges left over weren't connected to one.
+	for(unsigned int y = 0;y < image.height;y++)
+	{
+		unsigned char* row = image.Row(y);
+		for(unsigned int x = 0;x < image.width;x++)
+		{
+			row[x] = row[x] >= VISITED_EDGE ? 255 : 0;
+		}
+	}
 }
 
-void YUYVToRGB(const unsigned char* yuyvData,Image& frame)
+void YUYVToRGB(const unsigned char* yuyvData,Image<RGB8>& frame)
 {
-	for(unsigned int x = 0;x < frame.width * frame.height;x+=2)
+	for(unsigned int y = 0;y < frame.height;y++)
 	{
-		const unsigned int inputIndex = x * 2;
-		const unsigned int outputIndex = x * 3;
+		const unsigned char* input = &yuyvData[y * frame.width * 2];
+		unsigned char* output = frame.Row(y);
+		for(unsigned int x = 0;x < frame.width;x+=2)
+		{
+			const unsigned int inputIndex = x * 2;
+			const unsigned int outputIndex = x * 3;
 
-		const unsigned char y0 = yuyvData[inputIndex + 0];
-		const unsigned char cb = yuyvData[inputIndex + 1];
-		const unsigned char y1 = yuyvData[inputIndex + 2];
-		const unsigned char cr = yuyvData[inputIndex + 3];
+			const unsigned char y0 = input[inputIndex + 0];
+			const unsigned char cb = input[inputIndex + 1];
+			const unsigned char y1 = input[inputIndex + 2];
+			const unsigned char cr = input[inputIndex + 3];
 
-		//TODO: LOTS of optimization possibilities here.
+			//TODO: LOTS of optimization possibilities here.
 
-		frame.data[outputIndex + 0] = Clamp(static_cast<int>(y0 + 1.402 * (cr - 128)),0,255);
-		frame.data[outputIndex + 1] = Clamp(static_cast<int>(y0 - 0.344 * (cb - 128) - 0.714 * (cr - 128)),0,255);
-		frame.data[outputIndex + 2] = Clamp(static_cast<int>(y0 + 1.772 * (cb - 128)),0,255);
+			output[outputIndex + 0] = Clamp(static_cast<int>(y0 + 1.402 * (cr - 128)),0,255);
+			output[outputIndex + 1] = Clamp(static_cast<int>(y0 - 0.344 * (cb - 128) - 0.714 * (cr - 128)),0,255);
+			output[outputIndex + 2] = Clamp(static_cast<int>(y0 + 1.772 * (cb - 128)),0,255);
 
-		frame.data[outputIndex + 3] = Clamp(static_cast<int>(y1 + 1.402 * (cr - 128)),0,255);
-		frame.data[outputIndex + 4] = Clamp(static_cast<int>(y1 - 0.344 * (cb - 128) - 0.714 * (cr - 128)),0,255);
-		frame.data[outputIndex + 5] = Clamp(static_cast<int>(y1 + 1.772 * (cb - 128)),0,255);
+			output[outputIndex + 3] = Clamp(static_cast<int>(y1 + 1.402 * (cr - 128)),0,255);
+			output[outputIndex + 4] = Clamp(static_cast<int>(y1 - 0.344 * (cb - 128) - 0.714 * (cr - 128)),0,255);
+			output[outputIndex + 5] = Clamp(static_cast<int>(y1 + 1.772 * (cb - 128)),0,255);
+		}
 	}
 }
 
-void YUYVToGreyscale(const unsigned char* yuyvData,Image& frame)
+void YUYVToGreyscale(const unsigned char* yuyvData,Image<Gray8>& frame)
 {
-	for(unsigned int x = 0;x < frame.width * frame.height;x+=2)
+	//Luma is every other byte so just pick it out.
+	for(unsigned int y = 0;y < frame.height;y++)
 	{
-		const unsigned int inputIndex = x * 2;
-		const unsigned int outputIndex = x * 3;
-
-		const unsigned char y0 = yuyvData[inputIndex + 0];
-		const unsigned char y1 = yuyvData[inputIndex + 2];
-
-		frame.data[outputIndex + 0] = y0;
-		frame.data[outputIndex + 1] = y0;
-		frame.data[outputIndex + 2] = y0;
-
-		frame.data[outputIndex + 3] = y1;
-		frame.data[outputIndex + 4] = y1;
-		frame.data[outputIndex + 5] = y1;
+		const unsigned char* input = &yuyvData[y * frame.width * 2];
+		unsigned char* output = frame.Row(y);
+		for(unsigned int x = 0;x < frame.width;x++)
+		{
+			output[x] = input[x * 2];
+		}
 	}
 }
 
-void NV12ToRGB(const unsigned char* nv12Data,Image& frame)
+void NV12ToRGB(const unsigned char* nv12Data,Image<RGB8>& frame)
 {
 	const unsigned int widthHalf = frame.width / 2;
 
 	for(unsigned int y = 0;y < frame.height;y++)
 	{
 		const unsigned int yEven = y & 0xFFFFFFFE;
+		unsigned char* output = frame.Row(y);
 		for(unsigned int x = 0;x < frame.width;x++)
 		{
 			const unsigned int xEven = x & 0xFFFFFFFE;
 
 			const unsigned int yIndex = y * frame.width + x;
 			const unsigned int cIndex = frame.width * frame.height + yEven * widthHalf + xEven;
-			const unsigned int outputIndex = (y * frame.width + x) * 3;
+			const unsigned int outputIndex = x * 3;
 
 			const unsigned char y = nv12Data[yIndex];
 			const unsigned char cb = nv12Data[cIndex + 0];
@@ -303,78 +324,89 @@ void NV12ToRGB(const unsigned char* nv12Data,Image& frame)
 
 			//TODO: LOTS of optimization possibilities here.
 
-			frame.data[outputIndex + 0] = Clamp(static_cast<int>(y + 1.402 * (cr - 128)),0,255);
-			frame.data[outputIndex + 1] = Clamp(static_cast<int>(y - 0.344 * (cb - 128) - 0.714 * (cr - 128)),0,255);
-			frame.data[outputIndex + 2] = Clamp(static_cast<int>(y + 1.772 * (cb - 128)),0,255);
+			output[outputIndex + 0] = Clamp(static_cast<int>(y + 1.402 * (cr - 128)),0,255);
+			output[outputIndex + 1] = Clamp(static_cast<int>(y - 0.344 * (cb - 128) - 0.714 * (cr - 128)),0,255);
+			output[outputIndex + 2] = Clamp(static_cast<int>(y + 1.772 * (cb - 128)),0,255);
 		}
 	}
 }
 
-void NV12ToGreyscale(const unsigned char* nv12Data,Image& frame)
+void NV12ToGreyscale(const unsigned char* nv12Data,Image<Gray8>& frame)
 {
-	for(unsigned int x = 0;x < frame.width * frame.height;x++)
+	//The luma plane comes first and is already greyscale.
+	for(unsigned int y = 0;y < frame.height;y++)
 	{
-		const unsigned int outputIndex = x * 3;
-		const unsigned char y = nv12Data[x];
-
-		frame.data[outputIndex + 0] = y;
-		frame.data[outputIndex + 1] = y;
-		frame.data[outputIndex + 2] = y;
+		memcpy(frame.Row(y),&nv12Data[y * frame.width],frame.width);
 	}
 }
 
-void RGBToRGB(const unsigned char* rgbData,Image& frame)
+void RGBToRGB(const unsigned char* rgbData,Image<RGB8>& frame)
 {
-	memcpy(&frame.data[0],rgbData,frame.width * frame.height * 3);
+	const unsigned int span = frame.width * 3;
+	for(unsigned int y = 0;y < frame.height;y++)
+	{
+		memcpy(frame.Row(y),&rgbData[y * span],span);
+	}
 }
 
-void RGBToGreyscale(const unsigned char* rgbData,Image& frame)
+void RGBToGreyscale(const unsigned char* rgbData,Image<Gray8>& frame)
 {
-	for(unsigned int x = 0;x < frame.width * frame.height;x++)
+	for(unsigned int y = 0;y < frame.height;y++)
 	{
-		const unsigned int index = x * 3;
-
-		//RGB to luma (BT.601 Y'UV).
-		const float lumaf = 0.299f * rgbData[index + 0] +
-							0.587f * rgbData[index + 1] +
-							0.114f * rgbData[index + 2];
-		const unsigned char luma = ClampToU8(lumaf);
+		const unsigned char* input = &rgbData[y * frame.width * 3];
+		unsigned char* output = frame.Row(y);
+		for(unsigned int x = 0;x < frame.width;x++)
+		{
+			const unsigned int index = x * 3;
 
-		frame.data[index + 0] = luma;
-		frame.data[index + 1] = luma;
-		frame.data[index + 2] = luma;
+			//RGB to luma (BT.601 Y'UV).
+			const float lumaf = 0.299f * input[index + 0] +
+								0.587f * input[index + 1] +
+								0.114f * input[index + 2];
+			output[x] = ClampToU8(lumaf);
+		}
 	}
 }
 
-void BGRVerticalMirroredToRGB(const unsigned char* bgrData,Image& frame)
+void BGRVerticalMirroredToRGB(const unsigned char* bgrData,Image<RGB8>& frame)
 {
 	for(unsigned int y = 0;y < frame.height;y++)
 	{
+		const unsigned char* input = &bgrData[(frame.height - y - 1) * frame.width * 3];
+		unsigned char* output = frame.Row(y);
 		for(unsigned int x = 0;x < frame.width;x++)
 		{
-			const unsigned int inputIndex = ((frame.height - y - 1) * frame.width + x) * 3;
-			const unsigned int outputIndex = (y * frame.width + x) * 3;
+			const unsigned int index = x * 3;
 
-			frame.data[outputIndex + 0] = bgrData[inputIndex + 2];
-			frame.data[outputIndex + 1] = bgrData[inputIndex + 1];
-			frame.data[outputIndex + 2] = bgrData[inputIndex + 0];
+			output[index + 0] = input[index + 2];
+			output[index + 1] = input[index + 1];
+			output[index + 2] = input[index + 0];
 		}
 	}
 }
 
-void BlendAdd(const Image& image1,const Image& image2,Image& outputImage)
+void BlendAdd(const Image<RGB8>& image1,const Image<Gray8>& image2,Image<RGB8>& outputImage)
 {
 	assert(image1.width == image2.width && image1.height == image2.height);
 	
 	outputImage.MatchSize(image1);
 
-	for(unsigned int x = 0;x < image1.width * image1.height * 3;x++)
+	for(unsigned int y = 0;y < image1.height;y++)
 	{
-		outputImage.data[x] = ClampToU8(static_cast<unsigned int>(image1.data[x]) + static_cast<unsigned int>(image2.data[x]));
+		const unsigned char* input1 = image1.Row(y);
+		const unsigned char* input2 = image2.Row(y);
+		unsigned char* output = outputImage.Row(y);
+		for(unsigned int x = 0;x < image1.width;x++)
+		{
+			const unsigned int value2 = input2[x];
+			output[x * 3 + 0] = ClampToU8(static_cast<unsigned int>(input1[x * 3 + 0]) + value2);
+			output[x * 3 + 1] = ClampToU8(static_cast<unsigned int>(input1[x * 3 + 1]) + value2);
+			output[x * 3 + 2] = ClampToU8(static_cast<unsigned int>(input1[x * 3 + 2]) + value2);
+		}
 	}
 }
 
-void AutoLevels(const Image& inputImage,Image& outputImage,const unsigned int ignorePadding)
+void AutoLevels(const Image<Gray8>& inputImage,Image<Gray8>& outputImage,const unsigned int ignorePadding)
 {
 	if(inputImage.width < ignorePadding * 2 || inputImage.height < ignorePadding * 2)
 		return;
@@ -386,10 +418,10 @@ void AutoLevels(const Image& inputImage,Image& outputImage,const unsigned int ig
 	unsigned char maxValue = 0;
 	for(unsigned int y = ignorePadding;y < inputImage.height - ignorePadding;y++)
 	{
+		const unsigned char* row = inputImage.Row(y);
 		for(unsigned int x = ignorePadding;x < inputImage.width - ignorePadding;x++)
 		{
-			const unsigned int index = (y * inputImage.width + x) * 3;
-			const unsigned char value = inputImage.data[index];
+			const unsigned char value = row[x];
 
 			minValue = std::min(minValue,value);
 			maxValue = std::max(maxValue,value);
@@ -401,153 +433,201 @@ void AutoLevels(const Image& inputImage,Image& outputImage,const unsigned int ig
 	const float delta = static_cast<float>(maxValue - minValue) / 255.0f - (CLIPPING * 2.0f);
 	if(delta <= 0.0f)
 		return;
-	for(unsigned int x = 0;x < inputImage.width * inputImage.height;x++)
+	for(unsigned int y = 0;y < inputImage.height;y++)
 	{
-		const unsigned int index = x * 3;
+		const unsigned char* input = inputImage.Row(y);
+		unsigned char* output = outputImage.Row(y);
+		for(unsigned int x = 0;x < inputImage.width;x++)
+		{
+			const float valuef = (static_cast<float>(input[x]) - static_cast<float>(minValue)) / delta;
+			output[x] = ClampToU8(valuef);
+		}
+	}
+}
+
+GaussianBlur::GaussianBlur(const float radius,const BorderMode borderMode)
+	: borderMode(borderMode),
+	  weightRadius(static_cast<unsigned int>(radius) + 1),
+	  weights(),
+	  paddedRow(),
+	  horizontalBlur(),
+	  tapRows()
+{
+	auto Gaussian = [](const float x,const float sigma) {
+		const float x2 = x * x;
+		const float sigma2 = sigma * sigma;
+		return expf(-x2 / (2.0f * sigma2));
+	};
 
-		const float valuef = (static_cast<float>(inputImage.data[index]) - static_cast<float>(minValue)) / delta;
-		const unsigned char value = ClampToU8(valuef);
+	const float sigma = radius / 3.0f; //Somewhat arbitrary but dependent on radius.
+	const unsigned int weightCount = weightRadius * 2 + 1;
+	std::vector<float> floatWeights(weightCount,0.0f);
+	float sum = 0.0f;
+	for(unsigned int x = 0;x < weightCount;x++)
+	{
+		const float weight = Gaussian(static_cast<float>(x) - static_cast<float>(weightRadius),sigma);
+		floatWeights[x] = weight;
+		sum += weight;
+	}
 
-		outputImage.data[index + 0] = value;
-		outputImage.data[index + 1] = value;
-		outputImage.data[index + 2] = value;
+	//Round to fixed point and give whatever rounding lost or gained to the center so a flat image
+	//stays exactly the same.
+	weights.resize(weightCount);
+	int fixedSum = 0;
+	for(unsigned int x = 0;x < weightCount;x++)
+	{
+		weights[x] = static_cast<unsigned short>(lroundf(floatWeights[x] / sum * GAUSSIAN_WEIGHT_ONE));
+		fixedSum += weights[x];
 	}
+	weights[weightRadius] = static_cast<unsigned short>(weights[weightRadius] + static_cast<int>(GAUSSIAN_WEIGHT_ONE) - fixedSum);
 }
 
-void Gaussian(const Image& inputImage,Image& outputImage,const float radius)
+void GaussianBlur::Process(const Image<Gray8>& inputImage,Image<Gray8>& outputImage)
 {
+	assert(&inputImage != &outputImage);
+
 	outputImage.MatchSize(inputImage);
 
-	auto GaussianKernel = [](const float radius,unsigned int& weightRadius,unsigned int& weightCount) {
-		auto Gaussian = [](const float x,const float sigma) {
-			const float x2 = x * x;
-			const float sigma2 = sigma * sigma;
-			return expf(-x2 / (2.0f * sigma2));
-		};
+	const unsigned int width = inputImage.width;
+	const unsigned int height = inputImage.height;
+	if(width == 0 || height == 0)
+		return;
 
-		const float sigma = radius / 3.0f; //Somewhat arbitrary but dependent on radius.
-		weightRadius = static_cast<unsigned int>(radius) + 1;
-		weightCount = weightRadius * 2 + 1;
+	const unsigned int weightCount = weights.size();
+	tapRows.resize(weightCount);
 
-		std::vector<float> weights(weightCount,0.0f);
-		float sum = 0.0f;
-		for(unsigned int x = 0;x < weightCount;x++)
+	//Blur horizontally. Each row is copied between its borders first so every tap reads straight
+	//through.
+	paddedRow.resize(width + weightRadius * 2);
+	horizontalBlur.resize(width * height);
+	for(unsigned int x = 0;x < weightCount;x++)
+	{
+		tapRows[x] = &paddedRow[x];
+	}
+	for(unsigned int y = 0;y < height;y++)
+	{
+		const unsigned char* inputRow = inputImage.Row(y);
+		for(unsigned int x = 0;x < weightRadius;x++)
 		{
-			const float weight = Gaussian(static_cast<float>(x) - static_cast<float>(weightRadius),sigma);
-			weights[x] = weight;
-			sum += weight;
+			paddedRow[x] = inputRow[BorderIndex(static_cast<int>(x) - static_cast<int>(weightRadius),width,borderMode)];
+			paddedRow[weightRadius + width + x] = inputRow[BorderIndex(width + x,width,borderMode)];
 		}
+		memcpy(&paddedRow[weightRadius],inputRow,width);
+
+		BlurRow(&tapRows[0],&horizontalBlur[y * width],width);
+	}
 
-		const float oneOverSum = 1.0f / sum;
-		for(float& weight : weights)
+	//Blur vertically. Taps past the top or bottom point at rows inside the image instead.
+	for(unsigned int y = 0;y < height;y++)
+	{
+		for(unsigned int x = 0;x < weightCount;x++)
 		{
-			weight *= oneOverSum;
+			tapRows[x] = &horizontalBlur[BorderIndex(static_cast<int>(y + x) - static_cast<int>(weightRadius),height,borderMode) * width];
 		}
 
-		return weights;
-	};
-
-	unsigned int weightRadius = 0;
-	unsigned int weightCount = 0;
-	const std::vector<float> weights = GaussianKernel(radius,weightRadius,weightCount);
-
-	//TODO: Make caller provide a temporary buffer to reduce large allocations.
-	std::vector<unsigned char> tempBuffer;
-	tempBuffer.resize(outputImage.data.size());
+		BlurRow(&tapRows[0],outputImage.Row(y),width);
+	}
+}
 
-	//Blur horizontally.
-	//TODO: Support edges or document the current behavior.
-	for(unsigned int y = 0;y < inputImage.height;y++)
+void GaussianBlur::BlurRow(const unsigned char* const* rows,unsigned char* output,const unsigned int width) const
+{
+	//output[x] is the weighted sum of rows[tap][x]. Pixels are shifted up 8 bits so multiplying by
+	//a weight and keeping the high 16 bits leaves 8 fractional bits. The sum can't pass 255 << 8.
+	const unsigned int weightCount = weights.size();
+	unsigned int x = 0;
+#ifdef GAUSSIAN_SSE2
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i half = _mm_set1_epi16(128);
+	for(;x + 16 <= width;x += 16)
 	{
-		for(unsigned int x = weightRadius;x < inputImage.width - weightRadius;x++)
+		__m128i low = zero;
+		__m128i high = zero;
+		for(unsigned int w = 0;w < weightCount;w++)
 		{
-			float sum[3] = {0.0f,0.0f,0.0f};
-			for(unsigned int w = 0;w < weightCount;w++)
-			{
-				const unsigned int inputIndex = (y * inputImage.width + x + w - weightRadius) * 3;
-				sum[0] += static_cast<float>(inputImage.data[inputIndex + 0]) * weights[w];
-				sum[1] += static_cast<float>(inputImage.data[inputIndex + 1]) * weights[w];
-				sum[2] += static_cast<float>(inputImage.data[inputIndex + 2]) * weights[w];
-			}
-
-			const unsigned int outputIndex = (y * outputImage.width + x) * 3;
-			tempBuffer[outputIndex + 0] = ClampToU8(sum[0]);
-			tempBuffer[outputIndex + 1] = ClampToU8(sum[1]);
-			tempBuffer[outputIndex + 2] = ClampToU8(sum[2]);
+			const __m128i weight = _mm_set1_epi16(static_cast<short>(weights[w]));
+			const __m128i pixels = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&rows[w][x]));
+			low = _mm_add_epi16(low,_mm_mulhi_epu16(_mm_unpacklo_epi8(zero,pixels),weight));
+			high = _mm_add_epi16(high,_mm_mulhi_epu16(_mm_unpackhi_epi8(zero,pixels),weight));
 		}
+
+		low = _mm_srli_epi16(_mm_adds_epu16(low,half),8);
+		high = _mm_srli_epi16(_mm_adds_epu16(high,half),8);
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(&output[x]),_mm_packus_epi16(low,high));
 	}
+#endif
 
-	//Blur vertically.
-	//TODO: Might be faster to rotate 90 degrees, blur horizontally, and then rotate 90 degrees back.
-	for(unsigned int y = weightRadius;y < inputImage.height - weightRadius;y++)
+	//Same math one pixel at a time for what's left.
+	for(;x < width;x++)
 	{
-		for(unsigned int x = weightRadius;x < inputImage.width - weightRadius;x++)
+		unsigned int sum = 0;
+		for(unsigned int w = 0;w < weightCount;w++)
 		{
-			float sum[3] = {0.0f,0.0f,0.0f};
-			for(unsigned int w = 0;w < weightCount;w++)
-			{
-				const unsigned int inputIndex = ((y + w - weightRadius) * inputImage.width + x) * 3;
-				sum[0] += static_cast<float>(tempBuffer[inputIndex + 0]) * weights[w];
-				sum[1] += static_cast<float>(tempBuffer[inputIndex + 1]) * weights[w];
-				sum[2] += static_cast<float>(tempBuffer[inputIndex + 2]) * weights[w];
-			}
-
-			const unsigned int outputIndex = (y * outputImage.width + x) * 3;
-			outputImage.data[outputIndex + 0] = ClampToU8(sum[0]);
-			outputImage.data[outputIndex + 1] = ClampToU8(sum[1]);
-			outputImage.data[outputIndex + 2] = ClampToU8(sum[2]);
+			sum += (static_cast<unsigned int>(rows[w][x]) << 8) * weights[w] >> 16;
 		}
+		output[x] = static_cast<unsigned char>((sum + 128) >> 8);
 	}
 }
 
-void Sobel(const Image& image,std::vector<float>& gradient)
+void Gaussian(const Image<Gray8>& inputImage,Image<Gray8>& outputImage,const float radius)
 {
-	gradient.resize(image.width * image.height * 2);
+	GaussianBlur gaussianBlur(radius);
+	gaussianBlur.Process(inputImage,outputImage);
+}
+
+void Sobel(const Image<Gray8>& image,Image<GrayF>& magnitude,Image<GrayF>& angle)
+{
+	magnitude.MatchSize(image);
+	angle.MatchSize(image);
 
 	if(image.width == 0 || image.height == 0)
 		return;
 
-	const unsigned int rowSpan = image.width * 3;
+	//Border pixels have no gradient.
+	std::fill(magnitude.Row(0),magnitude.Row(0) + image.width,0.0f);
+	std::fill(magnitude.Row(image.height - 1),magnitude.Row(image.height - 1) + image.width,0.0f);
+	std::fill(angle.Row(0),angle.Row(0) + image.width,0.0f);
+	std::fill(angle.Row(image.height - 1),angle.Row(image.height - 1) + image.width,0.0f);
+
 	for(unsigned int y = 1;y < image.height - 1;y++)
 	{
+		const unsigned char* above = image.Row(y - 1);
+		const unsigned char* center = image.Row(y);
+		const unsigned char* below = image.Row(y + 1);
+		float* magnitudeRow = magnitude.Row(y);
+		float* angleRow = angle.Row(y);
+		magnitudeRow[0] = magnitudeRow[image.width - 1] = 0.0f;
+		angleRow[0] = angleRow[image.width - 1] = 0.0f;
 		for(unsigned int x = 1;x < image.width - 1;x++)
 		{
-			const unsigned int inputIndex = (y * image.width + x) * 3;
-			const float horizontalSum = static_cast<float>(image.data[inputIndex - rowSpan - 3]) * -1.0f + static_cast<float>(image.data[inputIndex - rowSpan + 3]) +
-										static_cast<float>(image.data[inputIndex - 3])           * -2.0f + static_cast<float>(image.data[inputIndex + 3])       * 2.0f +
-										static_cast<float>(image.data[inputIndex + rowSpan - 3]) * -1.0f + static_cast<float>(image.data[inputIndex + rowSpan + 3]);
-			const float verticalSum = static_cast<float>(image.data[inputIndex - rowSpan - 3]) * -1.0f + static_cast<float>(image.data[inputIndex - rowSpan]) * -2.0f + static_cast<float>(image.data[inputIndex - rowSpan + 3]) * -1.0f +
-									  static_cast<float>(image.data[inputIndex + rowSpan - 3])         + static_cast<float>(image.data[inputIndex + rowSpan]) *  2.0f + static_cast<float>(image.data[inputIndex + rowSpan + 3]);
-
-			const float magnitude = hypotf(horizontalSum,verticalSum);
-			const float angle = atan2f(verticalSum,horizontalSum);
-
-			const unsigned int outputIndex = (y * image.width + x) * 2;
-			gradient[outputIndex + 0] = magnitude;
-			gradient[outputIndex + 1] = angle;
+			const float horizontalSum = static_cast<float>(above[x - 1])  * -1.0f + static_cast<float>(above[x + 1]) +
+										static_cast<float>(center[x - 1]) * -2.0f + static_cast<float>(center[x + 1]) * 2.0f +
+										static_cast<float>(below[x - 1])  * -1.0f + static_cast<float>(below[x + 1]);
+			const float verticalSum = static_cast<float>(above[x - 1]) * -1.0f + static_cast<float>(above[x]) * -2.0f + static_cast<float>(above[x + 1]) * -1.0f +
+									  static_cast<float>(below[x - 1])         + static_cast<float>(below[x]) *  2.0f + static_cast<float>(below[x + 1]);
+
+			magnitudeRow[x] = hypotf(horizontalSum,verticalSum);
+			angleRow[x] = atan2f(verticalSum,horizontalSum);
 		}
 	}
 }
 
-void HoughTransform(const Image& inputImage,Image& accumulationImage)
+void HoughTransform(const Image<Gray8>& inputImage,Image<Gray16>& accumulationImage)
 {
     //Based on Digital Image Processing Third Edition. Chapter 10.2.7. Page 733.
 	//AccumulationImage is where the buckets for the hough transform are written to.
 	//X Axis: Angle evenly split up across [-pi/2,pi).
 	//Y Axis: Distance from origin split up across [0,diagonal length).
 	//Each pixel is the accumulation of the related input pixel's chance of being part of the line.
-	//The red channel and green channel are a machine native 16-bit unsigned integer total. The
-	//blue channel is unused.
 	//The X axis interval was chosen so that rho can represent all lines with a positive value and
 	//so we don't have to worry about angles being wrapped.
 
 	if(accumulationImage.width == 0 || accumulationImage.height == 0)
 	{
 		//Sane defaults based off of Image Processing: The Fundamentals Chapter 5. Page 520.
-		accumulationImage.width = 360 * 2;
-		accumulationImage.height = std::min(inputImage.width,inputImage.height) * 2;
+		accumulationImage.Resize(360 * 2,std::min(inputImage.width,inputImage.height) * 2);
 	}
-	accumulationImage.data.resize(accumulationImage.width * accumulationImage.height * 3);
+	else
+		accumulationImage.Resize(accumulationImage.width,accumulationImage.height);
 	std::fill(accumulationImage.data.begin(),accumulationImage.data.end(),0);
 
 	//Pre-calculate as much as possible to improve performance.
@@ -567,10 +647,10 @@ void HoughTransform(const Image& inputImage,Image& accumulationImage)
 	constexpr unsigned int IGNORE_PADDING = 10; //How much of edges to ignore so blurred edges are not counted as an edge.
 	for(unsigned int y = IGNORE_PADDING;y < inputImage.height - IGNORE_PADDING;y++)
 	{
+		const unsigned char* row = inputImage.Row(y);
 		for(unsigned int x = IGNORE_PADDING;x < inputImage.width - IGNORE_PADDING;x++)
 		{
-			const unsigned int inputIndex = (y * inputImage.width + x) * 3;
-			if(inputImage.data[inputIndex + 0] == 0)
+			if(row[x] == 0)
 				continue;
 
 			for(unsigned int z = 0;z < accumulationImage.width;z++)
@@ -581,10 +661,9 @@ void HoughTransform(const Image& inputImage,Image& accumulationImage)
 				rf *= rMultiplier;
 				const unsigned int r = Clamp(static_cast<unsigned int>(rf),0u,accumulationImage.height - 1);
 
-				const unsigned int outputIndex = (r * accumulationImage.width + z) * 3;
-				unsigned short* value = reinterpret_cast<unsigned short*>(&accumulationImage.data[outputIndex]);
-				if(*value < 0xFFFF)
-					*value += 1;
+				unsigned short& value = accumulationImage.Row(r)[z];
+				if(value < 0xFFFF)
+					value += 1;
 			}
 		}
 	}
@@ -595,22 +674,21 @@ Canny Canny::WithRadius(const float gaussianBlurRadius)
 	return Canny(gaussianBlurRadius);
 }
 
-void Canny::Process(const Image& inputImage,Image& outputImage)
+void Canny::Process(const Image<Gray8>& inputImage,Image<Gray8>& outputImage)
 {
-	Gaussian(inputImage,gaussianImage,gaussianBlurRadius);
-	Sobel(gaussianImage,gradient);
+	gaussianBlur.Process(inputImage,gaussianImage);
+	Sobel(gaussianImage,gradientMagnitude,gradientAngle);
 
 	Histogram(gaussianImage,normalizedHistogram);
 	const float highThreshold = OtsusMethod(normalizedHistogram);
 	const float lowThreshold = highThreshold / 2;
-	outputImage.MatchSize(inputImage);
-	NonMaximumSuppression(gradient,inputImage.width,inputImage.height,outputImage.data,lowThreshold,highThreshold);
+	NonMaximumSuppression(gradientMagnitude,gradientAngle,outputImage,lowThreshold,highThreshold);
 
 	ConnectivityAnalysis(outputImage);
 }
 
 Canny::Canny(const float gaussianBlurRadius)
-	: gaussianBlurRadius(gaussianBlurRadius)
+	: gaussianBlur(gaussianBlurRadius)
 {
 }
 
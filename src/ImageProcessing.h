@@ -15,24 +15,53 @@
 #include <vector>
 #include "Image.h"
 
-//Color conversion operations.
-void YUYVToRGB(const unsigned char* yuyvData,Image& frame);
-void YUYVToGreyscale(const unsigned char* yuyvData,Image& frame);
-void NV12ToRGB(const unsigned char* nv12Data,Image& frame);
-void NV12ToGreyscale(const unsigned char* nv12Data,Image& frame);
-void RGBToRGB(const unsigned char* rgbData,Image& frame);
-void RGBToGreyscale(const unsigned char* rgbData,Image& frame);
-void BGRVerticalMirroredToRGB(const unsigned char* bgrData,Image& frame);
+//Color conversion operations. Frames must already be sized to match the source data, which is
+//tightly packed.
+void YUYVToRGB(const unsigned char* yuyvData,Image<RGB8>& frame);
+void YUYVToGreyscale(const unsigned char* yuyvData,Image<Gray8>& frame);
+void NV12ToRGB(const unsigned char* nv12Data,Image<RGB8>& frame);
+void NV12ToGreyscale(const unsigned char* nv12Data,Image<Gray8>& frame);
+void RGBToRGB(const unsigned char* rgbData,Image<RGB8>& frame);
+void RGBToGreyscale(const unsigned char* rgbData,Image<Gray8>& frame);
+void BGRVerticalMirroredToRGB(const unsigned char* bgrData,Image<RGB8>& frame);
+
+//How pixels past the edge of an image are filled in.
+enum class BorderMode
+{
+	Replicate, //aaa|abcd|ddd
+	Reflect, //dcb|abcd|cba
+};
+
+//Separable Gaussian blur of one 8-bit channel. Weights are 16-bit fixed point and both passes work
+//on 16 pixels at a time using SSE2. The vertical pass reads whole rows so it streams through memory
+//like the horizontal one. Scratch space is kept between calls.
+class GaussianBlur
+{
+	public:
+		GaussianBlur(const float radius,const BorderMode borderMode = BorderMode::Reflect);
+
+		//Output is resized to match input. They must not be the same image.
+		void Process(const Image<Gray8>& inputImage,Image<Gray8>& outputImage);
+	private:
+		BorderMode borderMode;
+		unsigned int weightRadius;
+		std::vector<unsigned short> weights; //Sum to 65535, which stands in for 1.0.
+		std::vector<unsigned char> paddedRow; //Input row with the border added to both ends.
+		std::vector<unsigned char> horizontalBlur;
+		std::vector<const unsigned char*> tapRows; //Row of horizontalBlur used by each vertical tap.
+
+		void BlurRow(const unsigned char* const* rows,unsigned char* output,const unsigned int width) const; //Weighted sum of one row per weight.
+};
 
 //RGB operations.
-void BlendAdd(const Image& image1,const Image& image2,Image& outputImage);
-void Gaussian(const Image& inputImage,Image& outputImage,const float radius);
+void BlendAdd(const Image<RGB8>& image1,const Image<Gray8>& image2,Image<RGB8>& outputImage); //Grey value is added to every channel.
 
 //Greyscale operations.
-void AutoLevels(const Image& inputImage,Image& outputImage,const unsigned int ignorePadding);
-void Sobel(const Image& image,std::vector<float>& gradient); //Gradient is magnitude and angle interleaved.
-void LineThinning(const Image& inputImage,Image& outputImage);
-void HoughTransform(const Image& inputImage,Image& accumulationImage);
+void Gaussian(const Image<Gray8>& inputImage,Image<Gray8>& outputImage,const float radius);
+void AutoLevels(const Image<Gray8>& inputImage,Image<Gray8>& outputImage,const unsigned int ignorePadding);
+void Sobel(const Image<Gray8>& image,Image<GrayF>& magnitude,Image<GrayF>& angle);
+void LineThinning(const Image<Gray8>& inputImage,Image<Gray8>& outputImage);
+void HoughTransform(const Image<Gray8>& inputImage,Image<Gray16>& accumulationImage);
 
 class Canny
 {
@@ -40,15 +69,16 @@ class Canny
 		Canny(Canny&& other)=default;
 		static Canny WithRadius(const float gaussianBlurRadius);
 
-		void Process(const Image& inputImage,Image& outputImage);
+		void Process(const Image<Gray8>& inputImage,Image<Gray8>& outputImage); //Edges are 255, everything else 0.
 
 		//Internal use only variables kept around to avoid large repeated allocations. Made public
 		//to ease debugging.
-		Image gaussianImage;
+		Image<Gray8> gaussianImage;
 		std::vector<float> normalizedHistogram;
-		std::vector<float> gradient;
+		Image<GrayF> gradientMagnitude;
+		Image<GrayF> gradientAngle;
 	private:
-		float gaussianBlurRadius;
+		GaussianBlur gaussianBlur;
 
 		Canny(const float gaussianBlurRadius);
 		Canny(const Canny&)=delete;
@@ -56,4 +86,3 @@ class Canny
 };
 
 #endif
-
@@ -0,0 +1,150 @@
+// Copyright 2017 James Bendig. See the COPYRIGHT file at the top-level
+// directory of this distribution.
+//
+// Licensed under:
+//   the MIT license
+//     <LICENSE-MIT or https://opensource.org/licenses/MIT>
+//   or the Apache License, Version 2.0
+//     <LICENSE-APACHE or https://www.apache.org/licenses/LICENSE-2.0>,
+// at your option. This file may not be copied, modified, or distributed
+// except according to those terms.
+
+
+#include "MappedFile.h"
+#include <cstdio>
+#include <utility>
+#ifdef __linux
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#elif defined _WIN32
+#include <windows.h>
+#endif
+
+MappedFile::MappedFile(MappedFile&& other)
+	: data(other.data),
+	  size(other.size)
+{
+	other.data = nullptr;
+	other.size = 0;
+}
+
+MappedFile::~MappedFile()
+{
+	Unmap();
+}
+
+MappedFile& MappedFile::operator=(MappedFile&& other)
+{
+	if(this != &other)
+	{
+		Unmap();
+		std::swap(data,other.data);
+		std::swap(size,other.size);
+	}
+
+	return *this;
+}
+
+std::optional<MappedFile> MappedFile::Open(const std::string& filePath)
+{
+	//The mapping keeps the file alive so the handles aren't needed after mapping.
+#ifdef __linux
+	const int fd = open(filePath.c_str(),O_RDONLY);
+	if(fd == -1)
+		return {};
+
+	struct stat fileStatus;
+	if(fstat(fd,&fileStatus) != 0)
+	{
+		close(fd);
+		return {};
+	}
+
+	//Empty files can't be mapped but are still valid.
+	const size_t size = fileStatus.st_size;
+	if(size == 0)
+	{
+		close(fd);
+		return MappedFile(nullptr,0);
+	}
+
+	void* data = mmap(nullptr,size,PROT_READ,MAP_SHARED,fd,0);
+	close(fd);
+	if(data == MAP_FAILED)
+		return {};
+
+	return MappedFile(static_cast<const unsigned char*>(data),size);
+#elif defined _WIN32
+	HANDLE file = CreateFileA(filePath.c_str(),GENERIC_READ,FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,nullptr,OPEN_EXISTING,FILE_ATTRIBUTE_NORMAL,nullptr);
+	if(file == INVALID_HANDLE_VALUE)
+		return {};
+
+	LARGE_INTEGER fileSize;
+	if(!GetFileSizeEx(file,&fileSize))
+	{
+		CloseHandle(file);
+		return {};
+	}
+
+	const size_t size = static_cast<size_t>(fileSize.QuadPart);
+	if(size == 0)
+	{
+		CloseHandle(file);
+		return MappedFile(nullptr,0);
+	}
+
+	HANDLE mapping = CreateFileMappingA(file,nullptr,PAGE_READONLY,0,0,nullptr);
+	CloseHandle(file);
+	if(mapping == nullptr)
+		return {};
+
+	void* data = MapViewOfFile(mapping,FILE_MAP_READ,0,0,0);
+	CloseHandle(mapping);
+	if(data == nullptr)
+		return {};
+
+	return MappedFile(static_cast<const unsigned char*>(data),size);
+#endif
+}
+
+const unsigned char* MappedFile::Data() const
+{
+	return data;
+}
+
+size_t MappedFile::Size() const
+{
+	return size;
+}
+
+MappedFile::MappedFile(const unsigned char* data,const size_t size)
+	: data(data),
+	  size(size)
+{
+}
+
+void MappedFile::Unmap()
+{
+	if(data == nullptr)
+		return;
+
+#ifdef __linux
+	munmap(const_cast<unsigned char*>(data),size);
+#elif defined _WIN32
+	UnmapViewOfFile(data);
+#endif
+	data = nullptr;
+	size = 0;
+}
+
+bool ReplaceFileAtomically(const std::string& sourcePath,const std::string& destinationPath)
+{
+	//Readers either see the old file or the new one, never a partially written one.
+#ifdef __linux
+	return rename(sourcePath.c_str(),destinationPath.c_str()) == 0;
+#elif defined _WIN32
+	return MoveFileExA(sourcePath.c_str(),destinationPath.c_str(),MOVEFILE_REPLACE_EXISTING) != 0;
+#endif
+}
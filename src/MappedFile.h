@@ -0,0 +1,50 @@
+// Copyright 2017 James Bendig. See the COPYRIGHT file at the top-level
+// directory of this distribution.
+//
+// Licensed under:
+//   the MIT license
+//     <LICENSE-MIT or https://opensource.org/licenses/MIT>
+//   or the Apache License, Version 2.0
+//     <LICENSE-APACHE or https://www.apache.org/licenses/LICENSE-2.0>,
+// at your option. This file may not be copied, modified, or distributed
+// except according to those terms.
+
+
+#ifndef MAPPEDFILE_H
+#define MAPPEDFILE_H
+
+#include <cstddef>
+#include <optional>
+#include <string>
+
+//Read-only view of a whole file mapped into memory. Pages are only read from disk when touched and
+//are shared with every other process mapping the same file.
+class MappedFile
+{
+	public:
+		MappedFile(MappedFile&& other);
+		~MappedFile();
+
+		MappedFile& operator=(MappedFile&& other);
+
+		static std::optional<MappedFile> Open(const std::string& filePath);
+
+		const unsigned char* Data() const;
+		size_t Size() const;
+	private:
+		const unsigned char* data;
+		size_t size;
+
+		MappedFile(const unsigned char* data,const size_t size);
+		void Unmap();
+
+		MappedFile(const MappedFile&)=delete;
+		MappedFile& operator=(MappedFile&)=delete;
+};
+
+//Atomically replace destinationPath with sourcePath. On Linux, anything already mapping the old
+//file keeps seeing it. Windows refuses to replace a file that's mapped.
+bool ReplaceFileAtomically(const std::string& sourcePath,const std::string& destinationPath);
+
+#endif
+
@@ -0,0 +1,383 @@
+// Copyright 2017 James Bendig. See the COPYRIGHT file at the top-level
+// directory of this distribution.
+//
+// Licensed under:
+//   the MIT license
+//     <LICENSE-MIT or https://opensource.org/licenses/MIT>
+//   or the Apache License, Version 2.0
+//     <LICENSE-APACHE or https://www.apache.org/licenses/LICENSE-2.0>,
+// at your option. This file may not be copied, modified, or distributed
+// except according to those terms.
+
+
+#include "MiniBatchTrainer.h"
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+#include "NeuralNetworkData.h"
+#include "NeuralNetworkKernels.h"
+#include "TrainingCheckpoint.h"
+#include "TrainingSampleQueue.h"
+
+//Rows given to each thread are padded to this so transposed matrices fit MultiplyTransposed().
+static constexpr unsigned int ROW_ALIGNMENT = 8;
+
+static unsigned int AlignRows(const unsigned int rowCount)
+{
+	return (rowCount + ROW_ALIGNMENT - 1) / ROW_ALIGNMENT * ROW_ALIGNMENT;
+}
+
+//Row x of source becomes column x of destination for the first rowCount rows. Rows are done
+//ROW_ALIGNMENT at a time so each column is written as one contiguous run instead of scattering
+//single floats across the whole destination.
+static void Transpose(const float* source,const unsigned int sourceStride,const unsigned int rowCount,const unsigned int columnCount,float* destination,const unsigned int destinationStride)
+{
+	for(unsigned int rowStart = 0;rowStart < rowCount;rowStart += ROW_ALIGNMENT)
+	{
+		const unsigned int rowEnd = std::min(rowStart + ROW_ALIGNMENT,rowCount);
+		for(unsigned int column = 0;column < columnCount;column++)
+		{
+			float* destinationColumn = &destination[column * destinationStride];
+			for(unsigned int row = rowStart;row < rowEnd;row++)
+			{
+				destinationColumn[row] = source[row * sourceStride + column];
+			}
+		}
+	}
+}
+
+MiniBatchTrainer::Settings::Settings()
+	: optimizer(Optimizer::Adam),
+	  batchSize(256),
+	  learningRate(0.001f),
+	  momentum(0.9f),
+	  beta1(0.9f),
+	  beta2(0.999f),
+	  epsilon(1e-8f),
+	  threadCount(0)
+{
+}
+
+MiniBatchTrainer::MiniBatchTrainer(NeuralNetworkData& data,const Settings& settings)
+	: data(data),
+	  settings(settings),
+	  threadCount(1),
+	  rowsPerThread(0),
+	  randomNumberGenerator(std::random_device()()),
+	  stepCount(0)
+{
+	this->settings.batchSize = std::max(settings.batchSize,1u);
+#ifdef _OPENMP
+	threadCount = settings.threadCount == 0 ? omp_get_max_threads() : settings.threadCount;
+#endif
+	threadCount = std::max(std::min(threadCount,this->settings.batchSize),1u);
+	rowsPerThread = AlignRows((this->settings.batchSize + threadCount - 1) / threadCount);
+
+	//Hidden layer outputs are padded the same as the next layer's weights. The output layer's are
+	//padded the same way even though nothing multiplies them.
+	const Layers& layers = data.layers;
+	rowStrides.resize(layers.size() + 1);
+	deltaStrides.resize(layers.size());
+	unsigned int largestNeuronCount = 0;
+	unsigned int largestStride = 0;
+	for(unsigned int x = 0;x < layers.size();x++)
+	{
+		rowStrides[x] = layers[x].stride;
+		deltaStrides[x] = PaddedSize(layers[x].neuronCount);
+		largestNeuronCount = std::max(largestNeuronCount,layers[x].neuronCount);
+		largestStride = std::max(largestStride,layers[x].stride);
+	}
+	rowStrides.back() = deltaStrides.back();
+
+	transposedWeights.resize(layers.size());
+	firstMoments.resize(layers.size());
+	secondMoments.resize(layers.size());
+	for(unsigned int x = 0;x < layers.size();x++)
+	{
+		if(x != 0)
+			transposedWeights[x] = AlignedVector(layers[x - 1].neuronCount * deltaStrides[x],0.0f);
+		firstMoments[x] = AlignedVector(layers[x].weights.size(),0.0f);
+		if(this->settings.optimizer == Optimizer::Adam)
+			secondMoments[x] = AlignedVector(layers[x].weights.size(),0.0f);
+	}
+
+	//Everything starts zeroed so padding never contributes to any sum.
+	threadBuffers.resize(threadCount);
+	for(ThreadBuffers& buffers : threadBuffers)
+	{
+		buffers.layerRows.resize(layers.size() + 1);
+		for(unsigned int x = 0;x < buffers.layerRows.size();x++)
+		{
+			buffers.layerRows[x] = AlignedVector(rowsPerThread * rowStrides[x],0.0f);
+		}
+
+		buffers.deltas.resize(layers.size());
+		buffers.gradients.resize(layers.size());
+		for(unsigned int x = 0;x < layers.size();x++)
+		{
+			buffers.deltas[x] = AlignedVector(rowsPerThread * deltaStrides[x],0.0f);
+			buffers.gradients[x] = AlignedVector(layers[x].weights.size(),0.0f);
+		}
+
+		buffers.transposedDeltas = AlignedVector(largestNeuronCount * rowsPerThread,0.0f);
+		buffers.transposedInputs = AlignedVector(largestStride * rowsPerThread,0.0f);
+		buffers.labels.resize(rowsPerThread);
+		buffers.error = 0.0f;
+	}
+
+	sampleOrder.resize(data.trainingData.size());
+	std::iota(sampleOrder.begin(),sampleOrder.end(),0);
+}
+
+float MiniBatchTrainer::TrainEpoch()
+{
+	std::shuffle(sampleOrder.begin(),sampleOrder.end(),randomNumberGenerator);
+
+	float totalError = 0.0f;
+	for(unsigned int batchStart = 0;batchStart < sampleOrder.size();batchStart += settings.batchSize)
+	{
+		const unsigned int batchSize = std::min(settings.batchSize,static_cast<unsigned int>(sampleOrder.size()) - batchStart);
+		const unsigned int* samples = &sampleOrder[batchStart];
+		totalError += TrainBatch(batchSize,[this,samples](const unsigned int row,float* inputRow) {
+			const std::pair<AlignedVector,unsigned char>& sample = data.trainingData[samples[row]];
+			std::copy(sample.first.cbegin(),sample.first.cend(),inputRow);
+			return sample.second;
+		});
+	}
+
+	return totalError;
+}
+
+float MiniBatchTrainer::TrainEpoch(TrainingSampleQueue& queue,const unsigned int sampleCount)
+{
+	const unsigned int inputSize = queue.SampleSize();
+	float totalError = 0.0f;
+	for(unsigned int batchStart = 0;batchStart < sampleCount;batchStart += settings.batchSize)
+	{
+		const unsigned int batchSize = std::min(settings.batchSize,sampleCount - batchStart);
+		queuedInputs.clear();
+		queuedLabels.clear();
+		if(!queue.PopRandom(batchSize,queuedInputs,queuedLabels))
+			break;
+
+		//Samples are queued as bytes and only widened to floats here, a batch at a time.
+		totalError += TrainBatch(batchSize,[this,inputSize](const unsigned int row,float* inputRow) {
+			const unsigned char* input = &queuedInputs[row * inputSize];
+			std::copy(input,input + inputSize,inputRow);
+			inputRow[inputSize] = 1.0f;
+			return queuedLabels[row];
+		});
+	}
+
+	return totalError;
+}
+
+void MiniBatchTrainer::Snapshot(TrainingCheckpoint& checkpoint) const
+{
+	checkpoint = TrainingCheckpoint(data);
+	checkpoint.optimizer = static_cast<unsigned int>(settings.optimizer);
+	checkpoint.stepCount = stepCount;
+	checkpoint.firstMoments = firstMoments;
+	if(settings.optimizer == Optimizer::Adam)
+		checkpoint.secondMoments = secondMoments;
+}
+
+bool MiniBatchTrainer::Restore(const TrainingCheckpoint& checkpoint)
+{
+	if(!checkpoint.Matches(data))
+		return false;
+
+	checkpoint.RestoreWeights(data);
+
+	//Moments from a different optimizer mean something else so start those over.
+	const bool sameOptimizer = checkpoint.optimizer == static_cast<unsigned int>(settings.optimizer) &&
+							   checkpoint.firstMoments.size() == firstMoments.size() &&
+							   (settings.optimizer != Optimizer::Adam || checkpoint.secondMoments.size() == secondMoments.size());
+	for(unsigned int x = 0;x < firstMoments.size();x++)
+	{
+		if(sameOptimizer)
+			firstMoments[x] = checkpoint.firstMoments[x];
+		else
+			std::fill(firstMoments[x].begin(),firstMoments[x].end(),0.0f);
+		if(settings.optimizer != Optimizer::Adam)
+			continue;
+		else if(sameOptimizer)
+			secondMoments[x] = checkpoint.secondMoments[x];
+		else
+			std::fill(secondMoments[x].begin(),secondMoments[x].end(),0.0f);
+	}
+	stepCount = sameOptimizer ? checkpoint.stepCount : 0;
+
+	return true;
+}
+
+float MiniBatchTrainer::TrainBatch(const unsigned int batchSize,const PrepareRowFunction& prepareRow)
+{
+	TransposeWeights();
+
+	//Every thread takes its own rows of the batch through the whole network and back.
+#pragma omp parallel for num_threads(threadCount) schedule(static,1)
+	for(int thread = 0;thread < static_cast<int>(threadCount);thread++) //Signed for OpenMP 2.0.
+	{
+		const unsigned int rowStart = std::min(thread * rowsPerThread,batchSize);
+		const unsigned int rowEnd = std::min(rowStart + rowsPerThread,batchSize);
+		ComputeGradients(threadBuffers[thread],rowStart,rowEnd - rowStart,prepareRow);
+	}
+
+	//Only the leading threads get rows when the batch doesn't divide evenly.
+	const unsigned int activeThreadCount = (batchSize + rowsPerThread - 1) / rowsPerThread;
+	float error = 0.0f;
+	for(unsigned int x = 0;x < activeThreadCount;x++)
+	{
+		error += threadBuffers[x].error;
+	}
+
+	//Adam's bias correction is folded into the step size.
+	stepCount += 1;
+	float stepSize = settings.learningRate;
+	if(settings.optimizer == Optimizer::Adam)
+		stepSize *= std::sqrt(1.0 - std::pow(settings.beta2,stepCount)) / (1.0 - std::pow(settings.beta1,stepCount));
+
+	//Sum the threads' gradients and update the weights, splitting each layer's neurons across
+	//threads.
+	const Layers& layers = data.layers;
+	const float gradientScale = 1.0f / batchSize;
+#pragma omp parallel num_threads(threadCount)
+	for(unsigned int x = 0;x < layers.size();x++)
+	{
+#pragma omp for
+		for(int y = 0;y < static_cast<int>(layers[x].neuronCount);y++) //Signed for OpenMP 2.0.
+		{
+			ApplyGradients(x,y,activeThreadCount,gradientScale,stepSize);
+		}
+	}
+
+	return error;
+}
+
+void MiniBatchTrainer::TransposeWeights()
+{
+	const Layers& layers = data.layers;
+	for(unsigned int x = 1;x < layers.size();x++)
+	{
+		Transpose(&layers[x].weights[0],layers[x].stride,layers[x].neuronCount,layers[x - 1].neuronCount,&transposedWeights[x][0],deltaStrides[x]);
+	}
+}
+
+void MiniBatchTrainer::ComputeGradients(ThreadBuffers& buffers,const unsigned int rowStart,const unsigned int sampleCount,const PrepareRowFunction& prepareRow)
+{
+	buffers.error = 0.0f;
+	if(sampleCount == 0)
+		return;
+
+	//Run forward the same as NeuralNetwork::RunBatch() but keep every layer's outputs.
+	const Layers& layers = data.layers;
+	for(unsigned int x = 0;x < sampleCount;x++)
+	{
+		buffers.labels[x] = prepareRow(rowStart + x,&buffers.layerRows[0][x * rowStrides[0]]);
+	}
+	for(unsigned int x = 0;x < layers.size();x++)
+	{
+		const Layer& layer = layers[x];
+		float* outputRows = &buffers.layerRows[x + 1][0];
+		MultiplyTransposed(&buffers.layerRows[x][0],rowStrides[x],&layer.weights[0],layer.stride,outputRows,rowStrides[x + 1],sampleCount,layer.neuronCount,layer.stride);
+
+		for(unsigned int y = 0;y < sampleCount;y++)
+		{
+			float* outputRow = &outputRows[y * rowStrides[x + 1]];
+			Activate(layer.activation,outputRow,layer.neuronCount);
+			outputRow[layer.neuronCount] = 1.0f;
+		}
+	}
+
+	//Output layer error.
+	const Layer& outputLayer = layers.back();
+	for(unsigned int x = 0;x < sampleCount;x++)
+	{
+		ExpectedOutput(data.outputChoices,buffers.labels[x],buffers.expectedOutput);
+		const float* outputRow = &buffers.layerRows.back()[x * rowStrides.back()];
+		float* deltaRow = &buffers.deltas.back()[x * deltaStrides.back()];
+		for(unsigned int y = 0;y < outputLayer.neuronCount;y++)
+		{
+			const float delta = (buffers.expectedOutput[y] - outputRow[y]) * ActivationDiff(outputLayer.activation,outputRow[y]);
+			deltaRow[y] = delta;
+			buffers.error += std::fabs(delta);
+		}
+	}
+
+	//Back propagate starting with the output layer. Each weight's gradient is the sum over samples
+	//of its neuron's delta times its input. That's a multiply of the transposed deltas (a row per
+	//neuron) with the transposed inputs (a row per input). Rows past sampleCount are zeroed in the
+	//transposed deltas so left over inputs from a bigger batch add nothing.
+	const unsigned int paddedSampleCount = AlignRows(sampleCount);
+	for(int x = layers.size() - 1;x >= 0;x--)
+	{
+		const Layer& layer = layers[x];
+		float* transposedDeltas = &buffers.transposedDeltas[0];
+		Transpose(&buffers.deltas[x][0],deltaStrides[x],sampleCount,layer.neuronCount,transposedDeltas,paddedSampleCount);
+		for(unsigned int y = 0;y < layer.neuronCount;y++)
+		{
+			std::fill(&transposedDeltas[y * paddedSampleCount + sampleCount],&transposedDeltas[(y + 1) * paddedSampleCount],0.0f);
+		}
+		Transpose(&buffers.layerRows[x][0],rowStrides[x],sampleCount,layer.stride,&buffers.transposedInputs[0],paddedSampleCount);
+		MultiplyTransposed(transposedDeltas,paddedSampleCount,&buffers.transposedInputs[0],paddedSampleCount,&buffers.gradients[x][0],layer.stride,layer.neuronCount,layer.stride,paddedSampleCount);
+
+		if(x == 0)
+			break;
+
+		//Push the deltas back through this layer's weights to the previous layer's outputs.
+		const Layer& previousLayer = layers[x - 1];
+		MultiplyTransposed(&buffers.deltas[x][0],deltaStrides[x],&transposedWeights[x][0],deltaStrides[x],&buffers.deltas[x - 1][0],deltaStrides[x - 1],sampleCount,previousLayer.neuronCount,deltaStrides[x]);
+		for(unsigned int y = 0;y < sampleCount;y++)
+		{
+			const float* outputRow = &buffers.layerRows[x][y * rowStrides[x]];
+			float* deltaRow = &buffers.deltas[x - 1][y * deltaStrides[x - 1]];
+			for(unsigned int z = 0;z < previousLayer.neuronCount;z++)
+			{
+				deltaRow[z] *= ActivationDiff(previousLayer.activation,outputRow[z]);
+			}
+		}
+	}
+}
+
+void MiniBatchTrainer::ApplyGradients(const unsigned int layer,const unsigned int neuron,const unsigned int activeThreadCount,const float gradientScale,const float stepSize)
+{
+	//Gradients point towards less error, same as the per-sample trainer's corrections, so they're
+	//added to the weights. Padding always has a zero gradient so it stays zero.
+	const unsigned int stride = data.layers[layer].stride;
+	const unsigned int offset = neuron * stride;
+	float* gradient = &threadBuffers[0].gradients[layer][offset];
+	for(unsigned int x = 1;x < activeThreadCount;x++)
+	{
+		const float* threadGradient = &threadBuffers[x].gradients[layer][offset];
+		for(unsigned int y = 0;y < stride;y++)
+		{
+			gradient[y] += threadGradient[y];
+		}
+	}
+
+	float* weights = data.layers[layer].Neuron(neuron);
+	float* firstMoment = &firstMoments[layer][offset];
+	if(settings.optimizer == Optimizer::Momentum)
+	{
+		for(unsigned int x = 0;x < stride;x++)
+		{
+			firstMoment[x] = settings.momentum * firstMoment[x] + gradient[x] * gradientScale;
+			weights[x] += stepSize * firstMoment[x];
+		}
+	}
+	else
+	{
+		float* secondMoment = &secondMoments[layer][offset];
+		for(unsigned int x = 0;x < stride;x++)
+		{
+			const float scaledGradient = gradient[x] * gradientScale;
+			firstMoment[x] = settings.beta1 * firstMoment[x] + (1.0f - settings.beta1) * scaledGradient;
+			secondMoment[x] = settings.beta2 * secondMoment[x] + (1.0f - settings.beta2) * scaledGradient * scaledGradient;
+			weights[x] += stepSize * firstMoment[x] / (std::sqrt(secondMoment[x]) + settings.epsilon);
+		}
+	}
+}
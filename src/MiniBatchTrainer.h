@@ -0,0 +1,108 @@
+// Copyright 2017 James Bendig. See the COPYRIGHT file at the top-level
+// directory of this distribution.
+//
+// Licensed under:
+//   the MIT license
+//     <LICENSE-MIT or https://opensource.org/licenses/MIT>
+//   or the Apache License, Version 2.0
+//     <LICENSE-APACHE or https://www.apache.org/licenses/LICENSE-2.0>,
+// at your option. This file may not be copied, modified, or distributed
+// except according to those terms.
+
+
+#ifndef MINIBATCHTRAINER_H
+#define MINIBATCHTRAINER_H
+
+#include <functional>
+#include <random>
+#include <vector>
+#include "AlignedVector.h"
+
+struct NeuralNetworkData;
+struct TrainingCheckpoint;
+class TrainingSampleQueue;
+
+//Trains a network by back propagation on batches of samples instead of one sample at a time. Each
+//batch is split across threads. Every thread runs its rows through the network and computes its
+//own weight gradients as matrix multiplies. The gradients are then summed and applied once per
+//batch using momentum or Adam.
+class MiniBatchTrainer
+{
+	public:
+		enum class Optimizer
+		{
+			Momentum, //step = momentum * step + gradient
+			Adam, //Per-weight step sizes from running averages of the gradient and its square.
+		};
+
+		struct Settings
+		{
+			Optimizer optimizer;
+			unsigned int batchSize;
+			float learningRate;
+			float momentum; //Momentum only.
+			float beta1; //Adam only.
+			float beta2; //Adam only.
+			float epsilon; //Adam only.
+			unsigned int threadCount; //0 uses OpenMP's default (OMP_NUM_THREADS or one per core).
+
+			Settings(); //Adam with its usual defaults.
+		};
+
+		MiniBatchTrainer(NeuralNetworkData& data,const Settings& settings);
+
+		//Runs every training sample once in a new random order and returns the sum of the output
+		//errors, same as the per-sample trainer reported.
+		float TrainEpoch();
+
+		//Same as above but trains on sampleCount samples taken from queue as they're generated
+		//instead of data.trainingData. Stops early if the queue is closed.
+		float TrainEpoch(TrainingSampleQueue& queue,const unsigned int sampleCount);
+
+		//Copies the weights and optimizer state so they can be saved while training continues.
+		void Snapshot(TrainingCheckpoint& checkpoint) const;
+
+		//Continues from a checkpoint of the same network. The optimizer state is only used if it
+		//came from the same optimizer. Returns false and changes nothing if the network differs.
+		bool Restore(const TrainingCheckpoint& checkpoint);
+	private:
+		//Fills in the padded input row, including the 1.0f bias input, for row x of the batch and
+		//returns its label.
+		using PrepareRowFunction = std::function<unsigned char(const unsigned int,float*)>;
+
+		//Per-thread scratch space. Matrices have one row per sample of the thread's part of a batch.
+		struct ThreadBuffers
+		{
+			std::vector<AlignedVector> layerRows; //Input followed by each layer's outputs. Rows end with the 1.0f bias input.
+			std::vector<AlignedVector> deltas; //Each layer's error with respect to its sums.
+			std::vector<AlignedVector> gradients; //Same layout as each layer's weights.
+			AlignedVector transposedDeltas;
+			AlignedVector transposedInputs;
+			AlignedVector expectedOutput;
+			std::vector<unsigned char> labels;
+			float error;
+		};
+
+		NeuralNetworkData& data;
+		Settings settings;
+		unsigned int threadCount;
+		unsigned int rowsPerThread; //A multiple of 8 so transposed rows stay SIMD sized.
+		std::vector<unsigned int> rowStrides; //Stride of each matrix in ThreadBuffers::layerRows.
+		std::vector<unsigned int> deltaStrides;
+		std::vector<AlignedVector> transposedWeights; //Column x of a layer's weights is row x. Used to push deltas back a layer.
+		std::vector<AlignedVector> firstMoments; //Momentum's step or Adam's average gradient.
+		std::vector<AlignedVector> secondMoments; //Adam's average squared gradient.
+		std::vector<ThreadBuffers> threadBuffers;
+		std::vector<unsigned int> sampleOrder;
+		std::vector<unsigned char> queuedInputs; //Current batch taken from a TrainingSampleQueue.
+		std::vector<unsigned char> queuedLabels;
+		std::mt19937 randomNumberGenerator;
+		unsigned int stepCount;
+
+		void TransposeWeights();
+		float TrainBatch(const unsigned int batchSize,const PrepareRowFunction& prepareRow);
+		void ComputeGradients(ThreadBuffers& buffers,const unsigned int rowStart,const unsigned int sampleCount,const PrepareRowFunction& prepareRow);
+		void ApplyGradients(const unsigned int layer,const unsigned int neuron,const unsigned int activeThreadCount,const float gradientScale,const float stepSize);
+};
+
+#endif
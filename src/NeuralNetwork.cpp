@@ -15,122 +15,40 @@
 #include <iostream>
 #include <cassert>
 #include <cmath>
-#ifdef USE_AVX
-#include <immintrin.h> //AVX
-#include <pmmintrin.h> //SSE3
-#include <xmmintrin.h> //SSE
+#include <thread>
+#ifdef _OPENMP
+#include <omp.h>
 #endif
 #include "DeltaTimer.h"
+#include "MiniBatchTrainer.h"
 #include "NeuralNetworkData.h"
+#include "NeuralNetworkKernels.h"
+#include "QuantizedNeuralNetwork.h"
+#include "TrainingCheckpoint.h"
+#include "TrainingSampleQueue.h"
 
 
-static const char* TRAINING_DATA_FILE_PATH = "training.dat";
+static const char* TRAINING_DATA_FILE_PATH = "training.dat"; //Only read to resume training started by older versions.
+static const char* TRAINING_CHECKPOINT_FILE_PATH = "training_checkpoint.dat";
 static const char* TRAINED_DATA_FILE_PATH = "trained.dat";
 
-static float Sigmoid(const float value)
-{
-	const float exponent = value;
-	return 1.0f / (1.0f + exp(-exponent));
-}
-
-static float SigmoidDiff(const float sigmoidValue)
-{
-	return sigmoidValue * (1 - sigmoidValue);
-}
-
-static void UpdateWeights(const AlignedVector& input,const float multiplier,AlignedVector& weights)
-{
-	assert(input.size() <= weights.size());
-
-#ifdef USE_AVX
-	const __m256 mulv = _mm256_set1_ps(multiplier);
-	for(unsigned int x = 0;x < input.size();x += 8)
-	{
-		const __m256 weights8 = _mm256_load_ps(&weights[x]);
-		const __m256 input8 = _mm256_load_ps(&input[x]);
-		const __m256 sums8 = _mm256_add_ps(weights8,_mm256_mul_ps(input8,mulv));
-		_mm256_store_ps(&weights[x],sums8);
-	}
-#else
-	for(unsigned int x = 0;x < input.size();x++)
-	{
-		weights[x] += input[x] * multiplier;
-	}
-#endif
-}
-
-
+//Samples waiting to be trained on. About 4MB of 16x16 tiles and far more than a batch so samples
+//taken from it at random are well mixed.
+static constexpr unsigned int SAMPLE_QUEUE_CAPACITY = 16384;
 
-static void RunNeuron(const AlignedVector& weights,const AlignedVector& input,float& output)
-{
-	assert(input.size() <= weights.size());
-
-#ifdef USE_AVX
-	assert((input.size() % 8) == 0);
-
-	__m256 sumv = _mm256_setzero_ps();
-	for(unsigned int x = 0;x < input.size();x += 8)
-	{
-		const __m256 weights8 = _mm256_load_ps(&weights[x]);
-		const __m256 input8 = _mm256_load_ps(&input[x]);
-		const __m256 multiplied = _mm256_mul_ps(weights8,input8);
-		sumv = _mm256_add_ps(sumv,multiplied);
-	}
-
-	const float sum = sumv[0] + sumv[1] + sumv[2] + sumv[3] + sumv[4] + sumv[5] + sumv[6] + sumv[7];
-#else
-	float sum = 0.0f;
-	for(unsigned int x = 0;x < input.size();x++)
-	{
-		sum += weights[x] * static_cast<float>(input[x]);
-	}
-#endif
-
-	output = Sigmoid(sum);
-}
-
-static void RunNetwork(const std::vector<std::vector<AlignedVector>>& layers,const AlignedVector& data,std::vector<AlignedVector>& layerOutputs)
-{
-	for(unsigned int x = 0;x < layers.size();x++)
-	{
-		const std::vector<AlignedVector>& layer = layers[x];
-
-		AlignedVector& outputs = layerOutputs[x];
-#pragma omp parallel for
-		for(int y = 0;y < static_cast<int>(layer.size());y++) //Signed for OpenMP 2.0.
-		{
-			const AlignedVector& weights = layer[y];
-
-			float output = 0.0f;
-			if(x == 0)
-				RunNeuron(weights,data,output);
-			else
-				RunNeuron(weights,layerOutputs[x - 1],output);
-
-			outputs[y] = output;
-		}
-	}
-}
-
-template <class A,class B>
-static void RunNeuronTrained(const A& weights,const B& input,float& output)
+//Input is either the raw unsigned char tile or the previous layer's unpadded float outputs. The
+//bias weight follows the input weights.
+template <class T>
+static void RunNeuronTrained(const float* weights,const T& input,float& output)
 {
-	assert(input.size() < weights.size());
-
-	float sum = 0.0f;
-	for(unsigned int x = 0;x < input.size();x++)
-	{
-		sum += static_cast<float>(weights[x]) * static_cast<float>(input[x]);
-	}
-	sum += weights[input.size()];
-
-	output = Sigmoid(sum);
+	output = DotProduct(weights,&input[0],input.size()) + weights[input.size()];
 }
 
-//RunNetworkTrained is used on a trained network. It differs from the training version in that the
-//input data should not be preprocessed.
+//RunNetworkTrained is used on a trained network. Unlike the training data, the input data should
+//not be preprocessed. Layers are far too small to be worth splitting across
+//threads so this always runs on the calling thread.
 template <class T>
-static void RunNetworkTrained(const std::vector<std::vector<AlignedVector>>& layers,const std::vector<T>& data,std::vector<AlignedVector>& layerOutputs)
+static void RunNetworkTrained(const Layers& layers,const std::vector<T>& data,std::vector<AlignedVector>& layerOutputs)
 {
 	//Reserve buffer space only on first call. Not safe but this is measurably faster.
 	if(layerOutputs.empty())
@@ -138,19 +56,18 @@ static void RunNetworkTrained(const std::vector<std::vector<AlignedVector>>& lay
 		layerOutputs.resize(layers.size());
 		for(unsigned int x = 0;x < layers.size();x++)
 		{
-			layerOutputs[x].resize(layers[x].size());
+			layerOutputs[x].resize(layers[x].neuronCount);
 		}
 	}
 
 	for(unsigned int x = 0;x < layers.size();x++)
 	{
-		const std::vector<AlignedVector>& layer = layers[x];
+		const Layer& layer = layers[x];
 
 		AlignedVector& outputs = layerOutputs[x];
-#pragma omp parallel for
-		for(int y = 0;y < static_cast<int>(layer.size());y++) //Signed for OpenMP 2.0.
+		for(unsigned int y = 0;y < layer.neuronCount;y++)
 		{
-			const AlignedVector& weights = layer[y];
+			const float* weights = layer.Neuron(y);
 
 			float output = 0.0f;
 			if(x == 0)
@@ -160,113 +77,110 @@ static void RunNetworkTrained(const std::vector<std::vector<AlignedVector>>& lay
 
 			outputs[y] = output;
 		}
+		Activate(layer.activation,&outputs[0],layer.neuronCount);
 	}
 }
 
-NeuralNetwork NeuralNetwork::Train(std::function<void(std::vector<std::pair<std::vector<unsigned char>,unsigned char>>&)> buildTrainingDataFunc)
+NeuralNetwork NeuralNetwork::Train(const std::vector<unsigned char>& outputChoices,const unsigned int samplesPerEpoch,std::function<void(std::vector<std::pair<std::vector<unsigned char>,unsigned char>>&)> generateSamples)
+{
+	return Train(outputChoices,samplesPerEpoch,generateSamples,Activation::Sigmoid,Activation::Sigmoid);
+}
+
+NeuralNetwork NeuralNetwork::Train(const std::vector<unsigned char>& outputChoices,const unsigned int samplesPerEpoch,std::function<void(std::vector<std::pair<std::vector<unsigned char>,unsigned char>>&)> generateSamples,const Activation hiddenActivation,const Activation outputActivation)
 {
 	NeuralNetwork nn;
 
-	//Try and load a pre-trained set first.
-	if(nn.data->LoadFromBinary(TRAINED_DATA_FILE_PATH))
+	//Try and load a pre-trained set first. Sets saved in the old binary format are converted so
+	//later runs can map them directly. The old format isn't validated so a damaged model is never
+	//read as one. It's retrained and replaced instead.
+	if(nn.data->LoadFromModel(TRAINED_DATA_FILE_PATH))
 		return nn;
-
-	//Try and resume from previous training attempt.
-	if(!nn.data->LoadFromBinary(TRAINING_DATA_FILE_PATH))
+	else if(NeuralNetworkData::IsModel(TRAINED_DATA_FILE_PATH))
+		std::cerr << "Ignoring unusable " << TRAINED_DATA_FILE_PATH << " and training a new network." << std::endl;
+	else if(nn.data->LoadFromBinary(TRAINED_DATA_FILE_PATH))
 	{
-		//Otherwise, start training using a new set.
-		std::vector<std::pair<std::vector<unsigned char>,unsigned char>> trainingData;
-		buildTrainingDataFunc(trainingData);
-		if(trainingData.empty())
-			return NeuralNetwork();
-		nn.data->InitializeWithTrainingData(trainingData);
+		nn.data->SaveAsModel(TRAINED_DATA_FILE_PATH);
+		return nn;
 	}
 
-	//Train by back propagation.
-	const float correctionIncrement = 0.005f;
-	AlignedVector expectedOutput;
-	std::vector<AlignedVector> layerLittleDeltas(nn.data->layers.size());
-	DeltaTimer deltaTimer;
-	for(unsigned int x = 0;x < 1500;x++)
+	//The first samples decide how big the input is.
+	std::vector<std::pair<std::vector<unsigned char>,unsigned char>> samples;
+	generateSamples(samples);
+	if(samples.empty())
+		return NeuralNetwork();
+	const unsigned int inputSize = samples[0].first.size();
+
+	//Try and resume from previous training attempt. Otherwise, start training using a new set.
+	//Attempts by older versions only saved weights in the training data file.
+	nn.data->Initialize(inputSize,outputChoices,hiddenActivation,outputActivation);
+	TrainingCheckpoint checkpoint;
+	if(!checkpoint.Load(TRAINING_CHECKPOINT_FILE_PATH))
 	{
-		std::cout << "Training " << x << " ... ";
-		std::cout.flush();
+		NeuralNetworkData previousData;
+		if(previousData.LoadFromBinary(TRAINING_DATA_FILE_PATH))
+			checkpoint = TrainingCheckpoint(previousData);
+	}
 
-		float totalError = 0;
-		for(const std::pair<AlignedVector,unsigned char>& data : nn.data->trainingData)
+	//Train by back propagation on mini-batches split across every core. This thread keeps the
+	//queue topped up with new samples until training is done and closes the queue.
+	TrainingSampleQueue queue(inputSize,SAMPLE_QUEUE_CAPACITY);
+	std::thread trainingThread([&nn,&queue,&checkpoint,samplesPerEpoch]() {
+		MiniBatchTrainer trainer(*nn.data,MiniBatchTrainer::Settings());
+		if(trainer.Restore(checkpoint))
+			std::cout << "Resuming training" << std::endl;
+
+		//Checkpoints are only copied here and saved in the background.
+		CheckpointWriter checkpointWriter(TRAINING_CHECKPOINT_FILE_PATH);
+		DeltaTimer deltaTimer;
+		for(unsigned int x = 0;x < 1500;x++)
 		{
-			RunNetwork(nn.data->layers,data.first,nn.data->layerOutputs);
-			ExpectedOutput(nn.data->outputChoices,data.second,expectedOutput);
-
-			//Adjust the output weights first.
-			std::vector<AlignedVector>& outputLayer = nn.data->layers.back();
-			const AlignedVector& outputs = nn.data->layerOutputs.back();
-			layerLittleDeltas.back().resize(outputLayer.size());
-			for(unsigned int y = 0;y < outputLayer.size();y++)
-			{
-				const float littleDelta = (expectedOutput[y] - outputs[y]) * SigmoidDiff(outputs[y]);
-				layerLittleDeltas.back()[y] = littleDelta;
-				totalError += fabsf(littleDelta);
+			std::cout << "Training " << x << " ... ";
+			std::cout.flush();
 
-				const float multiplier = correctionIncrement * littleDelta;
-				AlignedVector& weights = outputLayer[y];
-				UpdateWeights(nn.data->layerOutputs[nn.data->layerOutputs.size() - 2],multiplier,weights);
-			}
+			const float totalError = trainer.TrainEpoch(queue,samplesPerEpoch);
+
+			deltaTimer.Update();
+			std::cout  << deltaTimer.Delta() << " sec(s) with error " << totalError << std::endl;
 
-			//Adjust the hidden layer weights in reverse order starting with those just before the
-			//output layer.
-			for(int l = nn.data->layerOutputs.size() - 2;l >= 0;l--)
+			//Save every once in a while since processing can take hours.
+			if(totalError < 1.0f || (x != 0 && (x % 25) == 0))
 			{
-				std::vector<AlignedVector>& layer = nn.data->layers[l];
-				const std::vector<AlignedVector>& nextLayer = nn.data->layers[l + 1];
-				const AlignedVector& outputs = nn.data->layerOutputs[l];
-
-				layerLittleDeltas[l].resize(layer.size());
-#pragma omp parallel for
-				for(int y = 0;y < static_cast<int>(layer.size());y++) //Signed for OpenMP 2.0.
-				{
-					float littleDelta = 0.0f;
-					for(unsigned int z = 0;z < layerLittleDeltas[l + 1].size();z++)
-					{
-						littleDelta += layerLittleDeltas[l + 1][z] * nextLayer[z][y];
-					}
-					littleDelta *= SigmoidDiff(outputs[y]);
-
-					AlignedVector& weights = layer[y];
-					const float multiplier = correctionIncrement * littleDelta;
-					if(l == 0)
-						UpdateWeights(data.first,multiplier,weights);
-					else
-						UpdateWeights(nn.data->layerOutputs[l - 1],multiplier,weights);
-
-					layerLittleDeltas[l][y] = littleDelta;
-				}
+				trainer.Snapshot(checkpoint);
+				checkpointWriter.Write(std::move(checkpoint));
+				deltaTimer.Update();
+				std::cout << "Took " << deltaTimer.Delta() << " sec(s) to checkpoint" << std::endl;
 			}
 		}
 
-		deltaTimer.Update();
-		std::cout  << deltaTimer.Delta() << " sec(s) with error " << totalError << std::endl;
+		queue.Close();
+	});
 
-		//Save every once in a while since processing can take hours.
-		if(totalError < 1.0f || (x != 0 && (x % 25) == 0))
+	bool producing = true;
+	while(producing)
+	{
+		for(const std::pair<std::vector<unsigned char>,unsigned char>& sample : samples)
 		{
-			nn.data->SaveAsBinary(TRAINING_DATA_FILE_PATH);
-			deltaTimer.Update();
-			std::cout << "Took " << deltaTimer.Delta() << " sec(s) to save" << std::endl;
+			if(!queue.Push(sample.first,sample.second))
+			{
+				producing = false;
+				break;
+			}
 		}
+
+		samples.clear();
+		if(producing)
+			generateSamples(samples);
 	}
+	trainingThread.join();
 
-	//Done training, no reason to keep the (potentially large) training data around.
-	nn.data->trainingData.clear();
-	nn.data->trainingData.shrink_to_fit();
-	nn.data->SaveAsBinary(TRAINED_DATA_FILE_PATH);
+	nn.data->SaveAsModel(TRAINED_DATA_FILE_PATH);
 
 	return nn;
 }
 
 unsigned char NeuralNetwork::Run(const std::vector<unsigned char>& inputData) const
 {
-	const unsigned int paddedInputSize = inputData.size() + 1 + 8 - (inputData.size() + 1) % 8;
+	const unsigned int paddedInputSize = PaddedSize(inputData.size());
 	if(paddedInputSize != data->inputSize)
 	{
 		std::cerr << "NeuralNetwork::Run(): Got unexpected input data size." << std::endl;
@@ -283,8 +197,190 @@ unsigned char NeuralNetwork::Run(const std::vector<unsigned char>& inputData) co
 	return data->outputChoices[std::distance(layerOutputs.back().cbegin(),maxElementIter)];
 }
 
+void NeuralNetwork::RunBatch(const std::vector<std::vector<unsigned char>>& inputData,std::vector<unsigned char>& outputs) const
+{
+	outputs.clear();
+	if(inputData.empty())
+		return;
+
+	const unsigned int originalInputSize = inputData[0].size();
+	const unsigned int paddedInputSize = PaddedSize(originalInputSize);
+	if(paddedInputSize != data->inputSize || data->layers.empty())
+	{
+		std::cerr << "NeuralNetwork::RunBatch(): Got unexpected input data size." << std::endl;
+		std::abort();
+	}
+	for(const std::vector<unsigned char>& input : inputData)
+	{
+		if(input.size() != originalInputSize)
+		{
+			std::cerr << "NeuralNetwork::RunBatch(): Got unexpected input data size." << std::endl;
+			std::abort();
+		}
+	}
+
+	//Every layer, starting with the first, is a matrix multiply of the previous one's rows.
+	const unsigned int inputStride = data->layers[0].stride;
+	RunBatchLayers(inputData.size(),0,[&inputData,inputStride,originalInputSize](const unsigned int rowStart,const unsigned int rowEnd,std::vector<AlignedVector>& layerRows)
+	{
+		for(unsigned int x = rowStart;x < rowEnd;x++)
+		{
+			float* inputRow = &layerRows[0][x * inputStride];
+			std::copy(inputData[x].cbegin(),inputData[x].cend(),inputRow);
+			inputRow[originalInputSize] = 1.0f;
+		}
+	},outputs);
+}
+
+void NeuralNetwork::RunBatch(const std::vector<PackedInput>& inputData,const unsigned int inputSize,std::vector<unsigned char>& outputs) const
+{
+	outputs.clear();
+	if(inputData.empty())
+		return;
+
+	if(PaddedSize(inputSize) != data->inputSize || data->layers.empty())
+	{
+		std::cerr << "NeuralNetwork::RunBatch(): Got unexpected input data size." << std::endl;
+		std::abort();
+	}
+	const unsigned int wordCount = (inputSize + 63) / 64;
+	for(const PackedInput& input : inputData)
+	{
+		if(input.size() < wordCount)
+		{
+			std::cerr << "NeuralNetwork::RunBatch(): Got unexpected input data size." << std::endl;
+			std::abort();
+		}
+	}
+
+	//Every input is 0 or 1 so the first layer only needs to add up the weights of the set bits.
+	//The remaining layers are run as usual.
+	const Layer& firstLayer = data->layers[0];
+	const unsigned int outputStride = LayerRowStride(data->layers,1);
+	RunBatchLayers(inputData.size(),1,[&inputData,&firstLayer,inputSize,outputStride](const unsigned int rowStart,const unsigned int rowEnd,std::vector<AlignedVector>& layerRows)
+	{
+		for(unsigned int x = rowStart;x < rowEnd;x++)
+		{
+			float* outputRow = &layerRows[1][x * outputStride];
+			for(unsigned int y = 0;y < firstLayer.neuronCount;y++)
+			{
+				const float* weights = firstLayer.Neuron(y);
+				outputRow[y] = MaskedSum(weights,&inputData[x][0],inputSize) + weights[inputSize];
+			}
+			Activate(firstLayer.activation,outputRow,firstLayer.neuronCount);
+			outputRow[firstLayer.neuronCount] = 1.0f;
+		}
+	},outputs);
+}
+
+unsigned int NeuralNetwork::LayerRowStride(const Layers& layers,const unsigned int layer)
+{
+	//Rows use the same stride as the weights they're multiplied with. The output layer's rows
+	//aren't multiplied with anything but are padded the same way.
+	if(layer < layers.size())
+		return layers[layer].stride;
+	return PaddedSize(layers.back().neuronCount);
+}
+
+void NeuralNetwork::RunBatchLayers(const unsigned int inputCount,const unsigned int firstLayer,const std::function<void(const unsigned int,const unsigned int,std::vector<AlignedVector>&)>& prepareRows,std::vector<unsigned char>& outputs) const
+{
+	const Layers& layers = data->layers;
+
+	//One matrix for the input and each layer's output with one row per input. Each row ends with
+	//the 1.0f bias input. The rest of the padding is left as zero so it doesn't contribute to the
+	//sums. Matrices before firstLayer's input aren't used.
+	std::vector<unsigned int> rowStrides(layers.size() + 1);
+	std::vector<AlignedVector> layerRows(layers.size() + 1);
+	for(unsigned int x = firstLayer;x < layerRows.size();x++)
+	{
+		rowStrides[x] = LayerRowStride(layers,x);
+		layerRows[x] = AlignedVector(inputCount * rowStrides[x],0.0f);
+	}
+
+	//Every input is independent so each thread takes its own range of rows through every layer
+	//without waiting on the others. That's one fork/join per batch instead of one per layer.
+	auto RunRows = [&layers,&layerRows,&rowStrides,&prepareRows,inputCount,firstLayer](const unsigned int thread,const unsigned int threadCount)
+	{
+		//Keep ranges a multiple of 4 rows to match the multiply kernel.
+		const unsigned int rowsPerThread = ((inputCount + threadCount - 1) / threadCount + 3) / 4 * 4;
+		const unsigned int rowStart = std::min(thread * rowsPerThread,inputCount);
+		const unsigned int rowEnd = std::min(rowStart + rowsPerThread,inputCount);
+		if(rowStart == rowEnd)
+			return;
+
+		prepareRows(rowStart,rowEnd,layerRows);
+		for(unsigned int x = firstLayer;x < layers.size();x++)
+		{
+			const Layer& layer = layers[x];
+			const unsigned int outputStride = rowStrides[x + 1];
+			const float* inputRows = &layerRows[x][rowStart * layer.stride];
+			float* outputRows = &layerRows[x + 1][rowStart * outputStride];
+			MultiplyTransposed(inputRows,layer.stride,layer.Weights(),layer.stride,outputRows,outputStride,rowEnd - rowStart,layer.neuronCount,layer.stride);
+
+			for(unsigned int y = 0;y < rowEnd - rowStart;y++)
+			{
+				float* outputRow = &outputRows[y * outputStride];
+				Activate(layer.activation,outputRow,layer.neuronCount);
+				outputRow[layer.neuronCount] = 1.0f;
+			}
+		}
+	};
+
+#ifdef _OPENMP
+	const unsigned int maximumThreadCount = inferenceThreadCount == 0 ? omp_get_max_threads() : inferenceThreadCount;
+	const int threadCount = std::max(std::min(maximumThreadCount,inputCount / MINIMUM_INPUTS_PER_THREAD),1u);
+#if _OPENMP >= 201307 //proc_bind was added in OpenMP 4.0.
+	switch(inferenceThreadAffinity)
+	{
+		case ThreadAffinity::Close:
+#pragma omp parallel num_threads(threadCount) if(threadCount > 1) proc_bind(close)
+			RunRows(omp_get_thread_num(),omp_get_num_threads());
+			break;
+		case ThreadAffinity::Spread:
+#pragma omp parallel num_threads(threadCount) if(threadCount > 1) proc_bind(spread)
+			RunRows(omp_get_thread_num(),omp_get_num_threads());
+			break;
+		case ThreadAffinity::Default:
+		default:
+#pragma omp parallel num_threads(threadCount) if(threadCount > 1)
+			RunRows(omp_get_thread_num(),omp_get_num_threads());
+			break;
+	}
+#else
+#pragma omp parallel num_threads(threadCount) if(threadCount > 1)
+	RunRows(omp_get_thread_num(),omp_get_num_threads());
+#endif
+#else
+	RunRows(0,1);
+#endif
+
+	//Pick the most likely choice for each input.
+	const unsigned int outputCount = layers.back().neuronCount;
+	const AlignedVector& outputRows = layerRows.back();
+	outputs.resize(inputCount);
+	for(unsigned int x = 0;x < inputCount;x++)
+	{
+		const float* outputRow = &outputRows[x * rowStrides.back()];
+		const unsigned int choice = std::distance(outputRow,std::max_element(outputRow,outputRow + outputCount));
+		outputs[x] = data->outputChoices[choice];
+	}
+}
+
+void NeuralNetwork::SetInferenceThreading(const unsigned int threadCount,const ThreadAffinity threadAffinity)
+{
+	inferenceThreadCount = threadCount;
+	inferenceThreadAffinity = threadAffinity;
+}
+
+QuantizedNeuralNetwork NeuralNetwork::Quantize() const
+{
+	return QuantizedNeuralNetwork::Quantize(*data);
+}
+
 NeuralNetwork::NeuralNetwork()
-	: data(new NeuralNetworkData)
+	: data(new NeuralNetworkData),
+	  inferenceThreadCount(0),
+	  inferenceThreadAffinity(ThreadAffinity::Default)
 {
 }
 
@@ -12,22 +12,70 @@
 #ifndef NEURALNETWORK_H
 #define NEURALNETWORK_H
 
+#include <cstdint>
 #include <functional>
 #include <memory>
 #include <utility>
 #include <vector>
 
+class AlignedVector;
+enum class Activation : unsigned int;
+struct Layer;
 struct NeuralNetworkData;
+class QuantizedNeuralNetwork;
+
+//Binary input with 64 inputs packed into each word. Input x is bit x % 64 of word x / 64.
+using PackedInput = std::vector<uint64_t>;
 
 class NeuralNetwork
 {
 	public:
-		static NeuralNetwork Train(std::function<void(std::vector<std::pair<std::vector<unsigned char>,unsigned char>>&)> buildTrainingDataFunc);
+		//Where RunBatch() threads are placed. Requires OpenMP 4.0. Ignored otherwise.
+		enum class ThreadAffinity
+		{
+			Default, //Whatever OMP_PROC_BIND says.
+			Close, //Pack threads onto neighbouring cores to share caches.
+			Spread, //Spread threads across cores to get the most memory bandwidth.
+		};
+
+		//Train on samples that are generated while training runs instead of a fixed set built up
+		//front. generateSamples is called on the calling thread, so it can render with OpenGL, and
+		//appends a few new labelled samples each time. Training happens on a worker thread at the
+		//same time. They're connected by a bounded queue so memory use stays flat and every epoch
+		//sees new samples. outputChoices lists every label a sample can have. A new network's layers
+		//use hiddenActivation and outputActivation, sigmoid when left out. Resumed and pre-trained
+		//networks keep their own. Only sigmoid hidden layers can be run by the 8-bit network.
+		static NeuralNetwork Train(const std::vector<unsigned char>& outputChoices,const unsigned int samplesPerEpoch,std::function<void(std::vector<std::pair<std::vector<unsigned char>,unsigned char>>&)> generateSamples);
+		static NeuralNetwork Train(const std::vector<unsigned char>& outputChoices,const unsigned int samplesPerEpoch,std::function<void(std::vector<std::pair<std::vector<unsigned char>,unsigned char>>&)> generateSamples,const Activation hiddenActivation,const Activation outputActivation);
 		unsigned char Run(const std::vector<unsigned char>& inputData) const;
+
+		//Same as calling Run() on each input but every layer is run on all inputs at once as a single
+		//matrix multiply. All inputs must be the same size.
+		void RunBatch(const std::vector<std::vector<unsigned char>>& inputData,std::vector<unsigned char>& outputs) const;
+
+		//Same as RunBatch() above for binary inputs of inputSize bits each. Bits past inputSize must
+		//be zero. The first layer only adds up the weights of the set bits instead of multiplying
+		//every input so tiles never need to be unpacked.
+		void RunBatch(const std::vector<PackedInput>& inputData,const unsigned int inputSize,std::vector<unsigned char>& outputs) const;
+
+		//RunBatch() splits its inputs across threads. A threadCount of 0 uses OpenMP's default
+		//(OMP_NUM_THREADS or one per core). Run() always uses the calling thread.
+		void SetInferenceThreading(const unsigned int threadCount,const ThreadAffinity threadAffinity);
+
+		//8-bit copy of this network for faster inference. See QuantizedNeuralNetwork.
+		QuantizedNeuralNetwork Quantize() const;
 	private:
 		std::shared_ptr<NeuralNetworkData> data;
+		unsigned int inferenceThreadCount;
+		ThreadAffinity inferenceThreadAffinity;
 
 		NeuralNetwork();
+
+		//Floats between consecutive rows of layer's input in RunBatchLayers().
+		static unsigned int LayerRowStride(const std::vector<Layer>& layers,const unsigned int layer);
+		//Runs every layer from firstLayer on inputCount rows split across threads. Each thread calls
+		//prepareRows(rowStart,rowEnd,layerRows) first to fill in its rows of firstLayer's input.
+		void RunBatchLayers(const unsigned int inputCount,const unsigned int firstLayer,const std::function<void(const unsigned int,const unsigned int,std::vector<AlignedVector>&)>& prepareRows,std::vector<unsigned char>& outputs) const;
 };
 
 #endif
@@ -16,6 +16,11 @@
 #include <random>
 #include <set>
 #include <cassert>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include "MappedFile.h"
+#include "NeuralNetworkKernels.h"
 
 
 static void TrainingDataOutputChoices(const std::vector<std::pair<AlignedVector,unsigned char>>& trainingData,std::vector<unsigned char>& outputChoices)
@@ -42,12 +47,19 @@ static void PrepareVector(AlignedVector& vec)
 	}
 }
 
-static void InitializeLayerOutputs(const std::vector<std::vector<AlignedVector>>& layers,std::vector<AlignedVector>& layerOutputs)
+static AlignedArena& SampleArena(std::shared_ptr<AlignedArena>& sampleArena)
+{
+	if(!sampleArena)
+		sampleArena = std::make_shared<AlignedArena>();
+	return *sampleArena;
+}
+
+static void InitializeLayerOutputs(const Layers& layers,std::vector<AlignedVector>& layerOutputs)
 {
 	layerOutputs.resize(layers.size());
 	for(unsigned int x = 0;x < layers.size();x++)
 	{
-		layerOutputs[x].resize(layers[x].size());
+		layerOutputs[x].resize(layers[x].neuronCount);
 		PrepareVector(layerOutputs[x]);
 	}
 }
@@ -66,6 +78,89 @@ static T ReadValue(std::ifstream& stream)
 	return value;
 }
 
+static bool ValidActivations(const Layers& layers)
+{
+	for(unsigned int x = 0;x < layers.size();x++)
+	{
+		switch(layers[x].activation)
+		{
+			case Activation::Sigmoid:
+			case Activation::ReLU:
+				break;
+			case Activation::Softmax:
+				if(x + 1 != layers.size())
+				{
+					std::cerr << "Softmax is only supported on the output layer." << std::endl;
+					return false;
+				}
+				break;
+			default:
+				std::cerr << "Unknown activation " << static_cast<unsigned int>(layers[x].activation) << "." << std::endl;
+				return false;
+		}
+	}
+
+	return true;
+}
+
+namespace
+{
+	//Model file layout. Everything is little-endian and stored exactly as it's used at run time.
+	//  ModelHeader
+	//  ModelLayer[layerCount]
+	//  unsigned char outputChoices[outputChoiceCount]
+	//  Each layer's weights, neuronCount * stride floats, starting at a MODEL_ALIGNMENT offset.
+	//The checksum covers everything after the header.
+	const char MODEL_MAGIC[8] = {'S','U','D','O','K','N','N','M'};
+	constexpr uint32_t MODEL_VERSION = 1;
+	constexpr uint32_t MODEL_BYTE_ORDER = 0x01020304; //Reads back differently on a big-endian machine.
+	constexpr uint64_t MODEL_ALIGNMENT = 64;
+
+	struct ModelHeader
+	{
+		char magic[8];
+		uint32_t version;
+		uint32_t byteOrder;
+		uint64_t fileSize;
+		uint64_t checksum;
+		uint32_t inputSize;
+		uint32_t layerCount;
+		uint32_t outputChoiceCount;
+		uint32_t reserved;
+	};
+
+	struct ModelLayer
+	{
+		uint32_t neuronCount;
+		uint32_t stride;
+		uint32_t activation;
+		uint32_t reserved;
+		uint64_t weightsOffset;
+	};
+}
+
+static uint64_t ModelChecksum(const unsigned char* data,const size_t size)
+{
+	//64-bit FNV-1a.
+	uint64_t hash = 0xCBF29CE484222325ULL;
+	for(size_t x = 0;x < size;x++)
+	{
+		hash = (hash ^ data[x]) * 0x100000001B3ULL;
+	}
+
+	return hash;
+}
+
+static uint64_t AlignModelOffset(const uint64_t offset)
+{
+	return (offset + MODEL_ALIGNMENT - 1) / MODEL_ALIGNMENT * MODEL_ALIGNMENT;
+}
+
+unsigned int PaddedSize(const unsigned int count)
+{
+	return (count + 1 + 7) / 8 * 8;
+}
+
 void ExpectedOutput(const std::vector<unsigned char>& outputChoices,const unsigned char value,AlignedVector& expectedOutput)
 {
 	expectedOutput.resize(outputChoices.size());
@@ -78,15 +173,97 @@ void ExpectedOutput(const std::vector<unsigned char>& outputChoices,const unsign
 	}
 }
 
+void Activate(const Activation activation,float* values,const unsigned int count)
+{
+	switch(activation)
+	{
+		case Activation::Sigmoid:
+			ApplySigmoid(values,count);
+			break;
+		case Activation::ReLU:
+			for(unsigned int x = 0;x < count;x++)
+			{
+				values[x] = std::max(values[x],0.0f);
+			}
+			break;
+		case Activation::Softmax:
+		{
+			if(count == 0)
+				break;
+
+			//Subtract the largest sum first so exp() stays in range.
+			const float maximum = *std::max_element(values,values + count);
+			for(unsigned int x = 0;x < count;x++)
+			{
+				values[x] -= maximum;
+			}
+			ApplyExponential(values,count);
+
+			float sum = 0.0f;
+			for(unsigned int x = 0;x < count;x++)
+			{
+				sum += values[x];
+			}
+			const float scale = 1.0f / sum;
+			for(unsigned int x = 0;x < count;x++)
+			{
+				values[x] *= scale;
+			}
+			break;
+		}
+	}
+}
+
+float ActivationDiff(const Activation activation,const float output)
+{
+	switch(activation)
+	{
+		case Activation::ReLU:
+			return output > 0.0f ? 1.0f : 0.0f;
+		case Activation::Softmax:
+			return 1.0f; //Cancels out with the derivative of the cross-entropy error.
+		case Activation::Sigmoid:
+		default:
+			return output * (1.0f - output);
+	}
+}
+
+NeuralNetworkData& NeuralNetworkData::operator=(const NeuralNetworkData& other)
+{
+	if(this == &other)
+		return *this;
+
+	NeuralNetworkData copy(other);
+	return *this = std::move(copy);
+}
+
+NeuralNetworkData& NeuralNetworkData::operator=(NeuralNetworkData&& other)
+{
+	if(this == &other)
+		return *this;
+
+	trainingData.clear();
+	inputSize = other.inputSize;
+	outputChoices = std::move(other.outputChoices);
+	sampleArena = std::move(other.sampleArena);
+	trainingData = std::move(other.trainingData);
+	layers = std::move(other.layers);
+	layerOutputs = std::move(other.layerOutputs);
+	modelFile = std::move(other.modelFile);
+	return *this;
+}
+
 void NeuralNetworkData::Clear()
 {
 	inputSize = 0;
 	outputChoices.clear();
 	trainingData.clear();
+	sampleArena.reset();
 	layers.clear();
+	modelFile.reset();
 }
 
-void NeuralNetworkData::InitializeWithTrainingData(const std::vector<std::pair<std::vector<unsigned char>,unsigned char>>& trainingData)
+void NeuralNetworkData::InitializeWithTrainingData(const std::vector<std::pair<std::vector<unsigned char>,unsigned char>>& trainingData,const Activation hiddenActivation,const Activation outputActivation)
 {
 	Clear();
 
@@ -95,47 +272,63 @@ void NeuralNetworkData::InitializeWithTrainingData(const std::vector<std::pair<s
 	const unsigned int originalInputSize = trainingData[0].first.size();
 
 	//Convert input data into a more efficient form using floats.
+	AlignedArena& arena = SampleArena(sampleArena);
+	this->trainingData.reserve(trainingData.size());
 	for(const auto& data : trainingData)
 	{
-		AlignedVector input;
+		AlignedVector input(arena);
+		input.reserve(PaddedSize(data.first.size()));
 		for(const unsigned char value : data.first)
 		{
 			input.push_back(static_cast<float>(value));
 		}
 		PrepareVector(input);
 
-		this->trainingData.push_back({input,data.second});
+		this->trainingData.emplace_back(std::move(input),data.second);
 	}
 
+	std::vector<unsigned char> outputChoices;
 	TrainingDataOutputChoices(this->trainingData,outputChoices);
+	Initialize(originalInputSize,outputChoices,hiddenActivation,outputActivation);
+}
+
+void NeuralNetworkData::Initialize(const unsigned int originalInputSize,const std::vector<unsigned char>& outputChoices,const Activation hiddenActivation,const Activation outputActivation)
+{
+	assert(hiddenActivation != Activation::Softmax);
+
+	this->outputChoices = outputChoices;
 	const unsigned int outputSize = outputChoices.size();
+	layers.clear();
 
 	//Setup NN layers. There needs to be a minimum of one hidden layer and one output layer but
 	//there can be as many hidden layers as necessary.
-	layers.push_back(std::vector<AlignedVector>(originalInputSize / 2)); //Hidden layer.
-	layers.push_back(std::vector<AlignedVector>(originalInputSize / 8)); //Hidden layer.
-	layers.push_back(std::vector<AlignedVector>(outputSize)); //Output layer.
+	layers.push_back(Layer(originalInputSize / 2,PaddedSize(originalInputSize),hiddenActivation)); //Hidden layer.
+	layers.push_back(Layer(originalInputSize / 8,PaddedSize(layers.back().neuronCount),hiddenActivation)); //Hidden layer.
+	layers.push_back(Layer(outputSize,PaddedSize(layers.back().neuronCount),outputActivation)); //Output layer.
 	InitializeLayerOutputs(layers,layerOutputs);
 
-	//Randomize initial weights.
+	//Randomize initial weights including the bias. Padding stays zero. ReLU layers are scaled by
+	//their input count (He initialization) so their sums neither die out nor blow up from layer to
+	//layer.
 	std::random_device randomDevice;
 	std::mt19937 randomNumberGenerator(randomDevice());
 	unsigned int previousLayerSize = originalInputSize;
-	for(std::vector<AlignedVector>& layer : layers)
+	for(Layer& layer : layers)
 	{
-		for(AlignedVector& neuron : layer)
+		const double range = layer.activation == Activation::ReLU ? 2.0 * std::sqrt(6.0 / (previousLayerSize + 1)) : 1.0;
+		for(unsigned int x = 0;x < layer.neuronCount;x++)
 		{
-			while(neuron.size() <= previousLayerSize)
+			float* neuron = layer.Neuron(x);
+			for(unsigned int y = 0;y <= previousLayerSize;y++)
 			{
-				neuron.push_back(randomNumberGenerator() / static_cast<double>(std::mt19937::max()) - 0.5);
+				neuron[y] = (randomNumberGenerator() / static_cast<double>(std::mt19937::max()) - 0.5) * range;
 			}
-			PrepareVector(neuron);
 		}
 
-		previousLayerSize = layer.size();
+		previousLayerSize = layer.neuronCount;
 	}
 
-	inputSize = this->trainingData[0].first.size();
+	inputSize = PaddedSize(originalInputSize);
 }
 
 void NeuralNetworkData::SaveAsText(const std::string& filePath)
@@ -159,21 +352,30 @@ void NeuralNetworkData::SaveAsText(const std::string& filePath)
 		outFile << std::endl;
 	}
 
-	//Save layer weights.
+	//Save layer weights. Each neuron is written with its size to match older versions.
 	outFile << layers.size() << std::endl;
-	for(const auto& layer : layers)
+	for(const Layer& layer : layers)
 	{
-		outFile << layer.size() << " ";
-		for(const AlignedVector& neuron : layer)
+		outFile << layer.neuronCount << " ";
+		for(unsigned int x = 0;x < layer.neuronCount;x++)
 		{
-			outFile << neuron.size() << " ";
-			for(const float weight : neuron)
+			outFile << layer.stride << " ";
+			const float* neuron = layer.Neuron(x);
+			for(unsigned int y = 0;y < layer.stride;y++)
 			{
-				outFile << weight << " ";
+				outFile << neuron[y] << " ";
 			}
 		}
 		outFile << std::endl;
 	}
+
+	//Save layer activations. Added after everything else so older versions can still load the rest.
+	outFile << layers.size() << " ";
+	for(const Layer& layer : layers)
+	{
+		outFile << static_cast<unsigned int>(layer.activation) << " ";
+	}
+	outFile << std::endl;
 }
 
 bool NeuralNetworkData::LoadFromText(const std::string& filePath)
@@ -190,13 +392,16 @@ bool NeuralNetworkData::LoadFromText(const std::string& filePath)
 	unsigned int trainingDataSize = 0;
 	inFile >> trainingDataSize;
 	std::cout << "Loading " << trainingDataSize << " training data" << std::endl;
+	AlignedArena& arena = SampleArena(sampleArena);
+	trainingData.reserve(trainingDataSize);
 	for(unsigned int x = 0;x < trainingDataSize;x++)
 	{
 		unsigned int expectedValue = 0;
 		inFile >> expectedValue;
 		unsigned int inputValueSize = 0;
 		inFile >> inputValueSize;
-		AlignedVector inputValues;
+		AlignedVector inputValues(arena);
+		inputValues.reserve(inputValueSize);
 		for(unsigned int y = 0;y < inputValueSize;y++)
 		{
 			float value = 0;
@@ -205,7 +410,7 @@ bool NeuralNetworkData::LoadFromText(const std::string& filePath)
 			inputValues.push_back(value);
 		}
 
-		trainingData.push_back(std::make_pair(inputValues,static_cast<unsigned char>(expectedValue)));
+		trainingData.emplace_back(std::move(inputValues),static_cast<unsigned char>(expectedValue));
 	}
 
 	//Load layer weights.
@@ -216,26 +421,43 @@ bool NeuralNetworkData::LoadFromText(const std::string& filePath)
 	{
 		unsigned int layerSize = 0;
 		inFile >> layerSize;
-		std::vector<AlignedVector> layer;
 		std::cout << "Layer " << x << " has " << layerSize << " neurons" << std::endl;
+		Layer layer;
 		for(unsigned int y = 0;y < layerSize;y++)
 		{
+			//Every neuron in a layer is the same size.
 			unsigned int neuronSize = 0;
 			inFile >> neuronSize;
-			AlignedVector neuron;
+			if(y == 0)
+				layer = Layer(layerSize,neuronSize);
+			else if(neuronSize != layer.stride)
+				return false;
+
+			float* neuron = layer.Neuron(y);
 			for(unsigned int z = 0;z < neuronSize;z++)
 			{
-				float weight = 0.0f;
-				inFile >> weight;
-
-				neuron.push_back(weight);
+				inFile >> neuron[z];
 			}
-
-			layer.push_back(neuron);
 		}
 
-		layers.push_back(layer);
+		layers.push_back(std::move(layer));
+	}
+
+	//Load layer activations. Files saved before they were added use sigmoid everywhere.
+	unsigned int activationsSize = 0;
+	if(inFile >> activationsSize)
+	{
+		if(activationsSize != layers.size())
+			return false;
+		for(Layer& layer : layers)
+		{
+			unsigned int activation = 0;
+			inFile >> activation;
+			layer.activation = static_cast<Activation>(activation);
+		}
 	}
+	if(!ValidActivations(layers))
+		return false;
 
 	//Figure out the remaining parameters from the loaded data.
 	inputSize = trainingData[0].first.size();
@@ -245,13 +467,13 @@ bool NeuralNetworkData::LoadFromText(const std::string& filePath)
 	return true;
 }
 
-void NeuralNetworkData::SaveAsBinary(const std::string& filePath)
+bool NeuralNetworkData::SaveAsBinary(const std::string& filePath)
 {
 	std::ofstream outFile(filePath,std::ios::binary);
 	if(!outFile)
 	{
 		std::cerr << "Could not save neural network training." << std::endl;
-		return;
+		return false;
 	}
 
 	//Save training data.
@@ -268,19 +490,28 @@ void NeuralNetworkData::SaveAsBinary(const std::string& filePath)
 
 	//Save layer weights.
 	WriteValue<unsigned int>(outFile,layers.size());
-	for(const auto& layer : layers)
+	for(const Layer& layer : layers)
 	{
-		WriteValue<unsigned int>(outFile,layer.size());
-		for(const auto& neuron : layer)
+		WriteValue<unsigned int>(outFile,layer.neuronCount);
+		for(unsigned int x = 0;x < layer.neuronCount;x++)
 		{
-			WriteValue<unsigned int>(outFile,neuron.size());
-			outFile.write(reinterpret_cast<const char*>(&neuron[0]),neuron.size() * sizeof(float));
+			WriteValue<unsigned int>(outFile,layer.stride);
+			outFile.write(reinterpret_cast<const char*>(layer.Neuron(x)),layer.stride * sizeof(float));
 		}
 	}
 
 	//Save output choices.
 	WriteValue<unsigned int>(outFile,outputChoices.size());
 	outFile.write(reinterpret_cast<const char*>(&outputChoices[0]),outputChoices.size());
+
+	//Save layer activations. Added after everything else so older versions can still load the rest.
+	WriteValue<unsigned int>(outFile,layers.size());
+	for(const Layer& layer : layers)
+	{
+		WriteValue<unsigned int>(outFile,static_cast<unsigned int>(layer.activation));
+	}
+
+	return static_cast<bool>(outFile);
 }
 
 bool NeuralNetworkData::LoadFromBinary(const std::string& filePath)
@@ -295,14 +526,16 @@ bool NeuralNetworkData::LoadFromBinary(const std::string& filePath)
 
 	//Load training data.
 	const unsigned int trainingDataSize = ReadValue<unsigned int>(inFile);
+	AlignedArena& arena = SampleArena(sampleArena);
+	trainingData.reserve(trainingDataSize);
 	for(unsigned int x = 0;x < trainingDataSize;x++)
 	{
 		const unsigned int expectedValue = ReadValue<unsigned int>(inFile);
 		const unsigned int inputValueSize = ReadValue<unsigned int>(inFile);
-		AlignedVector inputValues(inputValueSize,0.0f);
+		AlignedVector inputValues(inputValueSize,0.0f,arena);
 		inFile.read(reinterpret_cast<char*>(&inputValues[0]),inputValueSize * sizeof(float));
 
-		trainingData.push_back(std::make_pair(inputValues,static_cast<unsigned char>(expectedValue)));
+		trainingData.emplace_back(std::move(inputValues),static_cast<unsigned char>(expectedValue));
 	}
 
 	//Load testing data.
@@ -317,14 +550,16 @@ bool NeuralNetworkData::LoadFromBinary(const std::string& filePath)
 		Layer layer;
 		for(unsigned int y = 0;y < layerSize;y++)
 		{
+			//Every neuron in a layer is the same size.
 			const unsigned int neuronSize = ReadValue<unsigned int>(inFile);
-			Neuron neuron(neuronSize,0.0f);
-			inFile.read(reinterpret_cast<char*>(&neuron[0]),neuronSize * sizeof(float));
-
-			layer.push_back(neuron);
+			if(y == 0)
+				layer = Layer(layerSize,neuronSize);
+			else if(neuronSize != layer.stride)
+				return false;
+			inFile.read(reinterpret_cast<char*>(layer.Neuron(y)),neuronSize * sizeof(float));
 		}
 
-		layers.push_back(layer);
+		layers.push_back(std::move(layer));
 	}
 
 	//Load output choices.
@@ -332,10 +567,170 @@ bool NeuralNetworkData::LoadFromBinary(const std::string& filePath)
 	outputChoices.resize(outputChoicesSize);
 	inFile.read(reinterpret_cast<char*>(&outputChoices[0]),outputChoicesSize);
 
+	//Load layer activations. Files saved before they were added use sigmoid everywhere.
+	if(inFile.peek() != std::ifstream::traits_type::eof())
+	{
+		if(ReadValue<unsigned int>(inFile) != layers.size())
+			return false;
+		for(Layer& layer : layers)
+		{
+			layer.activation = static_cast<Activation>(ReadValue<unsigned int>(inFile));
+		}
+	}
+	if(!ValidActivations(layers))
+		return false;
+
 	//Figure out the remaining parameters from the loaded data.
-	inputSize = layers[0][0].size();
+	inputSize = layers[0].stride;
 	InitializeLayerOutputs(layers,layerOutputs);
 
 	return true;
 }
 
+void NeuralNetworkData::SaveAsModel(const std::string& filePath) const
+{
+	//Lay out the whole file in memory first so it can be checksummed and then written in one go.
+	const size_t layerTableOffset = sizeof(ModelHeader);
+	const size_t outputChoicesOffset = layerTableOffset + layers.size() * sizeof(ModelLayer);
+	uint64_t fileSize = outputChoicesOffset + outputChoices.size();
+	std::vector<ModelLayer> modelLayers(layers.size());
+	for(unsigned int x = 0;x < layers.size();x++)
+	{
+		const Layer& layer = layers[x];
+		ModelLayer& modelLayer = modelLayers[x];
+		modelLayer.neuronCount = layer.neuronCount;
+		modelLayer.stride = layer.stride;
+		modelLayer.activation = static_cast<uint32_t>(layer.activation);
+		modelLayer.reserved = 0;
+		modelLayer.weightsOffset = AlignModelOffset(fileSize);
+		fileSize = modelLayer.weightsOffset + static_cast<uint64_t>(layer.neuronCount) * layer.stride * sizeof(float);
+	}
+
+	std::vector<unsigned char> file(fileSize,0);
+	if(!modelLayers.empty())
+		memcpy(&file[layerTableOffset],&modelLayers[0],modelLayers.size() * sizeof(ModelLayer));
+	if(!outputChoices.empty())
+		memcpy(&file[outputChoicesOffset],&outputChoices[0],outputChoices.size());
+	for(unsigned int x = 0;x < layers.size();x++)
+	{
+		memcpy(&file[modelLayers[x].weightsOffset],layers[x].Weights(),static_cast<size_t>(layers[x].neuronCount) * layers[x].stride * sizeof(float));
+	}
+
+	ModelHeader header;
+	memcpy(header.magic,MODEL_MAGIC,sizeof(header.magic));
+	header.version = MODEL_VERSION;
+	header.byteOrder = MODEL_BYTE_ORDER;
+	header.fileSize = fileSize;
+	header.checksum = ModelChecksum(&file[sizeof(ModelHeader)],fileSize - sizeof(ModelHeader));
+	header.inputSize = inputSize;
+	header.layerCount = layers.size();
+	header.outputChoiceCount = outputChoices.size();
+	header.reserved = 0;
+	memcpy(&file[0],&header,sizeof(header));
+
+	//Write next to the destination and swap it in so a crash never leaves a half written model.
+	const std::string temporaryPath = filePath + ".tmp";
+	{
+		std::ofstream outFile(temporaryPath,std::ios::binary | std::ios::trunc);
+		if(!outFile)
+		{
+			std::cerr << "Could not save neural network model." << std::endl;
+			return;
+		}
+		outFile.write(reinterpret_cast<const char*>(&file[0]),file.size());
+		if(!outFile)
+		{
+			std::cerr << "Could not save neural network model." << std::endl;
+			return;
+		}
+	}
+	if(!ReplaceFileAtomically(temporaryPath,filePath))
+		std::cerr << "Could not replace neural network model." << std::endl;
+}
+
+bool NeuralNetworkData::LoadFromModel(const std::string& filePath)
+{
+	Clear();
+
+	std::optional<MappedFile> file = MappedFile::Open(filePath);
+	if(!file || file->Size() < sizeof(ModelHeader))
+		return false;
+	const unsigned char* data = file->Data();
+	const size_t size = file->Size();
+
+	ModelHeader header;
+	memcpy(&header,data,sizeof(header));
+	if(memcmp(header.magic,MODEL_MAGIC,sizeof(header.magic)) != 0)
+		return false;
+	else if(header.version != MODEL_VERSION || header.byteOrder != MODEL_BYTE_ORDER)
+	{
+		std::cerr << "Unsupported neural network model version or byte order." << std::endl;
+		return false;
+	}
+	else if(header.fileSize != size || header.layerCount == 0 || header.inputSize == 0)
+	{
+		std::cerr << "Neural network model is truncated or malformed." << std::endl;
+		return false;
+	}
+
+	const uint64_t layerTableOffset = sizeof(ModelHeader);
+	const uint64_t outputChoicesOffset = layerTableOffset + static_cast<uint64_t>(header.layerCount) * sizeof(ModelLayer);
+	if(outputChoicesOffset + header.outputChoiceCount > size)
+	{
+		std::cerr << "Neural network model is truncated or malformed." << std::endl;
+		return false;
+	}
+	else if(ModelChecksum(data + sizeof(ModelHeader),size - sizeof(ModelHeader)) != header.checksum)
+	{
+		std::cerr << "Neural network model checksum does not match." << std::endl;
+		return false;
+	}
+
+	//Each layer must be fed exactly what the layer before produces and its weights must sit
+	//aligned inside the file. Strides must be padded sizes so every row stays 32-byte aligned for
+	//the kernels, which only the first layer's, taken from the header, could get wrong.
+	unsigned int expectedStride = header.inputSize;
+	for(unsigned int x = 0;x < header.layerCount;x++)
+	{
+		ModelLayer modelLayer;
+		memcpy(&modelLayer,data + layerTableOffset + x * sizeof(ModelLayer),sizeof(modelLayer));
+		const uint64_t weightsSize = static_cast<uint64_t>(modelLayer.neuronCount) * modelLayer.stride * sizeof(float);
+		if(modelLayer.neuronCount == 0 || modelLayer.stride != expectedStride || (modelLayer.stride % AlignedAllocator::ALIGNMENT_FLOATS) != 0 ||
+		   (modelLayer.weightsOffset % MODEL_ALIGNMENT) != 0 || modelLayer.weightsOffset < outputChoicesOffset + header.outputChoiceCount ||
+		   modelLayer.weightsOffset > size || weightsSize > size - modelLayer.weightsOffset)
+		{
+			std::cerr << "Neural network model has an invalid layer." << std::endl;
+			layers.clear();
+			return false;
+		}
+
+		Layer layer;
+		layer.neuronCount = modelLayer.neuronCount;
+		layer.stride = modelLayer.stride;
+		layer.mappedWeights = reinterpret_cast<const float*>(data + modelLayer.weightsOffset);
+		layer.activation = static_cast<Activation>(modelLayer.activation);
+		layers.push_back(std::move(layer));
+
+		expectedStride = PaddedSize(modelLayer.neuronCount);
+	}
+	if(header.outputChoiceCount != layers.back().neuronCount || !ValidActivations(layers))
+	{
+		layers.clear();
+		return false;
+	}
+
+	inputSize = header.inputSize;
+	outputChoices.assign(data + outputChoicesOffset,data + outputChoicesOffset + header.outputChoiceCount);
+	InitializeLayerOutputs(layers,layerOutputs);
+	modelFile = std::make_shared<const MappedFile>(std::move(*file));
+
+	return true;
+}
+
+bool NeuralNetworkData::IsModel(const std::string& filePath)
+{
+	std::ifstream inFile(filePath,std::ios::binary);
+	char magic[sizeof(MODEL_MAGIC)] = {};
+	inFile.read(magic,sizeof(magic));
+	return inFile && memcmp(magic,MODEL_MAGIC,sizeof(magic)) == 0;
+}
@@ -12,34 +12,117 @@
 #ifndef NODENETWORKDATA_H
 #define NODENETWORKDATA_H
 
+#include <memory>
 #include <string>
 #include <vector>
 #include "AlignedVector.h"
 
-using Neuron = AlignedVector;
-using Layer = std::vector<Neuron>;
+class MappedFile;
+
+//Fewest inputs given to each thread when running a batch through either the float or the 8-bit
+//network. Starting a thread for less work costs more than it saves.
+static constexpr unsigned int MINIMUM_INPUTS_PER_THREAD = 8;
+
+//What a layer does to its neurons' sums. Saved as a number so only ever append.
+enum class Activation : unsigned int
+{
+	Sigmoid = 0,
+	ReLU = 1,
+	Softmax = 2, //Output layer only. Trained as cross-entropy so output errors aren't scaled by a derivative.
+};
+
+//All weights of a layer in one row-major matrix with a row per neuron. A row holds the weights for
+//each input followed by the bias weight, which is applied by giving the layer a 1.0f input right
+//after the real ones. Rows are zero padded to stride floats, a multiple of 8, so every row starts
+//32-byte aligned and the whole layer can be streamed through in order.
+//
+//A layer loaded from a model file uses the weights in the mapped file directly. weights is empty
+//then and only the const accessors work.
+struct Layer
+{
+	unsigned int neuronCount;
+	unsigned int stride;
+	AlignedVector weights;
+	const float* mappedWeights;
+	Activation activation;
+
+	Layer()
+		: neuronCount(0),
+		  stride(0),
+		  weights(),
+		  mappedWeights(nullptr),
+		  activation(Activation::Sigmoid)
+	{
+	}
+	Layer(const unsigned int neuronCount,const unsigned int stride,const Activation activation = Activation::Sigmoid)
+		: neuronCount(neuronCount),
+		  stride(stride),
+		  weights(neuronCount * stride,0.0f),
+		  mappedWeights(nullptr),
+		  activation(activation)
+	{
+	}
+	const float* Weights() const
+	{
+		return mappedWeights != nullptr ? mappedWeights : &weights[0];
+	}
+	float* Neuron(const unsigned int index)
+	{
+		return &weights[index * stride];
+	}
+	const float* Neuron(const unsigned int index) const
+	{
+		return &Weights()[index * stride];
+	}
+};
 using Layers = std::vector<Layer>;
 
+//Size of a row holding count values and a trailing 1.0f bias term, padded for SIMD, GPU, etc.
+unsigned int PaddedSize(const unsigned int count);
+
 void ExpectedOutput(const std::vector<unsigned char>& outputChoices,const unsigned char value,AlignedVector& expectedOutput);
 
+//Replace count neuron sums with the layer's activation of them.
+void Activate(const Activation activation,float* values,const unsigned int count);
+float ActivationDiff(const Activation activation,const float output); //Derivative of the activation given its output.
+
 struct NeuralNetworkData
 {
 	unsigned int inputSize;
 	std::vector<unsigned char> outputChoices;
+	std::shared_ptr<AlignedArena> sampleArena; //Backs the inputs of loaded training data. Copies of them use the heap.
 	std::vector<std::pair<AlignedVector,unsigned char>> trainingData;
 	Layers layers;
 	std::vector<AlignedVector> layerOutputs;
+	std::shared_ptr<const MappedFile> modelFile; //Backs every layer's mappedWeights. Shared by copies.
+
+	NeuralNetworkData() = default;
+	NeuralNetworkData(const NeuralNetworkData& other) = default;
+	NeuralNetworkData(NeuralNetworkData&& other) = default;
+	//Samples are released before sampleArena is replaced since they free themselves into it.
+	NeuralNetworkData& operator=(const NeuralNetworkData& other);
+	NeuralNetworkData& operator=(NeuralNetworkData&& other);
 
 	void Clear();
-	void InitializeWithTrainingData(const std::vector<std::pair<std::vector<unsigned char>,unsigned char>>& trainingData);
+	//New random layers. Hidden layers use hiddenActivation, which can't be Softmax, and the output
+	//layer uses outputActivation.
+	void InitializeWithTrainingData(const std::vector<std::pair<std::vector<unsigned char>,unsigned char>>& trainingData,const Activation hiddenActivation = Activation::Sigmoid,const Activation outputActivation = Activation::Sigmoid);
+	void Initialize(const unsigned int originalInputSize,const std::vector<unsigned char>& outputChoices,const Activation hiddenActivation = Activation::Sigmoid,const Activation outputActivation = Activation::Sigmoid); //Without any training data.
 
 	//Save/load using an inefficient text format for debugging.
 	void SaveAsText(const std::string& filePath);
 	bool LoadFromText(const std::string& filePath);
 
-	//Save/load using an inefficient binary format.
-	void SaveAsBinary(const std::string& filePath);
+	//Save/load using an inefficient binary format. Training data is saved with the network.
+	bool SaveAsBinary(const std::string& filePath);
 	bool LoadFromBinary(const std::string& filePath);
+
+	//Save/load a trained network as a versioned model file that's memory mapped and used in place.
+	//Loading only checks the header and checksum so nothing is parsed or copied and every process
+	//shares one copy of the weights. The loaded network can only be run, not trained.
+	void SaveAsModel(const std::string& filePath) const;
+	bool LoadFromModel(const std::string& filePath);
+	static bool IsModel(const std::string& filePath); //Starts with the model magic, even if LoadFromModel() rejects the rest.
 };
 
 #endif
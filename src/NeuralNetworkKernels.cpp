@@ -0,0 +1,701 @@
+// Copyright 2017 James Bendig. See the COPYRIGHT file at the top-level
+// directory of this distribution.
+//
+// Licensed under:
+//   the MIT license
+//     <LICENSE-MIT or https://opensource.org/licenses/MIT>
+//   or the Apache License, Version 2.0
+//     <LICENSE-APACHE or https://www.apache.org/licenses/LICENSE-2.0>,
+// at your option. This file may not be copied, modified, or distributed
+// except according to those terms.
+
+
+#include "NeuralNetworkKernels.h"
+#include <algorithm>
+#include <cmath>
+
+//GCC and Clang can compile individual functions for instruction sets the rest of the file isn't
+//built for and check what the CPU supports at runtime. MSVC always allows SSE2 on x64 so that's
+//used as is.
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define USE_CPU_DISPATCH
+#define TARGET(features) __attribute__((target(features)))
+#elif defined(_M_X64)
+#define TARGET(features)
+#endif
+
+#if defined(USE_CPU_DISPATCH) || defined(_M_X64)
+#include <immintrin.h> //SSE2, AVX, AVX2, FMA, AVX-512
+#endif
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+//C is computed in blocks so a slice of B (BLOCK_COLUMNS rows of BLOCK_DEPTH floats, 32KB) stays in
+//cache while every row of A is run against it.
+static constexpr unsigned int BLOCK_COLUMNS = 32;
+static constexpr unsigned int BLOCK_DEPTH = 256;
+
+//Each step of the inner loop works on this many rows of A and B at once so loads are reused
+//across several sums held in registers.
+static constexpr unsigned int KERNEL_ROWS = 4;
+static constexpr unsigned int KERNEL_COLUMNS = 2;
+
+//One kernel computes a ROWS x COLUMNS block of C. Plain C++ version.
+struct MultiplyKernelScalar
+{
+	template <unsigned int ROWS,unsigned int COLUMNS>
+	static void Run(const float* a,const unsigned int aStride,const float* b,const unsigned int bStride,float* c,const unsigned int cStride,const unsigned int depth,const bool accumulate)
+	{
+		for(unsigned int row = 0;row < ROWS;row++)
+		{
+			for(unsigned int column = 0;column < COLUMNS;column++)
+			{
+				float sum = 0.0f;
+				for(unsigned int z = 0;z < depth;z++)
+				{
+					sum += a[row * aStride + z] * b[column * bStride + z];
+				}
+
+				float& output = c[row * cStride + column];
+				output = accumulate ? output + sum : sum;
+			}
+		}
+	}
+};
+
+template <class Kernel,unsigned int ROWS>
+static void MultiplyRows(const float* a,const unsigned int aStride,const float* b,const unsigned int bStride,float* c,const unsigned int cStride,const unsigned int columnCount,const unsigned int depth,const bool accumulate)
+{
+	unsigned int column = 0;
+	for(;column + KERNEL_COLUMNS <= columnCount;column += KERNEL_COLUMNS)
+	{
+		Kernel::template Run<ROWS,KERNEL_COLUMNS>(a,aStride,&b[column * bStride],bStride,&c[column],cStride,depth,accumulate);
+	}
+	for(;column < columnCount;column++)
+	{
+		Kernel::template Run<ROWS,1>(a,aStride,&b[column * bStride],bStride,&c[column],cStride,depth,accumulate);
+	}
+}
+
+//Inlined into each instruction set's MultiplyTransposed() so the kernel is built for the same one.
+template <class Kernel>
+static inline void MultiplyBlocks(const float* a,const unsigned int aStride,const float* b,const unsigned int bStride,float* c,const unsigned int cStride,const unsigned int m,const unsigned int n,const unsigned int k)
+{
+	for(unsigned int depthStart = 0;depthStart < k;depthStart += BLOCK_DEPTH)
+	{
+		const unsigned int depth = std::min(BLOCK_DEPTH,k - depthStart);
+		const bool accumulate = depthStart != 0;
+		for(unsigned int columnStart = 0;columnStart < n;columnStart += BLOCK_COLUMNS)
+		{
+			const unsigned int columnCount = std::min(BLOCK_COLUMNS,n - columnStart);
+			const float* bBlock = &b[columnStart * bStride + depthStart];
+
+			unsigned int row = 0;
+			for(;row + KERNEL_ROWS <= m;row += KERNEL_ROWS)
+			{
+				MultiplyRows<Kernel,KERNEL_ROWS>(&a[row * aStride + depthStart],aStride,bBlock,bStride,&c[row * cStride + columnStart],cStride,columnCount,depth,accumulate);
+			}
+			for(;row < m;row++)
+			{
+				MultiplyRows<Kernel,1>(&a[row * aStride + depthStart],aStride,bBlock,bStride,&c[row * cStride + columnStart],cStride,columnCount,depth,accumulate);
+			}
+		}
+	}
+}
+
+static void MultiplyTransposedScalar(const float* a,const unsigned int aStride,const float* b,const unsigned int bStride,float* c,const unsigned int cStride,const unsigned int m,const unsigned int n,const unsigned int k)
+{
+	MultiplyBlocks<MultiplyKernelScalar>(a,aStride,b,bStride,c,cStride,m,n,k);
+}
+
+template <class T>
+static float DotProductScalar(const float* weights,const T* inputs,const unsigned int count)
+{
+	float sum = 0.0f;
+	for(unsigned int x = 0;x < count;x++)
+	{
+		sum += weights[x] * static_cast<float>(inputs[x]);
+	}
+
+	return sum;
+}
+
+static unsigned int LowestSetBit(const uint64_t bits)
+{
+#ifdef _MSC_VER
+	unsigned long index = 0;
+	_BitScanForward64(&index,bits);
+	return index;
+#else
+	return __builtin_ctzll(bits);
+#endif
+}
+
+static float MaskedSumScalar(const float* weights,const uint64_t* bits,const unsigned int count)
+{
+	float sum = 0.0f;
+	for(unsigned int word = 0;word < (count + 63) / 64;word++)
+	{
+		uint64_t remainingBits = bits[word];
+		while(remainingBits != 0)
+		{
+			sum += weights[word * 64 + LowestSetBit(remainingBits)];
+			remainingBits &= remainingBits - 1;
+		}
+	}
+
+	return sum;
+}
+
+//Clamp range and coefficients for exp(). See ApplyExponential().
+static constexpr float EXP_MINIMUM = -87.0f;
+static constexpr float EXP_MAXIMUM = 88.0f;
+static constexpr float LOG2_E = 1.44269504088896341f;
+static constexpr float LN2_HIGH = 0.693359375f; //ln(2) split in two so n * LN2_HIGH is exact.
+static constexpr float LN2_LOW = -2.12194440e-4f;
+static constexpr float SIGMOID_ZERO = -70.0f; //Sigmoid of anything lower is flushed to 0.
+static constexpr float EXP_COEFFICIENTS[] = {1.9875691500e-4f,1.3981999507e-3f,8.3334519073e-3f,4.1665795894e-2f,1.6666665459e-1f,5.0000001201e-1f};
+
+static void ApplyExponentialScalar(float* values,const unsigned int count)
+{
+	for(unsigned int x = 0;x < count;x++)
+	{
+		values[x] = std::exp(std::min(std::max(values[x],EXP_MINIMUM),EXP_MAXIMUM));
+	}
+}
+
+static void ApplySigmoidScalar(float* values,const unsigned int count)
+{
+	for(unsigned int x = 0;x < count;x++)
+	{
+		values[x] = values[x] < SIGMOID_ZERO ? 0.0f : 1.0f / (1.0f + std::exp(std::min(std::max(-values[x],EXP_MINIMUM),EXP_MAXIMUM)));
+	}
+}
+
+#if defined(USE_CPU_DISPATCH) || defined(_M_X64)
+TARGET("sse2") static float SumLanesSSE2(__m128 values)
+{
+	values = _mm_add_ps(values,_mm_movehl_ps(values,values));
+	values = _mm_add_ss(values,_mm_shuffle_ps(values,values,1));
+	return _mm_cvtss_f32(values);
+}
+
+TARGET("sse2") static float DotProductSSE2(const float* weights,const unsigned char* inputs,const unsigned int count)
+{
+	//Widen 16 pixels at a time, 8-bit to 16-bit to 32-bit, by interleaving with zero.
+	const __m128i zero = _mm_setzero_si128();
+	__m128 sum0 = _mm_setzero_ps();
+	__m128 sum1 = _mm_setzero_ps();
+	unsigned int x = 0;
+	for(;x + 16 <= count;x += 16)
+	{
+		const __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&inputs[x]));
+		const __m128i low = _mm_unpacklo_epi8(bytes,zero);
+		const __m128i high = _mm_unpackhi_epi8(bytes,zero);
+		sum0 = _mm_add_ps(sum0,_mm_mul_ps(_mm_loadu_ps(&weights[x]),_mm_cvtepi32_ps(_mm_unpacklo_epi16(low,zero))));
+		sum1 = _mm_add_ps(sum1,_mm_mul_ps(_mm_loadu_ps(&weights[x + 4]),_mm_cvtepi32_ps(_mm_unpackhi_epi16(low,zero))));
+		sum0 = _mm_add_ps(sum0,_mm_mul_ps(_mm_loadu_ps(&weights[x + 8]),_mm_cvtepi32_ps(_mm_unpacklo_epi16(high,zero))));
+		sum1 = _mm_add_ps(sum1,_mm_mul_ps(_mm_loadu_ps(&weights[x + 12]),_mm_cvtepi32_ps(_mm_unpackhi_epi16(high,zero))));
+	}
+
+	return SumLanesSSE2(_mm_add_ps(sum0,sum1)) + DotProductScalar(&weights[x],&inputs[x],count - x);
+}
+
+TARGET("sse2") static float DotProductSSE2(const float* weights,const float* inputs,const unsigned int count)
+{
+	__m128 sum0 = _mm_setzero_ps();
+	__m128 sum1 = _mm_setzero_ps();
+	unsigned int x = 0;
+	for(;x + 8 <= count;x += 8)
+	{
+		sum0 = _mm_add_ps(sum0,_mm_mul_ps(_mm_loadu_ps(&weights[x]),_mm_loadu_ps(&inputs[x])));
+		sum1 = _mm_add_ps(sum1,_mm_mul_ps(_mm_loadu_ps(&weights[x + 4]),_mm_loadu_ps(&inputs[x + 4])));
+	}
+
+	return SumLanesSSE2(_mm_add_ps(sum0,sum1)) + DotProductScalar(&weights[x],&inputs[x],count - x);
+}
+
+struct MultiplyKernelSSE2
+{
+	template <unsigned int ROWS,unsigned int COLUMNS>
+	TARGET("sse2") static void Run(const float* a,const unsigned int aStride,const float* b,const unsigned int bStride,float* c,const unsigned int cStride,const unsigned int depth,const bool accumulate)
+	{
+		__m128 sums[ROWS][COLUMNS];
+		for(unsigned int row = 0;row < ROWS;row++)
+		{
+			for(unsigned int column = 0;column < COLUMNS;column++)
+			{
+				sums[row][column] = _mm_setzero_ps();
+			}
+		}
+
+		for(unsigned int z = 0;z < depth;z += 4)
+		{
+			__m128 bValues[COLUMNS];
+			for(unsigned int column = 0;column < COLUMNS;column++)
+			{
+				bValues[column] = _mm_load_ps(&b[column * bStride + z]);
+			}
+
+			for(unsigned int row = 0;row < ROWS;row++)
+			{
+				const __m128 aValues = _mm_load_ps(&a[row * aStride + z]);
+				for(unsigned int column = 0;column < COLUMNS;column++)
+				{
+					sums[row][column] = _mm_add_ps(_mm_mul_ps(aValues,bValues[column]),sums[row][column]);
+				}
+			}
+		}
+
+		for(unsigned int row = 0;row < ROWS;row++)
+		{
+			for(unsigned int column = 0;column < COLUMNS;column++)
+			{
+				const float sum = SumLanesSSE2(sums[row][column]);
+				float& output = c[row * cStride + column];
+				output = accumulate ? output + sum : sum;
+			}
+		}
+	}
+};
+
+TARGET("sse2") static void MultiplyTransposedSSE2(const float* a,const unsigned int aStride,const float* b,const unsigned int bStride,float* c,const unsigned int cStride,const unsigned int m,const unsigned int n,const unsigned int k)
+{
+	MultiplyBlocks<MultiplyKernelSSE2>(a,aStride,b,bStride,c,cStride,m,n,k);
+}
+#endif
+
+#ifdef USE_CPU_DISPATCH
+TARGET("avx2,fma") static float SumLanesAVX2(const __m256 values)
+{
+	__m128 sum = _mm_add_ps(_mm256_castps256_ps128(values),_mm256_extractf128_ps(values,1));
+	sum = _mm_add_ps(sum,_mm_movehl_ps(sum,sum));
+	sum = _mm_add_ss(sum,_mm_shuffle_ps(sum,sum,1));
+	return _mm_cvtss_f32(sum);
+}
+
+TARGET("avx2,fma") static float DotProductAVX2(const float* weights,const unsigned char* inputs,const unsigned int count)
+{
+	__m256 sum0 = _mm256_setzero_ps();
+	__m256 sum1 = _mm256_setzero_ps();
+	unsigned int x = 0;
+	for(;x + 16 <= count;x += 16)
+	{
+		const __m256 low = _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(&inputs[x]))));
+		const __m256 high = _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(&inputs[x + 8]))));
+		sum0 = _mm256_fmadd_ps(_mm256_loadu_ps(&weights[x]),low,sum0);
+		sum1 = _mm256_fmadd_ps(_mm256_loadu_ps(&weights[x + 8]),high,sum1);
+	}
+
+	return SumLanesAVX2(_mm256_add_ps(sum0,sum1)) + DotProductScalar(&weights[x],&inputs[x],count - x);
+}
+
+TARGET("avx2,fma") static float DotProductAVX2(const float* weights,const float* inputs,const unsigned int count)
+{
+	__m256 sum0 = _mm256_setzero_ps();
+	__m256 sum1 = _mm256_setzero_ps();
+	unsigned int x = 0;
+	for(;x + 16 <= count;x += 16)
+	{
+		sum0 = _mm256_fmadd_ps(_mm256_loadu_ps(&weights[x]),_mm256_loadu_ps(&inputs[x]),sum0);
+		sum1 = _mm256_fmadd_ps(_mm256_loadu_ps(&weights[x + 8]),_mm256_loadu_ps(&inputs[x + 8]),sum1);
+	}
+
+	return SumLanesAVX2(_mm256_add_ps(sum0,sum1)) + DotProductScalar(&weights[x],&inputs[x],count - x);
+}
+
+TARGET("avx2,fma") static float MaskedSumAVX2(const float* weights,const uint64_t* bits,const unsigned int count)
+{
+	//Spread each byte of bits across 8 lanes and keep the weights whose bit is set.
+	const __m256i laneBits = _mm256_setr_epi32(1,2,4,8,16,32,64,128);
+	__m256 sum = _mm256_setzero_ps();
+	for(unsigned int x = 0;x < count;x += 8)
+	{
+		const unsigned int byte = (bits[x / 64] >> (x % 64)) & 0xFF;
+		if(byte == 0)
+			continue;
+
+		const __m256i mask = _mm256_cmpeq_epi32(_mm256_and_si256(_mm256_set1_epi32(byte),laneBits),laneBits);
+		sum = _mm256_add_ps(sum,_mm256_and_ps(_mm256_castsi256_ps(mask),_mm256_loadu_ps(&weights[x])));
+	}
+
+	return SumLanesAVX2(sum);
+}
+
+TARGET("avx2,fma") static __m256 ExponentialAVX2(__m256 values)
+{
+	values = _mm256_min_ps(_mm256_max_ps(values,_mm256_set1_ps(EXP_MINIMUM)),_mm256_set1_ps(EXP_MAXIMUM));
+
+	//exp(x) = 2^n * exp(r) where n = round(x / ln(2)) and r = x - n * ln(2).
+	const __m256 n = _mm256_round_ps(_mm256_mul_ps(values,_mm256_set1_ps(LOG2_E)),_MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+	__m256 r = _mm256_fnmadd_ps(n,_mm256_set1_ps(LN2_HIGH),values);
+	r = _mm256_fnmadd_ps(n,_mm256_set1_ps(LN2_LOW),r);
+
+	__m256 polynomial = _mm256_set1_ps(EXP_COEFFICIENTS[0]);
+	for(unsigned int x = 1;x < sizeof(EXP_COEFFICIENTS) / sizeof(EXP_COEFFICIENTS[0]);x++)
+	{
+		polynomial = _mm256_fmadd_ps(polynomial,r,_mm256_set1_ps(EXP_COEFFICIENTS[x]));
+	}
+	polynomial = _mm256_fmadd_ps(polynomial,_mm256_mul_ps(r,r),_mm256_add_ps(r,_mm256_set1_ps(1.0f)));
+
+	//Build 2^n directly in the exponent bits.
+	const __m256i exponent = _mm256_slli_epi32(_mm256_add_epi32(_mm256_cvtps_epi32(n),_mm256_set1_epi32(127)),23);
+	return _mm256_mul_ps(polynomial,_mm256_castsi256_ps(exponent));
+}
+
+TARGET("avx2,fma") static void ApplyExponentialAVX2(float* values,const unsigned int count)
+{
+	unsigned int x = 0;
+	for(;x + 8 <= count;x += 8)
+	{
+		_mm256_storeu_ps(&values[x],ExponentialAVX2(_mm256_loadu_ps(&values[x])));
+	}
+	ApplyExponentialScalar(&values[x],count - x);
+}
+
+TARGET("avx2,fma") static void ApplySigmoidAVX2(float* values,const unsigned int count)
+{
+	const __m256 one = _mm256_set1_ps(1.0f);
+	unsigned int x = 0;
+	for(;x + 8 <= count;x += 8)
+	{
+		const __m256 value8 = _mm256_loadu_ps(&values[x]);
+		const __m256 sigmoid = _mm256_div_ps(one,_mm256_add_ps(one,ExponentialAVX2(_mm256_sub_ps(_mm256_setzero_ps(),value8))));
+		const __m256 zeroMask = _mm256_cmp_ps(value8,_mm256_set1_ps(SIGMOID_ZERO),_CMP_LT_OQ);
+		_mm256_storeu_ps(&values[x],_mm256_andnot_ps(zeroMask,sigmoid));
+	}
+	ApplySigmoidScalar(&values[x],count - x);
+}
+
+struct MultiplyKernelAVX2
+{
+	template <unsigned int ROWS,unsigned int COLUMNS>
+	TARGET("avx2,fma") static void Run(const float* a,const unsigned int aStride,const float* b,const unsigned int bStride,float* c,const unsigned int cStride,const unsigned int depth,const bool accumulate)
+	{
+		__m256 sums[ROWS][COLUMNS];
+		for(unsigned int row = 0;row < ROWS;row++)
+		{
+			for(unsigned int column = 0;column < COLUMNS;column++)
+			{
+				sums[row][column] = _mm256_setzero_ps();
+			}
+		}
+
+		for(unsigned int z = 0;z < depth;z += 8)
+		{
+			__m256 bValues[COLUMNS];
+			for(unsigned int column = 0;column < COLUMNS;column++)
+			{
+				bValues[column] = _mm256_load_ps(&b[column * bStride + z]);
+			}
+
+			for(unsigned int row = 0;row < ROWS;row++)
+			{
+				const __m256 aValues = _mm256_load_ps(&a[row * aStride + z]);
+				for(unsigned int column = 0;column < COLUMNS;column++)
+				{
+					sums[row][column] = _mm256_fmadd_ps(aValues,bValues[column],sums[row][column]);
+				}
+			}
+		}
+
+		for(unsigned int row = 0;row < ROWS;row++)
+		{
+			for(unsigned int column = 0;column < COLUMNS;column++)
+			{
+				const float sum = SumLanesAVX2(sums[row][column]);
+				float& output = c[row * cStride + column];
+				output = accumulate ? output + sum : sum;
+			}
+		}
+	}
+};
+
+TARGET("avx2,fma") static void MultiplyTransposedAVX2(const float* a,const unsigned int aStride,const float* b,const unsigned int bStride,float* c,const unsigned int cStride,const unsigned int m,const unsigned int n,const unsigned int k)
+{
+	MultiplyBlocks<MultiplyKernelAVX2>(a,aStride,b,bStride,c,cStride,m,n,k);
+}
+
+//Some GCC versions warn about the deliberately undefined registers inside their own AVX-512
+//intrinsics when they're used from a target attribute function.
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wuninitialized"
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+#endif
+TARGET("avx512f") static float DotProductAVX512(const float* weights,const unsigned char* inputs,const unsigned int count)
+{
+	__m512 sum0 = _mm512_setzero_ps();
+	__m512 sum1 = _mm512_setzero_ps();
+	unsigned int x = 0;
+	for(;x + 32 <= count;x += 32)
+	{
+		const __m512 low = _mm512_cvtepi32_ps(_mm512_cvtepu8_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(&inputs[x]))));
+		const __m512 high = _mm512_cvtepi32_ps(_mm512_cvtepu8_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(&inputs[x + 16]))));
+		sum0 = _mm512_fmadd_ps(_mm512_loadu_ps(&weights[x]),low,sum0);
+		sum1 = _mm512_fmadd_ps(_mm512_loadu_ps(&weights[x + 16]),high,sum1);
+	}
+	for(;x + 16 <= count;x += 16)
+	{
+		const __m512 values = _mm512_cvtepi32_ps(_mm512_cvtepu8_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(&inputs[x]))));
+		sum0 = _mm512_fmadd_ps(_mm512_loadu_ps(&weights[x]),values,sum0);
+	}
+
+	return _mm512_reduce_add_ps(_mm512_add_ps(sum0,sum1)) + DotProductScalar(&weights[x],&inputs[x],count - x);
+}
+
+TARGET("avx512f") static float DotProductAVX512(const float* weights,const float* inputs,const unsigned int count)
+{
+	__m512 sum0 = _mm512_setzero_ps();
+	__m512 sum1 = _mm512_setzero_ps();
+	unsigned int x = 0;
+	for(;x + 32 <= count;x += 32)
+	{
+		sum0 = _mm512_fmadd_ps(_mm512_loadu_ps(&weights[x]),_mm512_loadu_ps(&inputs[x]),sum0);
+		sum1 = _mm512_fmadd_ps(_mm512_loadu_ps(&weights[x + 16]),_mm512_loadu_ps(&inputs[x + 16]),sum1);
+	}
+	for(;x + 16 <= count;x += 16)
+	{
+		sum0 = _mm512_fmadd_ps(_mm512_loadu_ps(&weights[x]),_mm512_loadu_ps(&inputs[x]),sum0);
+	}
+
+	return _mm512_reduce_add_ps(_mm512_add_ps(sum0,sum1)) + DotProductScalar(&weights[x],&inputs[x],count - x);
+}
+
+TARGET("avx512f") static float MaskedSumAVX512(const float* weights,const uint64_t* bits,const unsigned int count)
+{
+	//Masked loads skip weights whose bit isn't set, including any past the end of weights.
+	__m512 sum = _mm512_setzero_ps();
+	for(unsigned int x = 0;x < count;x += 16)
+	{
+		const __mmask16 mask = (bits[x / 64] >> (x % 64)) & 0xFFFF;
+		if(mask != 0)
+			sum = _mm512_add_ps(sum,_mm512_maskz_loadu_ps(mask,&weights[x]));
+	}
+
+	return _mm512_reduce_add_ps(sum);
+}
+
+TARGET("avx512f") static __m512 ExponentialAVX512(__m512 values)
+{
+	values = _mm512_min_ps(_mm512_max_ps(values,_mm512_set1_ps(EXP_MINIMUM)),_mm512_set1_ps(EXP_MAXIMUM));
+
+	const __m512 n = _mm512_roundscale_ps(_mm512_mul_ps(values,_mm512_set1_ps(LOG2_E)),_MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+	__m512 r = _mm512_fnmadd_ps(n,_mm512_set1_ps(LN2_HIGH),values);
+	r = _mm512_fnmadd_ps(n,_mm512_set1_ps(LN2_LOW),r);
+
+	__m512 polynomial = _mm512_set1_ps(EXP_COEFFICIENTS[0]);
+	for(unsigned int x = 1;x < sizeof(EXP_COEFFICIENTS) / sizeof(EXP_COEFFICIENTS[0]);x++)
+	{
+		polynomial = _mm512_fmadd_ps(polynomial,r,_mm512_set1_ps(EXP_COEFFICIENTS[x]));
+	}
+	polynomial = _mm512_fmadd_ps(polynomial,_mm512_mul_ps(r,r),_mm512_add_ps(r,_mm512_set1_ps(1.0f)));
+
+	//vscalefps multiplies by 2^n without building the exponent bits by hand.
+	return _mm512_scalef_ps(polynomial,n);
+}
+
+TARGET("avx512f") static void ApplyExponentialAVX512(float* values,const unsigned int count)
+{
+	unsigned int x = 0;
+	for(;x + 16 <= count;x += 16)
+	{
+		_mm512_storeu_ps(&values[x],ExponentialAVX512(_mm512_loadu_ps(&values[x])));
+	}
+	if(x < count)
+	{
+		const __mmask16 mask = (1u << (count - x)) - 1;
+		_mm512_mask_storeu_ps(&values[x],mask,ExponentialAVX512(_mm512_maskz_loadu_ps(mask,&values[x])));
+	}
+}
+
+TARGET("avx512f") static void ApplySigmoidAVX512(float* values,const unsigned int count)
+{
+	const __m512 one = _mm512_set1_ps(1.0f);
+	for(unsigned int x = 0;x < count;x += 16)
+	{
+		const __mmask16 mask = count - x >= 16 ? 0xFFFF : (1u << (count - x)) - 1;
+		const __m512 value16 = _mm512_maskz_loadu_ps(mask,&values[x]);
+		const __m512 sigmoid = _mm512_div_ps(one,_mm512_add_ps(one,ExponentialAVX512(_mm512_sub_ps(_mm512_setzero_ps(),value16))));
+		const __mmask16 nonZeroMask = _mm512_cmp_ps_mask(value16,_mm512_set1_ps(SIGMOID_ZERO),_CMP_GE_OQ);
+		_mm512_mask_storeu_ps(&values[x],mask,_mm512_maskz_mov_ps(nonZeroMask,sigmoid));
+	}
+}
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+#endif
+
+static int DotProductScalar(const signed char* weights,const unsigned char* inputs,const unsigned int count)
+{
+	int sum = 0;
+	for(unsigned int x = 0;x < count;x++)
+	{
+		sum += static_cast<int>(weights[x]) * static_cast<int>(inputs[x]);
+	}
+
+	return sum;
+}
+
+#ifdef USE_CPU_DISPATCH
+TARGET("ssse3") static int SumLanesSSSE3(__m128i values)
+{
+	values = _mm_add_epi32(values,_mm_shuffle_epi32(values,_MM_SHUFFLE(1,0,3,2)));
+	values = _mm_add_epi32(values,_mm_shuffle_epi32(values,_MM_SHUFFLE(2,3,0,1)));
+	return _mm_cvtsi128_si32(values);
+}
+
+TARGET("ssse3") static int DotProductSSSE3(const signed char* weights,const unsigned char* inputs,const unsigned int count)
+{
+	//pmaddubsw multiplies unsigned by signed bytes and adds neighbouring pairs into 16-bit lanes.
+	//pmaddwd against ones then widens those to 32-bit sums.
+	const __m128i ones = _mm_set1_epi16(1);
+	__m128i sum = _mm_setzero_si128();
+	for(unsigned int x = 0;x < count;x += 16)
+	{
+		const __m128i input16 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&inputs[x]));
+		const __m128i weights16 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&weights[x]));
+		sum = _mm_add_epi32(sum,_mm_madd_epi16(_mm_maddubs_epi16(input16,weights16),ones));
+	}
+
+	return SumLanesSSSE3(sum);
+}
+
+TARGET("avx2") static int DotProductAVX2(const signed char* weights,const unsigned char* inputs,const unsigned int count)
+{
+	const __m256i ones = _mm256_set1_epi16(1);
+	__m256i sum = _mm256_setzero_si256();
+	for(unsigned int x = 0;x < count;x += 32)
+	{
+		const __m256i input32 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(&inputs[x]));
+		const __m256i weights32 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(&weights[x]));
+		sum = _mm256_add_epi32(sum,_mm256_madd_epi16(_mm256_maddubs_epi16(input32,weights32),ones));
+	}
+
+	__m128i sum4 = _mm_add_epi32(_mm256_castsi256_si128(sum),_mm256_extracti128_si256(sum,1));
+	sum4 = _mm_add_epi32(sum4,_mm_shuffle_epi32(sum4,_MM_SHUFFLE(1,0,3,2)));
+	sum4 = _mm_add_epi32(sum4,_mm_shuffle_epi32(sum4,_MM_SHUFFLE(2,3,0,1)));
+	return _mm_cvtsi128_si32(sum4);
+}
+
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wuninitialized"
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+#endif
+TARGET("avx512f,avx512bw,avx512vnni") static int DotProductAVX512VNNI(const signed char* weights,const unsigned char* inputs,const unsigned int count)
+{
+	//vpdpbusd does the multiply, pair add and widen in one instruction.
+	__m512i sum = _mm512_setzero_si512();
+	for(unsigned int x = 0;x < count;x += 64)
+	{
+		const __m512i input64 = _mm512_loadu_si512(&inputs[x]);
+		const __m512i weights64 = _mm512_loadu_si512(&weights[x]);
+		sum = _mm512_dpbusd_epi32(sum,input64,weights64);
+	}
+
+	return _mm512_reduce_add_epi32(sum);
+}
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+#endif
+
+namespace
+{
+	struct FloatKernels
+	{
+		const char* instructionSet;
+		float (*bytes)(const float*,const unsigned char*,const unsigned int);
+		float (*floats)(const float*,const float*,const unsigned int);
+		float (*maskedSum)(const float*,const uint64_t*,const unsigned int);
+		void (*exponential)(float*,const unsigned int);
+		void (*sigmoid)(float*,const unsigned int);
+		void (*multiplyTransposed)(const float*,const unsigned int,const float*,const unsigned int,float*,const unsigned int,const unsigned int,const unsigned int,const unsigned int);
+	};
+
+	struct Int8DotProductKernel
+	{
+		const char* instructionSet;
+		int (*int8)(const signed char*,const unsigned char*,const unsigned int);
+	};
+}
+
+static FloatKernels SelectFloatKernels()
+{
+#ifdef USE_CPU_DISPATCH
+	__builtin_cpu_init();
+	if(__builtin_cpu_supports("avx512f"))
+		return {"AVX-512",DotProductAVX512,DotProductAVX512,MaskedSumAVX512,ApplyExponentialAVX512,ApplySigmoidAVX512,MultiplyTransposedAVX2};
+	else if(__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+		return {"AVX2",DotProductAVX2,DotProductAVX2,MaskedSumAVX2,ApplyExponentialAVX2,ApplySigmoidAVX2,MultiplyTransposedAVX2};
+	else if(__builtin_cpu_supports("sse2"))
+		return {"SSE2",DotProductSSE2,DotProductSSE2,MaskedSumScalar,ApplyExponentialScalar,ApplySigmoidScalar,MultiplyTransposedSSE2};
+#elif defined(_M_X64)
+	return {"SSE2",DotProductSSE2,DotProductSSE2,MaskedSumScalar,ApplyExponentialScalar,ApplySigmoidScalar,MultiplyTransposedSSE2};
+#endif
+	return {"None",DotProductScalar<unsigned char>,DotProductScalar<float>,MaskedSumScalar,ApplyExponentialScalar,ApplySigmoidScalar,MultiplyTransposedScalar};
+}
+
+static Int8DotProductKernel SelectInt8DotProductKernel()
+{
+#ifdef USE_CPU_DISPATCH
+	__builtin_cpu_init();
+	if(__builtin_cpu_supports("avx512vnni") && __builtin_cpu_supports("avx512bw"))
+		return {"AVX-512 VNNI",DotProductAVX512VNNI};
+	else if(__builtin_cpu_supports("avx2"))
+		return {"AVX2",DotProductAVX2};
+	else if(__builtin_cpu_supports("ssse3"))
+		return {"SSSE3",DotProductSSSE3};
+#endif
+	return {"None",DotProductScalar};
+}
+
+static const FloatKernels floatKernels = SelectFloatKernels();
+static const Int8DotProductKernel int8DotProductKernel = SelectInt8DotProductKernel();
+
+float DotProduct(const float* weights,const unsigned char* inputs,const unsigned int count)
+{
+	return floatKernels.bytes(weights,inputs,count);
+}
+
+float DotProduct(const float* weights,const float* inputs,const unsigned int count)
+{
+	return floatKernels.floats(weights,inputs,count);
+}
+
+float MaskedSum(const float* weights,const uint64_t* bits,const unsigned int count)
+{
+	return floatKernels.maskedSum(weights,bits,count);
+}
+
+void MultiplyTransposed(const float* a,const unsigned int aStride,const float* b,const unsigned int bStride,float* c,const unsigned int cStride,const unsigned int m,const unsigned int n,const unsigned int k)
+{
+	floatKernels.multiplyTransposed(a,aStride,b,bStride,c,cStride,m,n,k);
+}
+
+void ApplyExponential(float* values,const unsigned int count)
+{
+	floatKernels.exponential(values,count);
+}
+
+void ApplySigmoid(float* values,const unsigned int count)
+{
+	floatKernels.sigmoid(values,count);
+}
+
+const char* DotProductInstructionSet()
+{
+	return floatKernels.instructionSet;
+}
+
+int DotProduct(const signed char* weights,const unsigned char* inputs,const unsigned int count)
+{
+	return int8DotProductKernel.int8(weights,inputs,count);
+}
+
+const char* Int8DotProductInstructionSet()
+{
+	return int8DotProductKernel.instructionSet;
+}
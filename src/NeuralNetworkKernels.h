@@ -0,0 +1,54 @@
+// Copyright 2017 James Bendig. See the COPYRIGHT file at the top-level
+// directory of this distribution.
+//
+// Licensed under:
+//   the MIT license
+//     <LICENSE-MIT or https://opensource.org/licenses/MIT>
+//   or the Apache License, Version 2.0
+//     <LICENSE-APACHE or https://www.apache.org/licenses/LICENSE-2.0>,
+// at your option. This file may not be copied, modified, or distributed
+// except according to those terms.
+
+
+#ifndef NEURALNETWORKKERNELS_H
+#define NEURALNETWORKKERNELS_H
+
+#include <cstdint>
+
+//c[i][j] = sum of a[i][z] * b[j][z] for z < k, i < m and j < n. All matrices are row-major so this is
+//C = A * B^T. Storing both inputs (A, one row per input) and weights (B, one row per neuron) along
+//k lets every row be read sequentially. k and every stride must be a multiple of 8 and every row
+//must be 32-byte aligned. Uses AVX2 with FMA, SSE2 or plain C++, picked at startup like DotProduct().
+void MultiplyTransposed(const float* a,const unsigned int aStride,const float* b,const unsigned int bStride,float* c,const unsigned int cStride,const unsigned int m,const unsigned int n,const unsigned int k);
+
+//Sum of weights[x] * inputs[x] for x < count. Inputs are either raw 8-bit pixels, which are widened
+//to float in registers, or the previous layer's outputs. Neither needs to be aligned or padded. The
+//widest of AVX-512, AVX2 with FMA, SSE2 or plain C++ that the CPU supports is picked at startup so
+//one build runs well on every x86-64 machine.
+float DotProduct(const float* weights,const unsigned char* inputs,const unsigned int count);
+float DotProduct(const float* weights,const float* inputs,const unsigned int count);
+const char* DotProductInstructionSet(); //Name of the instruction set DotProduct() is using.
+
+//Sum of weights[x] for every set bit x < count. Bit x is bit x % 64 of bits[x / 64] and bits past
+//count must be zero. Same as DotProduct() with 0/1 inputs but only the weights of set bits are
+//read. weights must have room for count rounded up to a multiple of 8. Uses the same instruction
+//set as DotProduct() except SSE2, which falls back to plain C++.
+float MaskedSum(const float* weights,const uint64_t* bits,const unsigned int count);
+
+//Replace each of count values with exp(value) or 1 / (1 + exp(-value)), 8 or 16 at a time. exp() is
+//a range reduction to 2^n * exp(r) with |r| <= ln(2) / 2 and a degree 6 polynomial for exp(r). The
+//result is within 2e-7 relative error of the exact value. exp() inputs are clamped to [-87, 88] so
+//nothing overflows. Sigmoid of anything below -70 is exactly 0 so later layers never multiply
+//denormals, which are very slow. Uses the same instruction set as DotProduct() except SSE2, which
+//falls back to plain C++.
+void ApplyExponential(float* values,const unsigned int count);
+void ApplySigmoid(float* values,const unsigned int count);
+
+//Sum of weights[x] * inputs[x] for x < count using 8-bit integers. count must be a multiple of 64.
+//Every input must be at most 127 so each pair of products fits in 16 bits without saturating
+//(pmaddubsw). Picks AVX-512 VNNI, AVX2, SSSE3 or plain C++ at startup the same way as above.
+int DotProduct(const signed char* weights,const unsigned char* inputs,const unsigned int count);
+const char* Int8DotProductInstructionSet(); //Name of the instruction set the 8-bit DotProduct() is using.
+
+#endif
+
@@ -124,7 +124,61 @@ static void BuildGridIndices(const unsigned int gridSize,std::vector<GLuint>& in
 	}
 }
 
-static void DrawImagePrivate(const ShaderProgram& imageProgram,const Image& srcImage,const GLfloat* vertices,const GLuint vertexCount,const GLuint* indices,const GLuint indexCount)
+//Textures are always GL_RGB. OpenGL ES 3.0 only accepts GL_RGB pixels for them and they have to
+//stay colour-renderable so they can be drawn into. Greyscale images are expanded to RGB first.
+static void UploadImage(const Image<RGB8>& image)
+{
+	//Copy image to the bound texture. Rows are tightly packed or padded out to stride so the
+	//default 4 byte alignment doesn't apply.
+	glPixelStorei(GL_UNPACK_ALIGNMENT,1);
+	glPixelStorei(GL_UNPACK_ROW_LENGTH,image.stride / Image<RGB8>::CHANNELS);
+	glTexImage2D(GL_TEXTURE_2D,0,GL_RGB,image.width,image.height,0,GL_RGB,GL_UNSIGNED_BYTE,&image.data[0]);
+	glPixelStorei(GL_UNPACK_ROW_LENGTH,0);
+	glPixelStorei(GL_UNPACK_ALIGNMENT,4);
+}
+
+static void UploadImage(const Image<Gray8>& image)
+{
+	Image<RGB8> rgbImage(image.width,image.height);
+	for(unsigned int y = 0;y < image.height;y++)
+	{
+		const unsigned char* srcRow = image.Row(y);
+		unsigned char* dstRow = rgbImage.Row(y);
+		for(unsigned int x = 0;x < image.width;x++)
+		{
+			dstRow[x * 3 + 0] = srcRow[x];
+			dstRow[x * 3 + 1] = srcRow[x];
+			dstRow[x * 3 + 2] = srcRow[x];
+		}
+	}
+	UploadImage(rgbImage);
+}
+
+//Copy the bound framebuffer to image. GL_RGBA is the only format OpenGL ES 3.0 always lets
+//glReadPixels() use so the channels image needs are picked out of that.
+template <class Format>
+static void ReadImage(const unsigned int width,const unsigned int height,Image<Format>& image)
+{
+	std::vector<unsigned char> rgba(width * height * 4);
+	glReadPixels(0,0,width,height,GL_RGBA,GL_UNSIGNED_BYTE,rgba.data());
+
+	image.Resize(width,height);
+	for(unsigned int y = 0;y < height;y++)
+	{
+		const unsigned char* srcRow = &rgba[y * width * 4];
+		unsigned char* dstRow = image.Row(y);
+		for(unsigned int x = 0;x < width;x++)
+		{
+			for(unsigned int channel = 0;channel < Image<Format>::CHANNELS;channel++)
+			{
+				dstRow[x * Image<Format>::CHANNELS + channel] = srcRow[x * 4 + channel];
+			}
+		}
+	}
+}
+
+template <class Format>
+static void DrawImagePrivate(const ShaderProgram& imageProgram,const Image<Format>& srcImage,const GLfloat* vertices,const GLuint vertexCount,const GLuint* indices,const GLuint indexCount)
 {
 	if(srcImage.data.empty())
 		return;
@@ -140,7 +194,7 @@ static void DrawImagePrivate(const ShaderProgram& imageProgram,const Image& srcI
 	glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_MIN_FILTER,GL_LINEAR);
 	glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_MAG_FILTER,GL_LINEAR);
 	glUniform1i(imageProgram.Uniform("inputTexture"),0);
-	glTexImage2D(GL_TEXTURE_2D,0,GL_RGB,srcImage.width,srcImage.height,0,GL_RGB,GL_UNSIGNED_BYTE,&srcImage.data[0]);
+	UploadImage(srcImage);
 
 	GLuint vao;
 	glGenVertexArrays(1,&vao);
@@ -171,7 +225,8 @@ Painter::Painter()
 {
 }
 
-void Painter::DrawImage(const float x,float y,float width,float height,const Image& image)
+template <class Format>
+void Painter::DrawImage(const float x,float y,float width,float height,const Image<Format>& image)
 {
 	float windowWidth = 0.0f;
 	float windowHeight = 0.0f;
@@ -205,7 +260,8 @@ void Painter::DrawImage(const float x,float y,float width,float height,const Ima
 	DrawImagePrivate(imageProgram,image,vertices,4,indices,6);
 }
 
-void Painter::DrawImage(const Point topLeft,const Point topRight,const Point bottomLeft,const Point bottomRight,const Image& image)
+template <class Format>
+void Painter::DrawImage(const Point topLeft,const Point topRight,const Point bottomLeft,const Point bottomRight,const Image<Format>& image)
 {
 	float windowWidth = 0.0f;
 	float windowHeight = 0.0f;
@@ -273,7 +329,8 @@ void Painter::DrawLine(float x1,float y1,float x2,float y2,const unsigned char r
 	glUseProgram(0);
 }
 
-void Painter::ExtractImage(const Image& srcImage,const Point topLeft,const Point topRight,const Point bottomLeft,const Point bottomRight,Image& dstImage,const unsigned int dstImageWidth,const unsigned int dstImageHeight)
+template <class Format>
+void Painter::ExtractImage(const Image<Format>& srcImage,const Point topLeft,const Point topRight,const Point bottomLeft,const Point bottomRight,Image<Format>& dstImage,const unsigned int dstImageWidth,const unsigned int dstImageHeight)
 {
 	glm::mat3 matrix = BuildPerspectiveMatrix(glm::vec2(topLeft.x,topLeft.y),
 											  glm::vec2(topRight.x,topRight.y),
@@ -308,10 +365,7 @@ void Painter::ExtractImage(const Image& srcImage,const Point topLeft,const Point
 	Viewport viewport(dstImageWidth,dstImageHeight);
 	DrawImagePrivate(imageProgram,srcImage,vertices.data(),vertices.size() / 5,indices.data(),indices.size());
 
-	dstImage.width = dstImageWidth;
-	dstImage.height = dstImageHeight;
-	dstImage.data.resize(dstImage.width * dstImage.height * 3);
-	glReadPixels(0,0,dstImage.width,dstImage.height,GL_RGB,GL_UNSIGNED_BYTE,&dstImage.data[0]);
+	ReadImage(dstImageWidth,dstImageHeight,dstImage);
 
 	glBindVertexArray(0);
 
@@ -319,7 +373,8 @@ void Painter::ExtractImage(const Image& srcImage,const Point topLeft,const Point
 	glDeleteTextures(1,&outputTexture);
 }
 
-void Painter::ScaleImage(const Image& srcImage,Image& dstImage,const unsigned int dstImageWidth,const unsigned int dstImageHeight)
+template <class Format>
+void Painter::ScaleImage(const Image<Format>& srcImage,Image<Format>& dstImage,const unsigned int dstImageWidth,const unsigned int dstImageHeight)
 {
 	ExtractImage(srcImage,
 				 {0.0f,0.0f},
@@ -331,14 +386,14 @@ void Painter::ScaleImage(const Image& srcImage,Image& dstImage,const unsigned in
 				 dstImageHeight);
 }
 
-void Painter::DrawPuzzleGrid(const Image& srcImage,const float borderLineWidth,const float gridMinorLineWidth,const float gridMajorLineWidth,Image& dstImage)
+void Painter::DrawPuzzleGrid(const Image<Gray8>& srcImage,const float borderLineWidth,const float gridMinorLineWidth,const float gridMajorLineWidth,Image<Gray8>& dstImage)
 {
 	GLuint outputTexture;
 	glGenTextures(1,&outputTexture);
 	glBindTexture(GL_TEXTURE_2D,outputTexture);
 	glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_MIN_FILTER,GL_LINEAR);
 	glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_MAG_FILTER,GL_LINEAR);
-	glTexImage2D(GL_TEXTURE_2D,0,GL_RGB,srcImage.width,srcImage.height,0,GL_RGB,GL_UNSIGNED_BYTE,&srcImage.data[0]);
+	UploadImage(srcImage);
 
 	GLuint fbo;
 	glGenFramebuffers(1,&fbo);
@@ -370,8 +425,7 @@ void Painter::DrawPuzzleGrid(const Image& srcImage,const float borderLineWidth,c
 	}
 
 	//Extract final image.
-	dstImage.MatchSize(srcImage);
-	glReadPixels(0,0,dstImage.width,dstImage.height,GL_RGB,GL_UNSIGNED_BYTE,&dstImage.data[0]);
+	ReadImage(srcImage.width,srcImage.height,dstImage);
 
 	glDeleteFramebuffers(1,&fbo);
 	glDeleteTextures(1,&outputTexture);
@@ -382,32 +436,15 @@ void Painter::DrawPuzzleGrid(const Image& srcImage,const float borderLineWidth,c
 void Painter::DrawNoise(const unsigned int width,const unsigned int height,const float noiseDelta)
 {
 	//Create a noise textures and use blending to apply them.
-	Image addNoiseImage(width,height);
-	Image subNoiseImage(width,height);
+	Image<Gray8> addNoiseImage(width,height);
+	Image<Gray8> subNoiseImage(width,height);
 	std::random_device randomDevice;
 	std::mt19937 randomNumberGenerator(randomDevice());
 	for(unsigned int x = 0;x < addNoiseImage.width * addNoiseImage.height;x++)
 	{
-		const unsigned int index = x * 3;
 		const int value = lrint((randomNumberGenerator() / static_cast<double>(std::mt19937::max()) - 0.5) * noiseDelta * 255.0);
-		if(value >= 0)
-		{
-			addNoiseImage.data[index + 0] = value;
-			addNoiseImage.data[index + 1] = value;
-			addNoiseImage.data[index + 2] = value;
-			subNoiseImage.data[index + 0] = 0;
-			subNoiseImage.data[index + 1] = 0;
-			subNoiseImage.data[index + 2] = 0;
-		}
-		else
-		{
-			addNoiseImage.data[index + 0] = 0;
-			addNoiseImage.data[index + 1] = 0;
-			addNoiseImage.data[index + 2] = 0;
-			subNoiseImage.data[index + 0] = -value;
-			subNoiseImage.data[index + 1] = -value;
-			subNoiseImage.data[index + 2] = -value;
-		}
+		addNoiseImage.data[x] = value >= 0 ? value : 0;
+		subNoiseImage.data[x] = value >= 0 ? 0 : -value;
 	}
 
 	glEnable(GL_BLEND);
@@ -419,7 +456,7 @@ void Painter::DrawNoise(const unsigned int width,const unsigned int height,const
 	glDisable(GL_BLEND);
 }
 
-void Painter::DrawWarpedAndUnwarpedPuzzle(const Image& srcImage,const unsigned int frameBufferSize,const float perspectiveCornerRandomRadius,const float noiseDelta,Image& dstImage,const unsigned int dstImageSize)
+void Painter::DrawWarpedAndUnwarpedPuzzle(const Image<Gray8>& srcImage,const unsigned int frameBufferSize,const float perspectiveCornerRandomRadius,const float noiseDelta,Image<Gray8>& dstImage,const unsigned int dstImageSize)
 {
 	//Setup four corners with the render buffer where the srcImage will be rendered using a
 	//perspective warp. Each corner is placed randomly within a circle that touches the respective
@@ -485,8 +522,8 @@ void Painter::DrawWarpedAndUnwarpedPuzzle(const Image& srcImage,const unsigned i
 	//Extract framebuffer as an image. This part could be skipped in favor of doing the rest of the
 	//work directly on the GPU. But, this lets us re-use the ExtractImage() function which is used
 	//to extract a puzzle from a video frame.
-	Image renderBufferImage(frameBufferSize,frameBufferSize);
-	glReadPixels(0,0,renderBufferImage.width,renderBufferImage.height,GL_RGB,GL_UNSIGNED_BYTE,&renderBufferImage.data[0]);
+	Image<Gray8> renderBufferImage;
+	ReadImage(frameBufferSize,frameBufferSize,renderBufferImage);
 
 	//Clean-up.
 	glDeleteFramebuffers(1,&fbo);
@@ -511,3 +548,11 @@ void Painter::DrawWarpedAndUnwarpedPuzzle(const Image& srcImage,const unsigned i
 				 dstImageSize);
 }
 
+template void Painter::DrawImage(const float x,float y,float width,float height,const Image<Gray8>& image);
+template void Painter::DrawImage(const float x,float y,float width,float height,const Image<RGB8>& image);
+template void Painter::DrawImage(const Point topLeft,const Point topRight,const Point bottomLeft,const Point bottomRight,const Image<Gray8>& image);
+template void Painter::DrawImage(const Point topLeft,const Point topRight,const Point bottomLeft,const Point bottomRight,const Image<RGB8>& image);
+template void Painter::ExtractImage(const Image<Gray8>& srcImage,const Point topLeft,const Point topRight,const Point bottomLeft,const Point bottomRight,Image<Gray8>& dstImage,const unsigned int dstImageWidth,const unsigned int dstImageHeight);
+template void Painter::ExtractImage(const Image<RGB8>& srcImage,const Point topLeft,const Point topRight,const Point bottomLeft,const Point bottomRight,Image<RGB8>& dstImage,const unsigned int dstImageWidth,const unsigned int dstImageHeight);
+template void Painter::ScaleImage(const Image<Gray8>& srcImage,Image<Gray8>& dstImage,const unsigned int dstImageWidth,const unsigned int dstImageHeight);
+template void Painter::ScaleImage(const Image<RGB8>& srcImage,Image<RGB8>& dstImage,const unsigned int dstImageWidth,const unsigned int dstImageHeight);
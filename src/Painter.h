@@ -16,23 +16,29 @@
 #include "Geometry.h"
 #include "ShaderProgram.h"
 
-struct Image;
+struct Gray8;
+template <class Format> struct Image;
 
 class Painter
 {
 	public:
 		Painter();
 
-		void DrawImage(const float x,float y,float width,float height,const Image& image);
-		void DrawImage(const Point topLeft,const Point topRight,const Point bottomLeft,const Point bottomRight,const Image& image);
+		//Image functions are available for Gray8 and RGB8 images.
+		template <class Format>
+		void DrawImage(const float x,float y,float width,float height,const Image<Format>& image);
+		template <class Format>
+		void DrawImage(const Point topLeft,const Point topRight,const Point bottomLeft,const Point bottomRight,const Image<Format>& image);
 		void DrawLine(float x1,float y1,float x2,float y2,const unsigned char red,const unsigned char green,const unsigned char blue);
 
-		void ExtractImage(const Image& srcImage,const Point topLeft,const Point topRight,const Point bottomLeft,const Point bottomRight,Image& dstImage,const unsigned int dstImageWidth,const unsigned int dstImageHeight);
-		void ScaleImage(const Image& srcImage,Image& dstImage,const unsigned int dstImageWidth,const unsigned int dstImageHeight);
+		template <class Format>
+		void ExtractImage(const Image<Format>& srcImage,const Point topLeft,const Point topRight,const Point bottomLeft,const Point bottomRight,Image<Format>& dstImage,const unsigned int dstImageWidth,const unsigned int dstImageHeight);
+		template <class Format>
+		void ScaleImage(const Image<Format>& srcImage,Image<Format>& dstImage,const unsigned int dstImageWidth,const unsigned int dstImageHeight);
 
-		void DrawPuzzleGrid(const Image& srcImage,const float borderLineWidth,const float gridMinorLineWidth,const float gridMajorLineWidth,Image& dstImage);
+		void DrawPuzzleGrid(const Image<Gray8>& srcImage,const float borderLineWidth,const float gridMinorLineWidth,const float gridMajorLineWidth,Image<Gray8>& dstImage);
 		void DrawNoise(const unsigned int width,const unsigned int height,const float noiseDelta);
-		void DrawWarpedAndUnwarpedPuzzle(const Image& srcImage,const unsigned int renderBufferSize,const float perspectiveCornerRandomRadius,const float noiseDelta,Image& dstImage,const unsigned int dstImageSize);
+		void DrawWarpedAndUnwarpedPuzzle(const Image<Gray8>& srcImage,const unsigned int renderBufferSize,const float perspectiveCornerRandomRadius,const float noiseDelta,Image<Gray8>& dstImage,const unsigned int dstImageSize);
 	private:
 		ShaderProgram imageProgram;
 		ShaderProgram lineProgram;
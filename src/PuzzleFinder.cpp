@@ -19,7 +19,7 @@ static constexpr float DELTA_THETA = M_PI / 12.0f;
 
 static void FindLines(const unsigned int targetWidth,
 					  const unsigned int targetHeight,
-					  const Image& houghTransformFrame,
+					  const Image<Gray16>& houghTransformFrame,
 					  std::vector<Line>& lines)
 {
 	//Find peaks using a sliding window. A peak exists when all surrounding pixels within some
@@ -36,11 +36,13 @@ static void FindLines(const unsigned int targetWidth,
 	//Make the minimum peak value 3/4th of the highest peak value. This is somewhat arbitrary as
 	//well but it out performs the statistical models I've tried.
 	unsigned short maximumValue = 0;
-	for(unsigned int x = 0;x < houghTransformFrame.width * houghTransformFrame.height;x++)
+	for(unsigned int y = 0;y < houghTransformFrame.height;y++)
 	{
-		const unsigned int index = x * 3;
-		const unsigned short value = *reinterpret_cast<const unsigned short*>(&houghTransformFrame.data[index]);
-		maximumValue = std::max(maximumValue,value);
+		const unsigned short* row = houghTransformFrame.Row(y);
+		for(unsigned int x = 0;x < houghTransformFrame.width;x++)
+		{
+			maximumValue = std::max(maximumValue,row[x]);
+		}
 	}
 	const unsigned short minimumValue = maximumValue / 2;
 	if(minimumValue == 0)
@@ -51,8 +53,7 @@ static void FindLines(const unsigned int targetWidth,
 		if(x >= houghTransformFrame.width || y >= houghTransformFrame.height)
 			return 0;
 
-		const unsigned int index = (y * houghTransformFrame.width + x) * 3;
-		return *reinterpret_cast<const unsigned short*>(&houghTransformFrame.data[index]);
+		return houghTransformFrame.Row(y)[x];
 	};
 
 	for(unsigned int y = 0;y < houghTransformFrame.height;y++)
@@ -238,7 +239,7 @@ static void FindPuzzles(const std::vector<std::vector<Line>>& possiblePuzzleLine
 	}
 }
 
-bool PuzzleFinder::Find(const unsigned int targetWidth,const unsigned int targetHeight,const Image& houghTransformFrame,std::vector<Point>& puzzlePoints)
+bool PuzzleFinder::Find(const unsigned int targetWidth,const unsigned int targetHeight,const Image<Gray16>& houghTransformFrame,std::vector<Point>& puzzlePoints)
 {
 	//Find all of the lines in the hough transform.
 	FindLines(targetWidth,targetHeight,houghTransformFrame,lines);
@@ -16,12 +16,13 @@
 #include <vector>
 #include "Geometry.h"
 
-struct Image;
+struct Gray16;
+template <class Format> struct Image;
 
 class PuzzleFinder
 {
 	public:
-		bool Find(const unsigned int targetWidth,const unsigned int targetHeight,const Image& houghTransformFrame,std::vector<Point>& puzzlePoints);
+		bool Find(const unsigned int targetWidth,const unsigned int targetHeight,const Image<Gray16>& houghTransformFrame,std::vector<Point>& puzzlePoints);
 
 		//Internal use only variables made public to ease debugging.
 		std::vector<Line> lines; //All lines found.
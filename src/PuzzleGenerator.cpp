@@ -0,0 +1,156 @@
+// Copyright 2017 James Bendig. See the COPYRIGHT file at the top-level
+// directory of this distribution.
+//
+// Licensed under:
+//   the MIT license
+//     <LICENSE-MIT or https://opensource.org/licenses/MIT>
+//   or the Apache License, Version 2.0
+//     <LICENSE-APACHE or https://www.apache.org/licenses/LICENSE-2.0>,
+// at your option. This file may not be copied, modified, or distributed
+// except according to those terms.
+
+
+#include "PuzzleGenerator.h"
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <numeric>
+#include "Solve.h"
+
+static constexpr unsigned int CELL_COUNT = Game::WIDTH * Game::HEIGHT;
+
+//Most search nodes for each difficulty. Anything above the last is Extreme.
+static constexpr unsigned long long EASY_MAXIMUM_NODES = 1;
+static constexpr unsigned long long MEDIUM_MAXIMUM_NODES = 5;
+static constexpr unsigned long long HARD_MAXIMUM_NODES = 20; //About 1 in 50 minimal puzzles need more.
+
+template <unsigned int N>
+static std::array<unsigned int,N> ShuffledIndexes(std::mt19937& randomNumberGenerator)
+{
+	std::array<unsigned int,N> indexes;
+	std::iota(indexes.begin(),indexes.end(),0);
+	std::shuffle(indexes.begin(),indexes.end(),randomNumberGenerator);
+	return indexes;
+}
+
+static std::array<unsigned int,Game::WIDTH> ShuffledLines(std::mt19937& randomNumberGenerator)
+{
+	//Lines can be swapped within a band (or stack) and whole bands can be swapped with each other.
+	const std::array<unsigned int,3> bands = ShuffledIndexes<3>(randomNumberGenerator);
+	std::array<unsigned int,Game::WIDTH> lines;
+	for(unsigned int band = 0;band < 3;band++)
+	{
+		const std::array<unsigned int,3> bandLines = ShuffledIndexes<3>(randomNumberGenerator);
+		for(unsigned int x = 0;x < 3;x++)
+		{
+			lines[band * 3 + x] = bands[band] * 3 + bandLines[x];
+		}
+	}
+
+	return lines;
+}
+
+const char* PuzzleDifficultyName(const PuzzleDifficulty difficulty)
+{
+	switch(difficulty)
+	{
+		case PuzzleDifficulty::Easy:
+			return "easy";
+		case PuzzleDifficulty::Medium:
+			return "medium";
+		case PuzzleDifficulty::Hard:
+			return "hard";
+		case PuzzleDifficulty::Extreme:
+			return "extreme";
+		default:
+			std::abort();
+	}
+}
+
+PuzzleGenerator::PuzzleGenerator(const unsigned int seed)
+	: randomNumberGenerator(seed)
+{
+}
+
+Game PuzzleGenerator::GenerateSolution()
+{
+	//Relabel digits, permute rows and columns and optionally transpose a simple valid grid. Every
+	//one of these keeps the grid valid.
+	const std::array<unsigned int,Game::MAX_VALUE> digits = ShuffledIndexes<Game::MAX_VALUE>(randomNumberGenerator);
+	const std::array<unsigned int,Game::HEIGHT> rows = ShuffledLines(randomNumberGenerator);
+	const std::array<unsigned int,Game::WIDTH> columns = ShuffledLines(randomNumberGenerator);
+	const bool transpose = std::uniform_int_distribution<>(0,1)(randomNumberGenerator) == 1;
+
+	Game solution;
+	for(unsigned int y = 0;y < Game::HEIGHT;y++)
+	{
+		for(unsigned int x = 0;x < Game::WIDTH;x++)
+		{
+			const unsigned int row = rows[transpose ? x : y];
+			const unsigned int column = columns[transpose ? y : x];
+			const unsigned int baseDigit = (row * 3 + row / 3 + column) % Game::MAX_VALUE;
+			solution.Set(x,y,digits[baseDigit] + 1);
+		}
+	}
+
+	return solution;
+}
+
+GeneratedPuzzle PuzzleGenerator::Generate(const unsigned int targetClueCount)
+{
+	GeneratedPuzzle generatedPuzzle;
+	generatedPuzzle.solution = GenerateSolution();
+	generatedPuzzle.puzzle = generatedPuzzle.solution;
+	generatedPuzzle.clueCount = CELL_COUNT;
+
+	//A clue can only be removed if the puzzle still has one solution without it. Once a clue is
+	//needed, removing more clues never makes it unnecessary so each cell only needs to be tried once.
+	const std::array<unsigned int,CELL_COUNT> cells = ShuffledIndexes<CELL_COUNT>(randomNumberGenerator);
+	for(unsigned int x = 0;x < CELL_COUNT && generatedPuzzle.clueCount > targetClueCount;x++)
+	{
+		const unsigned int cellX = cells[x] % Game::WIDTH;
+		const unsigned int cellY = cells[x] / Game::WIDTH;
+		const unsigned char digit = generatedPuzzle.puzzle.Get(cellX,cellY);
+		generatedPuzzle.puzzle.Set(cellX,cellY,Game::EMPTY_VALUE);
+
+		Game game = generatedPuzzle.puzzle;
+		if(CountSolutions(game,2) == 1)
+			generatedPuzzle.clueCount -= 1;
+		else
+			generatedPuzzle.puzzle.Set(cellX,cellY,digit);
+	}
+
+	generatedPuzzle.difficulty = Rate(generatedPuzzle.puzzle,generatedPuzzle.nodeCount);
+	return generatedPuzzle;
+}
+
+bool PuzzleGenerator::Generate(const unsigned int targetClueCount,const PuzzleDifficulty difficulty,const unsigned int maximumAttempts,GeneratedPuzzle& generatedPuzzle)
+{
+	for(unsigned int x = 0;x < maximumAttempts;x++)
+	{
+		generatedPuzzle = Generate(targetClueCount);
+		if(generatedPuzzle.difficulty == difficulty)
+			return true;
+	}
+
+	return false;
+}
+
+PuzzleDifficulty PuzzleGenerator::Rate(const Game& puzzle,unsigned long long& nodeCount)
+{
+	//Count every node needed to prove uniqueness rather than to find the first solution. That
+	//doesn't depend on how lucky the first guesses happen to be.
+	Game game = puzzle;
+	SolveBudget budget;
+	CountSolutions(game,2,budget);
+	nodeCount = budget.NodeCount();
+
+	if(nodeCount <= EASY_MAXIMUM_NODES)
+		return PuzzleDifficulty::Easy;
+	else if(nodeCount <= MEDIUM_MAXIMUM_NODES)
+		return PuzzleDifficulty::Medium;
+	else if(nodeCount <= HARD_MAXIMUM_NODES)
+		return PuzzleDifficulty::Hard;
+	return PuzzleDifficulty::Extreme;
+}
+
@@ -0,0 +1,64 @@
+// Copyright 2017 James Bendig. See the COPYRIGHT file at the top-level
+// directory of this distribution.
+//
+// Licensed under:
+//   the MIT license
+//     <LICENSE-MIT or https://opensource.org/licenses/MIT>
+//   or the Apache License, Version 2.0
+//     <LICENSE-APACHE or https://www.apache.org/licenses/LICENSE-2.0>,
+// at your option. This file may not be copied, modified, or distributed
+// except according to those terms.
+
+
+#ifndef PUZZLEGENERATOR_H
+#define PUZZLEGENERATOR_H
+
+#include <random>
+#include "Game.h"
+
+//Graded by how many search nodes it takes to prove the puzzle has a single solution. Easy puzzles
+//are solved by propagation alone. The rest need progressively more guessing.
+enum class PuzzleDifficulty
+{
+	Easy,
+	Medium,
+	Hard,
+	Extreme,
+};
+static constexpr unsigned int PUZZLE_DIFFICULTY_COUNT = 4;
+
+const char* PuzzleDifficultyName(const PuzzleDifficulty difficulty);
+
+struct GeneratedPuzzle
+{
+	Game puzzle;
+	Game solution;
+	unsigned int clueCount;
+	unsigned long long nodeCount; //Search nodes needed to prove the solution is unique.
+	PuzzleDifficulty difficulty;
+};
+
+//Builds valid puzzles with exactly one solution. A random complete grid is made by shuffling a
+//known valid grid with sudoku's symmetries and then clues are removed in random order as long as
+//the solution stays unique.
+class PuzzleGenerator
+{
+	public:
+		PuzzleGenerator(const unsigned int seed);
+
+		Game GenerateSolution();
+
+		//Remove clues until targetClueCount is reached or no clue can be removed. The result may
+		//have more clues than requested. Check GeneratedPuzzle::clueCount.
+		GeneratedPuzzle Generate(const unsigned int targetClueCount);
+
+		//Keep generating until a puzzle with the requested difficulty turns up.
+		bool Generate(const unsigned int targetClueCount,const PuzzleDifficulty difficulty,const unsigned int maximumAttempts,GeneratedPuzzle& generatedPuzzle);
+
+		static PuzzleDifficulty Rate(const Game& puzzle,unsigned long long& nodeCount);
+	private:
+		std::mt19937 randomNumberGenerator;
+};
+
+#endif
+
@@ -0,0 +1,213 @@
+// Copyright 2017 James Bendig. See the COPYRIGHT file at the top-level
+// directory of this distribution.
+//
+// Licensed under:
+//   the MIT license
+//     <LICENSE-MIT or https://opensource.org/licenses/MIT>
+//   or the Apache License, Version 2.0
+//     <LICENSE-APACHE or https://www.apache.org/licenses/LICENSE-2.0>,
+// at your option. This file may not be copied, modified, or distributed
+// except according to those terms.
+
+
+#include "QuantizedNeuralNetwork.h"
+#include <algorithm>
+#include <iostream>
+#include <cmath>
+#include "NeuralNetworkData.h"
+#include "NeuralNetworkKernels.h"
+
+//Activations between layers are stored as round(value * ACTIVATION_SCALE). The bias input, 1.0f,
+//is stored as ACTIVATION_SCALE too.
+static constexpr float ACTIVATION_SCALE = 127.0f;
+static constexpr unsigned int ROW_ALIGNMENT = 64; //What the 8-bit DotProduct() requires.
+
+[[noreturn]] static void UnexpectedInputSize()
+{
+	std::cerr << "QuantizedNeuralNetwork::Run(): Got unexpected input data size." << std::endl;
+	std::abort();
+}
+
+QuantizedNeuralNetwork::QuantizedNeuralNetwork()
+	: layers(),
+	  outputChoices(),
+	  inputSize(0)
+{
+}
+
+QuantizedNeuralNetwork QuantizedNeuralNetwork::Quantize(const NeuralNetworkData& data)
+{
+	QuantizedNeuralNetwork nn;
+	for(unsigned int x = 0;x + 1 < data.layers.size();x++)
+	{
+		if(data.layers[x].activation != Activation::Sigmoid)
+			return nn;
+	}
+	nn.outputChoices = data.outputChoices;
+	nn.inputSize = data.inputSize;
+
+	//The first layer sees the raw inputs and a bias input of 1. Later layers see activations that
+	//are ACTIVATION_SCALE times larger than the float network's.
+	float inputScale = 1.0f;
+	for(const ::Layer& layer : data.layers)
+	{
+		//Weights may be mapped from a model file so they're only read through Weights().
+		const float* weights = layer.Weights();
+		float maximumWeight = 0.0f;
+		for(unsigned int x = 0;x < layer.neuronCount * layer.stride;x++)
+		{
+			maximumWeight = std::max(maximumWeight,fabsf(weights[x]));
+		}
+		const float weightScale = maximumWeight == 0.0f ? 1.0f : maximumWeight / 127.0f;
+
+		Layer quantizedLayer;
+		quantizedLayer.neuronCount = layer.neuronCount;
+		quantizedLayer.stride = (layer.stride + ROW_ALIGNMENT - 1) / ROW_ALIGNMENT * ROW_ALIGNMENT;
+		quantizedLayer.scale = weightScale / inputScale;
+		quantizedLayer.weights.assign(layer.neuronCount * quantizedLayer.stride,0);
+		for(unsigned int y = 0;y < layer.neuronCount;y++)
+		{
+			const float* neuron = layer.Neuron(y);
+			signed char* quantizedNeuron = &quantizedLayer.weights[y * quantizedLayer.stride];
+			for(unsigned int x = 0;x < layer.stride;x++)
+			{
+				quantizedNeuron[x] = static_cast<signed char>(lroundf(neuron[x] / weightScale));
+			}
+		}
+		nn.layers.push_back(std::move(quantizedLayer));
+
+		inputScale = ACTIVATION_SCALE;
+	}
+
+	return nn;
+}
+
+bool QuantizedNeuralNetwork::Empty() const
+{
+	return layers.empty();
+}
+
+size_t QuantizedNeuralNetwork::WeightBytes() const
+{
+	size_t size = 0;
+	for(const Layer& layer : layers)
+	{
+		size += layer.weights.size() * sizeof(layer.weights[0]);
+	}
+
+	return size;
+}
+
+unsigned char QuantizedNeuralNetwork::Run(const std::vector<unsigned char>& inputData) const
+{
+	CheckInputSize(inputData.size());
+
+	Buffers buffers;
+	buffers.input.assign(layers[0].stride,0);
+	std::copy(inputData.cbegin(),inputData.cend(),buffers.input.begin());
+	buffers.input[inputData.size()] = 1;
+	return RunLayers(buffers);
+}
+
+void QuantizedNeuralNetwork::RunBatch(const std::vector<std::vector<unsigned char>>& inputData,std::vector<unsigned char>& outputs) const
+{
+	if(inputData.empty())
+	{
+		outputs.clear();
+		return;
+	}
+	const unsigned int inputSize = inputData[0].size();
+	CheckInputSize(inputSize);
+	for(const std::vector<unsigned char>& input : inputData)
+	{
+		if(input.size() != inputSize)
+			UnexpectedInputSize();
+	}
+	outputs.resize(inputData.size());
+
+	//Each input is small enough that splitting the inputs themselves between threads is best.
+#pragma omp parallel if(inputData.size() >= MINIMUM_INPUTS_PER_THREAD * 2)
+	{
+		Buffers buffers;
+#pragma omp for
+		for(int x = 0;x < static_cast<int>(inputData.size());x++) //Signed for OpenMP 2.0.
+		{
+			buffers.input.assign(layers[0].stride,0);
+			std::copy(inputData[x].cbegin(),inputData[x].cend(),buffers.input.begin());
+			buffers.input[inputSize] = 1;
+			outputs[x] = RunLayers(buffers);
+		}
+	}
+}
+
+void QuantizedNeuralNetwork::RunBatch(const std::vector<PackedInput>& inputData,const unsigned int inputSize,std::vector<unsigned char>& outputs) const
+{
+	CheckInputSize(inputSize);
+	for(const PackedInput& input : inputData)
+	{
+		if(input.size() < (inputSize + 63) / 64)
+			UnexpectedInputSize();
+	}
+	outputs.resize(inputData.size());
+
+#pragma omp parallel if(inputData.size() >= MINIMUM_INPUTS_PER_THREAD * 2)
+	{
+		Buffers buffers;
+#pragma omp for
+		for(int x = 0;x < static_cast<int>(inputData.size());x++) //Signed for OpenMP 2.0.
+		{
+			buffers.input.assign(layers[0].stride,0);
+			for(unsigned int y = 0;y < inputSize;y++)
+			{
+				buffers.input[y] = (inputData[x][y / 64] >> (y % 64)) & 1;
+			}
+			buffers.input[inputSize] = 1;
+			outputs[x] = RunLayers(buffers);
+		}
+	}
+}
+
+void QuantizedNeuralNetwork::CheckInputSize(const unsigned int size) const
+{
+	if(PaddedSize(size) != inputSize || layers.empty())
+		UnexpectedInputSize();
+}
+
+unsigned char QuantizedNeuralNetwork::RunLayers(Buffers& buffers) const
+{
+	//Input rows end with the bias input and are zero padded to the layer's stride.
+	for(unsigned int x = 0;x + 1 < layers.size();x++)
+	{
+		const Layer& layer = layers[x];
+		buffers.sums.resize(layer.neuronCount);
+		for(unsigned int y = 0;y < layer.neuronCount;y++)
+		{
+			buffers.sums[y] = DotProduct(&layer.weights[y * layer.stride],&buffers.input[0],layer.stride) * layer.scale;
+		}
+		ApplySigmoid(&buffers.sums[0],layer.neuronCount);
+
+		buffers.output.assign(layers[x + 1].stride,0);
+		for(unsigned int y = 0;y < layer.neuronCount;y++)
+		{
+			buffers.output[y] = static_cast<unsigned char>(buffers.sums[y] * ACTIVATION_SCALE + 0.5f);
+		}
+		buffers.output[layer.neuronCount] = static_cast<unsigned char>(ACTIVATION_SCALE);
+		std::swap(buffers.input,buffers.output);
+	}
+
+	//Sigmoid and softmax don't change which output is largest so skip them.
+	const Layer& outputLayer = layers.back();
+	unsigned int choice = 0;
+	int maximumSum = 0;
+	for(unsigned int y = 0;y < outputLayer.neuronCount;y++)
+	{
+		const int sum = DotProduct(&outputLayer.weights[y * outputLayer.stride],&buffers.input[0],outputLayer.stride);
+		if(y == 0 || sum > maximumSum)
+		{
+			choice = y;
+			maximumSum = sum;
+		}
+	}
+
+	return outputChoices[choice];
+}
@@ -0,0 +1,65 @@
+// Copyright 2017 James Bendig. See the COPYRIGHT file at the top-level
+// directory of this distribution.
+//
+// Licensed under:
+//   the MIT license
+//     <LICENSE-MIT or https://opensource.org/licenses/MIT>
+//   or the Apache License, Version 2.0
+//     <LICENSE-APACHE or https://www.apache.org/licenses/LICENSE-2.0>,
+// at your option. This file may not be copied, modified, or distributed
+// except according to those terms.
+
+
+#ifndef QUANTIZEDNEURALNETWORK_H
+#define QUANTIZEDNEURALNETWORK_H
+
+#include <cstddef>
+#include <vector>
+#include "NeuralNetwork.h"
+
+struct NeuralNetworkData;
+
+//8-bit copy of a trained network that's only used for inference. Weights, including the bias
+//weight, are rounded to signed 8-bit integers with one scale per layer. That's about a quarter of
+//the memory of the float weights. Activations between layers are rounded to 0-127 so every
+//multiply-add fits the 8-bit DotProduct() kernels. Inputs must also be at most 127, which binary
+//tiles always are. Hidden layers must use sigmoid so activations have a known range.
+class QuantizedNeuralNetwork
+{
+	public:
+		QuantizedNeuralNetwork();
+
+		static QuantizedNeuralNetwork Quantize(const NeuralNetworkData& data); //Empty if any hidden layer doesn't use sigmoid.
+
+		bool Empty() const;
+		size_t WeightBytes() const;
+		unsigned char Run(const std::vector<unsigned char>& inputData) const;
+		void RunBatch(const std::vector<std::vector<unsigned char>>& inputData,std::vector<unsigned char>& outputs) const; //Same as calling Run() on each input.
+		void RunBatch(const std::vector<PackedInput>& inputData,const unsigned int inputSize,std::vector<unsigned char>& outputs) const; //Binary inputs of inputSize bits each.
+	private:
+		struct Layer
+		{
+			unsigned int neuronCount;
+			unsigned int stride; //Bytes per row of weights. A multiple of 64 padded with zeros.
+			float scale; //Converts a row's DotProduct() to the float network's sum.
+			std::vector<signed char> weights;
+		};
+
+		//Per-thread scratch space for RunLayers().
+		struct Buffers
+		{
+			std::vector<unsigned char> input;
+			std::vector<unsigned char> output;
+			std::vector<float> sums;
+		};
+
+		std::vector<Layer> layers;
+		std::vector<unsigned char> outputChoices;
+		unsigned int inputSize; //Padded input size of the float network.
+
+		void CheckInputSize(const unsigned int size) const;
+		unsigned char RunLayers(Buffers& buffers) const; //buffers.input holds the padded input row.
+};
+
+#endif
+
@@ -0,0 +1,335 @@
+// Copyright 2017 James Bendig. See the COPYRIGHT file at the top-level
+// directory of this distribution.
+//
+// Licensed under:
+//   the MIT license
+//     <LICENSE-MIT or https://opensource.org/licenses/MIT>
+//   or the Apache License, Version 2.0
+//     <LICENSE-APACHE or https://www.apache.org/licenses/LICENSE-2.0>,
+// at your option. This file may not be copied, modified, or distributed
+// except according to those terms.
+
+#include "SolutionCache.h"
+#include <algorithm>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+static unsigned int BitCount(const uint64_t bits)
+{
+#ifdef _MSC_VER
+	return static_cast<unsigned int>(__popcnt64(bits));
+#else
+	return __builtin_popcountll(bits);
+#endif
+}
+
+size_t PuzzleKey::Hasher::operator()(const PuzzleKey& key) const
+{
+	return static_cast<size_t>(key.Hash());
+}
+
+PuzzleKey::PuzzleKey()
+	: words()
+{
+}
+
+PuzzleKey::PuzzleKey(const std::vector<unsigned char>& digits)
+	: words()
+{
+	const unsigned int cellCount = std::min(static_cast<unsigned int>(digits.size()),CELL_COUNT);
+	for(unsigned int x = 0;x < cellCount;x++)
+	{
+		words[x / CELLS_PER_WORD] |= static_cast<uint64_t>(digits[x] & 0xF) << ((x % CELLS_PER_WORD) * 4);
+	}
+}
+
+unsigned char PuzzleKey::Get(const unsigned int index) const
+{
+	return (words[index / CELLS_PER_WORD] >> ((index % CELLS_PER_WORD) * 4)) & 0xF;
+}
+
+void PuzzleKey::Set(const unsigned int index,const unsigned char digit)
+{
+	const unsigned int shift = (index % CELLS_PER_WORD) * 4;
+	uint64_t& word = words[index / CELLS_PER_WORD];
+	word = (word & ~(static_cast<uint64_t>(0xF) << shift)) | (static_cast<uint64_t>(digit & 0xF) << shift);
+}
+
+std::vector<unsigned char> PuzzleKey::Digits() const
+{
+	std::vector<unsigned char> digits(CELL_COUNT);
+	for(unsigned int x = 0;x < CELL_COUNT;x++)
+	{
+		digits[x] = Get(x);
+	}
+
+	return digits;
+}
+
+uint64_t PuzzleKey::Hash() const
+{
+	//Multiply-xorshift mixing of each word. Plenty for a table of at most a few thousand puzzles.
+	uint64_t hash = 0xCBF29CE484222325ULL;
+	for(unsigned int x = 0;x < WORD_COUNT;x++)
+	{
+		hash = (hash ^ words[x]) * 0x9E3779B97F4A7C15ULL;
+		hash ^= hash >> 32;
+	}
+
+	return hash;
+}
+
+uint64_t PuzzleKey::Word(const unsigned int index) const
+{
+	return words[index];
+}
+
+unsigned int PuzzleKey::Distance(const PuzzleKey& rhs) const
+{
+	//Fold each differing nibble down to its lowest bit and count them.
+	constexpr uint64_t LOW_NIBBLE_BITS = 0x1111111111111111ULL;
+	unsigned int distance = 0;
+	for(unsigned int x = 0;x < WORD_COUNT;x++)
+	{
+		uint64_t difference = words[x] ^ rhs.words[x];
+		difference |= difference >> 1;
+		difference |= difference >> 2;
+		distance += BitCount(difference & LOW_NIBBLE_BITS);
+	}
+
+	return distance;
+}
+
+bool PuzzleKey::operator==(const PuzzleKey& rhs) const
+{
+	uint64_t difference = 0;
+	for(unsigned int x = 0;x < WORD_COUNT;x++)
+	{
+		difference |= words[x] ^ rhs.words[x];
+	}
+
+	return difference == 0;
+}
+
+bool PuzzleKey::operator!=(const PuzzleKey& rhs) const
+{
+	return !(*this == rhs);
+}
+
+SolutionCache::SolutionCache(const unsigned int capacity)
+	: entries(std::max(capacity,1u)),
+	  entryHashes(entries.size(),0),
+	  slots(),
+	  slotMask(0),
+	  size(0),
+	  clockHand(0)
+{
+	//Keep the index at most half full so probe sequences stay short.
+	unsigned int slotCount = 1;
+	while(slotCount < entries.size() * 2)
+		slotCount *= 2;
+	slots.assign(slotCount,EMPTY_SLOT);
+	slotMask = slotCount - 1;
+
+	for(Entry& entry : entries)
+	{
+		entry.useCount = 0;
+		entry.referenced = false;
+		entry.occupied = false;
+	}
+}
+
+unsigned int SolutionCache::Capacity() const
+{
+	return entries.size();
+}
+
+unsigned int SolutionCache::Size() const
+{
+	return size;
+}
+
+SolutionCache::Entry* SolutionCache::Find(const PuzzleKey& puzzle)
+{
+	const unsigned int slot = FindSlot(puzzle,puzzle.Hash());
+	if(slots[slot] == EMPTY_SLOT)
+		return nullptr;
+
+	Entry& entry = entries[slots[slot]];
+	entry.referenced = true;
+	return &entry;
+}
+
+SolutionCache::Entry* SolutionCache::FindNearest(const PuzzleKey& puzzle,const unsigned int maximumDistance)
+{
+	//Prefer the closest puzzle and then the one used most recently.
+	Entry* bestEntry = nullptr;
+	unsigned int bestDistance = maximumDistance + 1;
+	auto consider = [&](Entry& entry) {
+		const unsigned int distance = entry.puzzle.Distance(puzzle);
+		if(distance < bestDistance || (distance == bestDistance && bestEntry != nullptr && entry.useCount > bestEntry->useCount))
+		{
+			bestEntry = &entry;
+			bestDistance = distance;
+		}
+	};
+
+	if(maximumDistance < CHUNK_COUNT)
+	{
+		for(unsigned int chunk = 0;chunk < CHUNK_COUNT && bestDistance != 0;chunk++)
+		{
+			const auto range = chunkIndexes[chunk].equal_range(ChunkValue(puzzle,chunk));
+			for(auto iter = range.first;iter != range.second;++iter)
+			{
+				consider(entries[iter->second]);
+			}
+		}
+	}
+	else
+	{
+		//Too many differences for the pigeonhole guarantee. Check everything.
+		for(Entry& entry : entries)
+		{
+			if(entry.occupied)
+				consider(entry);
+		}
+	}
+
+	if(bestEntry != nullptr)
+		bestEntry->referenced = true;
+	return bestEntry;
+}
+
+SolutionCache::Entry* SolutionCache::Insert(const PuzzleKey& puzzle,const PuzzleKey& solution)
+{
+	const uint64_t hash = puzzle.Hash();
+	unsigned int slot = FindSlot(puzzle,hash);
+	if(slots[slot] != EMPTY_SLOT)
+	{
+		Entry& entry = entries[slots[slot]];
+		entry.solution = solution;
+		entry.referenced = true;
+		return &entry;
+	}
+
+	//Entries are only freed by eviction and immediately reused so the free ones are always at the end.
+	unsigned int entryIndex = size;
+	if(size == entries.size())
+	{
+		entryIndex = Evict();
+		if(entryIndex == EMPTY_SLOT)
+			return nullptr;
+
+		//Eviction can shift the slot this puzzle belongs in.
+		slot = FindSlot(puzzle,hash);
+	}
+
+	Entry& entry = entries[entryIndex];
+	entry.puzzle = puzzle;
+	entry.solution = solution;
+	entry.useCount = 0;
+	entry.referenced = true;
+	entry.occupied = true;
+	entryHashes[entryIndex] = hash;
+	slots[slot] = entryIndex;
+	AddChunks(entryIndex);
+	size += 1;
+
+	return &entry;
+}
+
+uint64_t SolutionCache::ChunkValue(const PuzzleKey& puzzle,const unsigned int chunk)
+{
+	//Each chunk is one word of 16 cells except the last word which only holds a single cell. It's
+	//folded into the chunk before it.
+	static_assert(PuzzleKey::CELL_COUNT % PuzzleKey::CELLS_PER_WORD == 1,"Last word is expected to hold one cell.");
+	if(chunk == CHUNK_COUNT - 1)
+		return puzzle.Word(chunk) ^ (puzzle.Word(chunk + 1) * 0x9E3779B97F4A7C15ULL);
+	return puzzle.Word(chunk);
+}
+
+unsigned int SolutionCache::FindSlot(const PuzzleKey& puzzle,const uint64_t hash) const
+{
+	//Returns the slot holding the puzzle or the empty slot where it would be inserted.
+	unsigned int slot = hash & slotMask;
+	while(slots[slot] != EMPTY_SLOT)
+	{
+		const unsigned int entryIndex = slots[slot];
+		if(entryHashes[entryIndex] == hash && entries[entryIndex].puzzle == puzzle)
+			break;
+		slot = (slot + 1) & slotMask;
+	}
+
+	return slot;
+}
+
+unsigned int SolutionCache::Evict()
+{
+	//Two full sweeps are enough to clear every referenced bit. Anything left is pinned.
+	for(unsigned int x = 0;x < entries.size() * 2;x++)
+	{
+		const unsigned int entryIndex = clockHand;
+		clockHand = (clockHand + 1) % entries.size();
+
+		Entry& entry = entries[entryIndex];
+		if(entry.useCount != 0)
+			continue;
+		else if(entry.referenced)
+		{
+			entry.referenced = false;
+			continue;
+		}
+
+		RemoveSlot(FindSlot(entry.puzzle,entryHashes[entryIndex]));
+		RemoveChunks(entryIndex);
+		entry.occupied = false;
+		size -= 1;
+		return entryIndex;
+	}
+
+	return EMPTY_SLOT;
+}
+
+void SolutionCache::RemoveSlot(unsigned int slot)
+{
+	//Backward shift deletion. Pull later entries in the probe sequence into the hole unless that
+	//would move them in front of their home slot.
+	unsigned int next = (slot + 1) & slotMask;
+	while(slots[next] != EMPTY_SLOT)
+	{
+		const unsigned int homeSlot = entryHashes[slots[next]] & slotMask;
+		if(((next - homeSlot) & slotMask) >= ((next - slot) & slotMask))
+		{
+			slots[slot] = slots[next];
+			slot = next;
+		}
+		next = (next + 1) & slotMask;
+	}
+	slots[slot] = EMPTY_SLOT;
+}
+
+void SolutionCache::AddChunks(const unsigned int entryIndex)
+{
+	for(unsigned int chunk = 0;chunk < CHUNK_COUNT;chunk++)
+	{
+		chunkIndexes[chunk].emplace(ChunkValue(entries[entryIndex].puzzle,chunk),entryIndex);
+	}
+}
+
+void SolutionCache::RemoveChunks(const unsigned int entryIndex)
+{
+	for(unsigned int chunk = 0;chunk < CHUNK_COUNT;chunk++)
+	{
+		auto range = chunkIndexes[chunk].equal_range(ChunkValue(entries[entryIndex].puzzle,chunk));
+		for(auto iter = range.first;iter != range.second;++iter)
+		{
+			if(iter->second == entryIndex)
+			{
+				chunkIndexes[chunk].erase(iter);
+				break;
+			}
+		}
+	}
+}
+
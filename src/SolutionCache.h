@@ -0,0 +1,99 @@
+// Copyright 2017 James Bendig. See the COPYRIGHT file at the top-level
+// directory of this distribution.
+//
+// Licensed under:
+//   the MIT license
+//     <LICENSE-MIT or https://opensource.org/licenses/MIT>
+//   or the Apache License, Version 2.0
+//     <LICENSE-APACHE or https://www.apache.org/licenses/LICENSE-2.0>,
+// at your option. This file may not be copied, modified, or distributed
+// except according to those terms.
+
+#ifndef SOLUTIONCACHE_H
+#define SOLUTIONCACHE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+//An 81 cell puzzle packed into 4 bits per cell. Cell n is stored in bits (n % 16) * 4 of word n / 16.
+class PuzzleKey
+{
+	public:
+		static constexpr unsigned int CELL_COUNT = 81;
+		static constexpr unsigned int CELLS_PER_WORD = 16;
+		static constexpr unsigned int WORD_COUNT = (CELL_COUNT + CELLS_PER_WORD - 1) / CELLS_PER_WORD;
+
+		struct Hasher
+		{
+			size_t operator()(const PuzzleKey& key) const;
+		};
+
+		PuzzleKey();
+		explicit PuzzleKey(const std::vector<unsigned char>& digits); //Digits must be 0-9.
+
+		unsigned char Get(const unsigned int index) const;
+		void Set(const unsigned int index,const unsigned char digit);
+		std::vector<unsigned char> Digits() const;
+		uint64_t Hash() const;
+		uint64_t Word(const unsigned int index) const;
+		unsigned int Distance(const PuzzleKey& rhs) const; //Number of cells that differ.
+
+		bool operator==(const PuzzleKey& rhs) const;
+		bool operator!=(const PuzzleKey& rhs) const;
+	private:
+		uint64_t words[WORD_COUNT];
+};
+
+//Fixed-capacity map from puzzle to solution. Lookups use an open-addressing (linear probing) index
+//into a fixed array of entries so entry pointers stay valid until that entry is evicted. When full,
+//entries are evicted using the CLOCK algorithm. Entries with a non-zero use count are never evicted.
+//
+//Near matches are found with multi-index hashing. Each puzzle is split into CHUNK_COUNT chunks and
+//each chunk is indexed separately. Two puzzles differing in fewer than CHUNK_COUNT cells must have
+//at least one identical chunk so only puzzles sharing a chunk need their distance checked.
+class SolutionCache
+{
+	public:
+		struct Entry
+		{
+			PuzzleKey puzzle;
+			PuzzleKey solution;
+			unsigned int useCount; //Pins the entry while non-zero.
+			bool referenced; //Cleared as the CLOCK hand passes, set on each use.
+			bool occupied;
+		};
+
+		static constexpr unsigned int CHUNK_COUNT = PuzzleKey::WORD_COUNT - 1;
+
+		SolutionCache(const unsigned int capacity);
+
+		unsigned int Capacity() const;
+		unsigned int Size() const;
+
+		Entry* Find(const PuzzleKey& puzzle);
+		Entry* FindNearest(const PuzzleKey& puzzle,const unsigned int maximumDistance); //Closest puzzle differing by at most maximumDistance cells.
+		Entry* Insert(const PuzzleKey& puzzle,const PuzzleKey& solution); //Returns nullptr if every entry is pinned.
+	private:
+		static constexpr unsigned int EMPTY_SLOT = ~0u;
+
+		std::vector<Entry> entries;
+		std::vector<uint64_t> entryHashes;
+		std::vector<unsigned int> slots; //Entry index or EMPTY_SLOT. Size is a power of two.
+		std::unordered_multimap<uint64_t,unsigned int> chunkIndexes[CHUNK_COUNT]; //Chunk value to entry index.
+		unsigned int slotMask;
+		unsigned int size;
+		unsigned int clockHand;
+
+		static uint64_t ChunkValue(const PuzzleKey& puzzle,const unsigned int chunk);
+
+		unsigned int FindSlot(const PuzzleKey& puzzle,const uint64_t hash) const;
+		unsigned int Evict();
+		void RemoveSlot(unsigned int slot);
+		void AddChunks(const unsigned int entryIndex);
+		void RemoveChunks(const unsigned int entryIndex);
+};
+
+#endif
+
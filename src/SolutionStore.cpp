@@ -0,0 +1,376 @@
+// Copyright 2017 James Bendig. See the COPYRIGHT file at the top-level
+// directory of this distribution.
+//
+// Licensed under:
+//   the MIT license
+//     <LICENSE-MIT or https://opensource.org/licenses/MIT>
+//   or the Apache License, Version 2.0
+//     <LICENSE-APACHE or https://www.apache.org/licenses/LICENSE-2.0>,
+// at your option. This file may not be copied, modified, or distributed
+// except according to those terms.
+
+
+#include "SolutionStore.h"
+#include <algorithm>
+#include <cstring>
+#include <type_traits>
+#include <vector>
+#ifdef __linux
+#include <fcntl.h>
+#include <sys/file.h>
+#include <unistd.h>
+#elif defined _WIN32
+#include <fcntl.h>
+#include <io.h>
+#include <share.h>
+#include <sys/stat.h>
+#endif
+
+//Records appended since the last compaction are read into memory on open. Past this many, the
+//index is rebuilt instead so the next start is instant again.
+static constexpr unsigned long long COMPACT_RECORD_COUNT = 256;
+
+static constexpr char LOG_MAGIC[8] = {'S','U','D','O','K','L','O','G'};
+static constexpr char INDEX_MAGIC[8] = {'S','U','D','O','K','I','D','X'};
+static constexpr uint32_t FORMAT_VERSION = 1;
+
+namespace
+{
+
+//All values are stored in native byte order. Record hashes come from PuzzleKey::Hash() so changing
+//it requires bumping FORMAT_VERSION.
+struct LogHeader
+{
+	char magic[8];
+	uint32_t version;
+	uint32_t recordSize;
+};
+
+struct Record
+{
+	PuzzleKey puzzle;
+	PuzzleKey solution;
+};
+
+struct IndexHeader
+{
+	char magic[8];
+	uint32_t version;
+	uint32_t reserved;
+	uint64_t recordCount; //Log records covered by the index.
+	uint64_t entryCount; //Less than recordCount when a puzzle was stored more than once.
+};
+
+struct IndexEntry
+{
+	uint64_t hash;
+	uint64_t recordIndex;
+};
+
+static_assert(std::is_trivially_copyable<Record>::value,"Records are copied straight to and from disk.");
+static_assert(sizeof(LogHeader) % alignof(Record) == 0,"Records must stay aligned in the mapped log.");
+static_assert(sizeof(IndexHeader) % alignof(IndexEntry) == 0,"Entries must stay aligned in the mapped index.");
+
+}
+
+static std::string LogPath(const std::string& basePath)
+{
+	return basePath + ".log";
+}
+
+static std::string IndexPath(const std::string& basePath)
+{
+	return basePath + ".idx";
+}
+
+static bool ValidLogHeader(const LogHeader& header)
+{
+	return memcmp(header.magic,LOG_MAGIC,sizeof(LOG_MAGIC)) == 0 &&
+		   header.version == FORMAT_VERSION &&
+		   header.recordSize == sizeof(Record);
+}
+
+//Open the log for writing, creating it if needed, and keep any other process from doing the same
+//until it's closed. Records are written at offsets worked out from the log's size when it was
+//opened so two writers would overwrite each other. Returns nullptr when another process has it.
+static FILE* OpenLogForWriting(const std::string& logPath)
+{
+#ifdef __linux
+	const int fd = open(logPath.c_str(),O_RDWR | O_CREAT | O_CLOEXEC,0644);
+	if(fd < 0)
+		return nullptr;
+	if(flock(fd,LOCK_EX | LOCK_NB) != 0)
+	{
+		close(fd);
+		return nullptr;
+	}
+	FILE* logFile = fdopen(fd,"r+b");
+	if(logFile == nullptr)
+		close(fd);
+	return logFile;
+#elif defined _WIN32
+	//Denying other writers still lets readers map the log.
+	int fd = -1;
+	if(_sopen_s(&fd,logPath.c_str(),_O_RDWR | _O_CREAT | _O_BINARY,_SH_DENYWR,_S_IREAD | _S_IWRITE) != 0)
+		return nullptr;
+	FILE* logFile = _fdopen(fd,"r+b");
+	if(logFile == nullptr)
+		_close(fd);
+	return logFile;
+#else
+#error Platform not supported.
+#endif
+}
+
+static Record ReadRecord(const MappedFile& log,const unsigned long long recordIndex)
+{
+	Record record;
+	memcpy(&record,log.Data() + sizeof(LogHeader) + recordIndex * sizeof(Record),sizeof(Record));
+	return record;
+}
+
+SolutionStore::SolutionStore(SolutionStore&& other)
+	: basePath(std::move(other.basePath)),
+	  readOnly(other.readOnly),
+	  logFile(other.logFile),
+	  log(std::move(other.log)),
+	  index(std::move(other.index)),
+	  recordCount(other.recordCount),
+	  indexedRecordCount(other.indexedRecordCount),
+	  unindexedRecords(std::move(other.unindexedRecords))
+{
+	other.logFile = nullptr;
+}
+
+SolutionStore::~SolutionStore()
+{
+	if(logFile != nullptr)
+		fclose(logFile);
+}
+
+std::optional<SolutionStore> SolutionStore::Open(const std::string& basePath,const bool readOnly)
+{
+	const std::string logPath = LogPath(basePath);
+
+	//Create the log if needed. It's only written once locked so two processes starting at the same
+	//time can't both write a header. An existing file that isn't a log is left alone.
+	FILE* logFile = nullptr;
+	if(!readOnly)
+	{
+		logFile = OpenLogForWriting(logPath);
+		if(logFile == nullptr)
+			return {};
+
+		if(fseek(logFile,0,SEEK_END) != 0)
+		{
+			fclose(logFile);
+			return {};
+		}
+		if(ftell(logFile) == 0)
+		{
+			LogHeader header;
+			memcpy(header.magic,LOG_MAGIC,sizeof(LOG_MAGIC));
+			header.version = FORMAT_VERSION;
+			header.recordSize = sizeof(Record);
+			if(fwrite(&header,sizeof(header),1,logFile) != 1 || fflush(logFile) != 0)
+			{
+				fclose(logFile);
+				return {};
+			}
+		}
+	}
+
+	SolutionStore store(basePath,readOnly,logFile);
+	if(!store.MapLog())
+		return {};
+
+	//An index that doesn't match the log is ignored. Every record is then treated as unindexed
+	//until the next compaction.
+	if(!store.MapIndex())
+	{
+		store.index.reset();
+		store.indexedRecordCount = 0;
+	}
+
+	for(unsigned long long x = store.indexedRecordCount;x < store.recordCount;x++)
+	{
+		const Record record = ReadRecord(*store.log,x);
+		store.unindexedRecords[record.puzzle] = record.solution;
+	}
+
+	if(!readOnly && store.recordCount - store.indexedRecordCount >= COMPACT_RECORD_COUNT)
+		store.Compact();
+
+	return store;
+}
+
+unsigned long long SolutionStore::RecordCount() const
+{
+	return recordCount;
+}
+
+bool SolutionStore::Find(const PuzzleKey& puzzle,PuzzleKey& solution) const
+{
+	auto iter = unindexedRecords.find(puzzle);
+	if(iter != unindexedRecords.end())
+	{
+		solution = iter->second;
+		return true;
+	}
+
+	return FindIndexed(puzzle,solution);
+}
+
+bool SolutionStore::Append(const PuzzleKey& puzzle,const PuzzleKey& solution)
+{
+	if(readOnly)
+		return false;
+
+	//Write at the end of the last complete record. This also overwrites a partial record left
+	//behind if the program was killed while appending.
+	const Record record = {puzzle,solution};
+	const unsigned long long offset = sizeof(LogHeader) + recordCount * sizeof(Record);
+	if(fseek(logFile,static_cast<long>(offset),SEEK_SET) != 0)
+		return false;
+	if(fwrite(&record,sizeof(record),1,logFile) != 1 || fflush(logFile) != 0)
+		return false;
+
+	recordCount += 1;
+	unindexedRecords[puzzle] = solution;
+	return true;
+}
+
+bool SolutionStore::Compact()
+{
+	if(readOnly)
+		return false;
+
+	//Pick up records appended since the log was mapped.
+	if(!MapLog())
+		return false;
+
+	//Only the newest record of each puzzle is indexed.
+	std::unordered_map<PuzzleKey,unsigned long long,PuzzleKey::Hasher> newestRecords;
+	for(unsigned long long x = 0;x < recordCount;x++)
+	{
+		newestRecords[ReadRecord(*log,x).puzzle] = x;
+	}
+
+	std::vector<IndexEntry> entries;
+	entries.reserve(newestRecords.size());
+	for(const auto& newestRecord : newestRecords)
+	{
+		entries.push_back({newestRecord.first.Hash(),newestRecord.second});
+	}
+	std::sort(entries.begin(),entries.end(),[](const IndexEntry& lhs,const IndexEntry& rhs) {
+		return lhs.hash < rhs.hash || (lhs.hash == rhs.hash && lhs.recordIndex < rhs.recordIndex);
+	});
+
+	IndexHeader header;
+	memcpy(header.magic,INDEX_MAGIC,sizeof(INDEX_MAGIC));
+	header.version = FORMAT_VERSION;
+	header.reserved = 0;
+	header.recordCount = recordCount;
+	header.entryCount = entries.size();
+
+	//Write the new index beside the old one and swap it in so readers never see it half written.
+	const std::string indexPath = IndexPath(basePath);
+	const std::string temporaryIndexPath = indexPath + ".tmp";
+	FILE* indexFile = fopen(temporaryIndexPath.c_str(),"wb");
+	if(indexFile == nullptr)
+		return false;
+	bool written = fwrite(&header,sizeof(header),1,indexFile) == 1;
+	if(written && !entries.empty())
+		written = fwrite(&entries[0],sizeof(IndexEntry),entries.size(),indexFile) == entries.size();
+	if(fclose(indexFile) != 0 || !written)
+	{
+		remove(temporaryIndexPath.c_str());
+		return false;
+	}
+
+	index.reset(); //Windows can't replace a mapped file.
+	if(!ReplaceFileAtomically(temporaryIndexPath,indexPath) || !MapIndex())
+	{
+		remove(temporaryIndexPath.c_str());
+		index.reset();
+		indexedRecordCount = 0;
+		return false;
+	}
+
+	unindexedRecords.clear();
+	return true;
+}
+
+SolutionStore::SolutionStore(const std::string& basePath,const bool readOnly,FILE* logFile)
+	: basePath(basePath),
+	  readOnly(readOnly),
+	  logFile(logFile),
+	  log(),
+	  index(),
+	  recordCount(0),
+	  indexedRecordCount(0),
+	  unindexedRecords()
+{
+}
+
+bool SolutionStore::MapLog()
+{
+	log = MappedFile::Open(LogPath(basePath));
+	if(!log || log->Size() < sizeof(LogHeader))
+		return false;
+
+	LogHeader header;
+	memcpy(&header,log->Data(),sizeof(header));
+	if(!ValidLogHeader(header))
+		return false;
+
+	//A trailing partial record is ignored.
+	recordCount = (log->Size() - sizeof(LogHeader)) / sizeof(Record);
+	return true;
+}
+
+bool SolutionStore::MapIndex()
+{
+	index = MappedFile::Open(IndexPath(basePath));
+	if(!index || index->Size() < sizeof(IndexHeader))
+		return false;
+
+	IndexHeader header;
+	memcpy(&header,index->Data(),sizeof(header));
+	if(memcmp(header.magic,INDEX_MAGIC,sizeof(INDEX_MAGIC)) != 0 ||
+	   header.version != FORMAT_VERSION ||
+	   header.recordCount > recordCount ||
+	   header.entryCount > header.recordCount ||
+	   index->Size() != sizeof(IndexHeader) + header.entryCount * sizeof(IndexEntry))
+		return false;
+
+	indexedRecordCount = header.recordCount;
+	return true;
+}
+
+bool SolutionStore::FindIndexed(const PuzzleKey& puzzle,PuzzleKey& solution) const
+{
+	if(!index)
+		return false;
+
+	//Binary search the hashes. Only the pages touched are ever read from disk.
+	const IndexHeader* header = reinterpret_cast<const IndexHeader*>(index->Data());
+	const IndexEntry* begin = reinterpret_cast<const IndexEntry*>(index->Data() + sizeof(IndexHeader));
+	const IndexEntry* end = begin + header->entryCount;
+	const uint64_t hash = puzzle.Hash();
+	const IndexEntry* iter = std::lower_bound(begin,end,hash,[](const IndexEntry& entry,const uint64_t hash) {
+		return entry.hash < hash;
+	});
+	for(;iter != end && iter->hash == hash;++iter)
+	{
+		const Record record = ReadRecord(*log,iter->recordIndex);
+		if(record.puzzle == puzzle)
+		{
+			solution = record.solution;
+			return true;
+		}
+	}
+
+	return false;
+}
+
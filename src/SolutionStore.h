@@ -0,0 +1,60 @@
+// Copyright 2017 James Bendig. See the COPYRIGHT file at the top-level
+// directory of this distribution.
+//
+// Licensed under:
+//   the MIT license
+//     <LICENSE-MIT or https://opensource.org/licenses/MIT>
+//   or the Apache License, Version 2.0
+//     <LICENSE-APACHE or https://www.apache.org/licenses/LICENSE-2.0>,
+// at your option. This file may not be copied, modified, or distributed
+// except according to those terms.
+
+
+#ifndef SOLUTIONSTORE_H
+#define SOLUTIONSTORE_H
+
+#include <cstdio>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include "MappedFile.h"
+#include "SolutionCache.h"
+
+//Solved puzzles kept on disk between runs. Solutions are appended to a log of fixed-size records
+//(<basePath>.log) and found through a sorted index of record hashes (<basePath>.idx). Both files are
+//memory mapped so opening costs nothing beyond reading the records appended since the index was
+//last compacted. Any number of processes can open the store read-only but only one can open it for
+//writing at a time. Open() fails for the others.
+class SolutionStore
+{
+	public:
+		SolutionStore(SolutionStore&& other);
+		~SolutionStore();
+
+		static std::optional<SolutionStore> Open(const std::string& basePath,const bool readOnly);
+
+		unsigned long long RecordCount() const;
+		bool Find(const PuzzleKey& puzzle,PuzzleKey& solution) const;
+		bool Append(const PuzzleKey& puzzle,const PuzzleKey& solution);
+		bool Compact(); //Rebuild the index so it covers every record in the log.
+	private:
+		std::string basePath;
+		bool readOnly;
+		FILE* logFile; //Only open when writable.
+		std::optional<MappedFile> log;
+		std::optional<MappedFile> index;
+		unsigned long long recordCount;
+		unsigned long long indexedRecordCount;
+		std::unordered_map<PuzzleKey,PuzzleKey,PuzzleKey::Hasher> unindexedRecords; //Newer than anything in the index.
+
+		SolutionStore(const std::string& basePath,const bool readOnly,FILE* logFile);
+		bool MapLog();
+		bool MapIndex();
+		bool FindIndexed(const PuzzleKey& puzzle,PuzzleKey& solution) const;
+
+		SolutionStore(const SolutionStore&)=delete;
+		SolutionStore& operator=(SolutionStore&)=delete;
+};
+
+#endif
+
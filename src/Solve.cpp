@@ -11,211 +11,492 @@
 
 #include "Solve.h"
 #include <algorithm>
-#include <iterator>
-#include <limits>
+#include <array>
 #include <cassert>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+//GCC and Clang build the batch solver for both SSE2 and AVX2 and pick one for the CPU at runtime,
+//the same as NeuralNetworkKernels. MSVC always allows SSE2 on x64 so that's used as is.
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h> //SSE2, AVX2
+#define USE_SIMD_BATCH
+#define USE_CPU_DISPATCH
+#define TARGET(features) __attribute__((target(features)))
+#elif defined _M_X64
+#include <emmintrin.h> //SSE2
+#define USE_SIMD_BATCH
+#define TARGET(features)
+#endif
 #include "Game.h"
 
 
 namespace
 {
 
-class DigitSet
+constexpr unsigned int CELL_COUNT = Game::WIDTH * Game::HEIGHT;
+constexpr unsigned int UNIT_SIZE = 9;
+constexpr unsigned int PEER_COUNT = 20; //Other cells sharing a row, column, or block with a cell.
+constexpr unsigned short ALL_DIGITS = 0x1FF; //Bit (digit - 1) is set for each digit in a set.
+
+static_assert(Game::WIDTH == UNIT_SIZE && Game::HEIGHT == UNIT_SIZE && Game::MAX_VALUE == UNIT_SIZE,"Bitboard solver only supports 9x9 puzzles.");
+
+unsigned int BitCount(const unsigned int bits)
 {
-	public:
-		static constexpr unsigned int MAXIMUM_SIZE = 10;
+#ifdef _MSC_VER
+	return __popcnt(bits);
+#else
+	return __builtin_popcount(bits);
+#endif
+}
 
-		class const_iterator
-		{
-			public:
-				const_iterator(const std::array<unsigned char,MAXIMUM_SIZE>& choices,const unsigned int index)
-					: choices(choices),
-					  index(index)
-				{
-					operator++();
-				}
+unsigned int LowestBitIndex(const unsigned int bits)
+{
+	assert(bits != 0);
+#ifdef _MSC_VER
+	unsigned long index = 0;
+	_BitScanForward(&index,bits);
+	return index;
+#else
+	return __builtin_ctz(bits);
+#endif
+}
 
-				const_iterator& operator++()
-				{
-					while(1)
-					{
-						index += 1;
-						if(index >= choices.size() || choices[index] != 0)
-							break;
-					}
+//Lookup tables so the row, column, and block of a cell and the cells making up each unit (row,
+//column, or block) don't have to be recomputed while searching.
+struct Units
+{
+	std::array<unsigned char,CELL_COUNT> cellRow;
+	std::array<unsigned char,CELL_COUNT> cellColumn;
+	std::array<unsigned char,CELL_COUNT> cellBlock;
+	std::array<std::array<unsigned char,UNIT_SIZE>,UNIT_SIZE * 3> unitCells; //Rows, then columns, then blocks.
+	std::array<std::array<unsigned char,PEER_COUNT>,CELL_COUNT> cellPeers;
 
-					return *this;
-				}
+	Units()
+	{
+		std::array<unsigned int,UNIT_SIZE> blockFill = {};
+		for(unsigned int index = 0;index < CELL_COUNT;index++)
+		{
+			const unsigned int x = index % Game::WIDTH;
+			const unsigned int y = index / Game::WIDTH;
+			const unsigned int block = (y / Game::BLOCK_HEIGHT) * (Game::WIDTH / Game::BLOCK_WIDTH) + x / Game::BLOCK_WIDTH;
 
-				bool operator==(const const_iterator& other) const
-				{
-					return index == other.index || (index >= choices.size() && other.index >= choices.size());
-				}
+			cellRow[index] = y;
+			cellColumn[index] = x;
+			cellBlock[index] = block;
 
-				bool operator!=(const const_iterator& other) const
-				{
-					return !operator==(other);
-				}
+			unitCells[y][x] = index;
+			unitCells[UNIT_SIZE + x][y] = index;
+			unitCells[UNIT_SIZE * 2 + block][blockFill[block]++] = index;
+		}
 
-				unsigned char operator*() const
-				{
-					return index;
-				}
-			private:
-				const std::array<unsigned char,MAXIMUM_SIZE>& choices;
-				unsigned int index;
-		};
+		for(unsigned int index = 0;index < CELL_COUNT;index++)
+		{
+			unsigned int peerCount = 0;
+			for(unsigned int other = 0;other < CELL_COUNT;other++)
+			{
+				if(other != index && (cellRow[other] == cellRow[index] || cellColumn[other] == cellColumn[index] || cellBlock[other] == cellBlock[index]))
+					cellPeers[index][peerCount++] = other;
+			}
+			assert(peerCount == PEER_COUNT);
+		}
+	}
+};
+
+const Units UNITS;
 
-		DigitSet()
+//Board state for the constraint propagation search. Each row, column, and block keeps a 9-bit mask
+//of the digits already placed in it so the candidates of a cell are just the complement of the
+//three masks OR'd together. The masks and the list of open cells are updated incrementally as
+//digits are placed.
+class Board
+{
+	public:
+		bool Load(const Game& game)
 		{
-			std::fill(choices.begin(),choices.end(),0);
+			rows.fill(0);
+			columns.fill(0);
+			blocks.fill(0);
+			cells.fill(Game::EMPTY_VALUE);
+			openCount = 0;
+
+			for(unsigned int index = 0;index < CELL_COUNT;index++)
+			{
+				const unsigned char digit = game.Get(index % Game::WIDTH,index / Game::WIDTH);
+				if(digit == Game::EMPTY_VALUE)
+					openCells[openCount++] = index;
+				else if(!Mark(index,digit))
+					return false; //Digit conflicts with another clue.
+			}
+
+			for(unsigned int x = 0;x < openCount;x++)
+			{
+				openPositions[openCells[x]] = x;
+			}
+
+			return true;
 		}
 
-		const_iterator begin() const
+		void Store(Game& game) const
 		{
-			return const_iterator(choices,0);
+			for(unsigned int index = 0;index < CELL_COUNT;index++)
+			{
+				game.Set(index % Game::WIDTH,index / Game::WIDTH,cells[index]);
+			}
 		}
 
-		const_iterator end() const
+		unsigned short Candidates(const unsigned int index) const
 		{
-			return const_iterator(choices,choices.size());
+			return ~(rows[UNITS.cellRow[index]] | columns[UNITS.cellColumn[index]] | blocks[UNITS.cellBlock[index]]) & ALL_DIGITS;
 		}
 
-		void insert(const unsigned char choice)
+		//Place digit into an open cell. Returns false if the digit conflicts with the cell's row,
+		//column, or block.
+		bool Place(const unsigned int index,const unsigned char digit)
 		{
-			assert(choice < choices.size());
-			choices[choice] = 1;
+			if(cells[index] != Game::EMPTY_VALUE || !Mark(index,digit))
+				return false;
+
+			//Remove from the open list by swapping with the last open cell.
+			const unsigned int position = openPositions[index];
+			const unsigned char lastIndex = openCells[--openCount];
+			openCells[position] = lastIndex;
+			openPositions[lastIndex] = position;
+
+			return true;
 		}
 
-		bool contains(const unsigned char choice) const
+		//Repeatedly fill in naked singles (cells with one candidate) and hidden singles (digits
+		//with only one possible cell in a unit) until neither makes progress. Returns false when a
+		//contradiction is found.
+		bool Propagate()
 		{
-			assert(choice < choices.size());
-			return choices[choice] == 1;
+			bool progress = true;
+			while(progress && openCount != 0)
+			{
+				progress = false;
+
+				//Naked singles. Iterate backwards because placing a digit moves the last open cell
+				//into the current position.
+				for(unsigned int x = openCount;x-- > 0;)
+				{
+					const unsigned int index = openCells[x];
+					const unsigned short candidates = Candidates(index);
+					if(candidates == 0)
+						return false;
+					else if((candidates & (candidates - 1)) == 0)
+					{
+						Place(index,LowestBitIndex(candidates) + 1);
+						progress = true;
+					}
+				}
+
+				//Hidden singles.
+				for(unsigned int unit = 0;unit < UNITS.unitCells.size() && openCount != 0;unit++)
+				{
+					const std::array<unsigned char,UNIT_SIZE>& unitCells = UNITS.unitCells[unit];
+					unsigned short atLeastOnce = 0;
+					unsigned short moreThanOnce = 0;
+					unsigned short placed = 0;
+					for(const unsigned char index : unitCells)
+					{
+						if(cells[index] != Game::EMPTY_VALUE)
+						{
+							placed |= 1 << (cells[index] - 1);
+							continue;
+						}
+
+						const unsigned short candidates = Candidates(index);
+						moreThanOnce |= atLeastOnce & candidates;
+						atLeastOnce |= candidates;
+					}
+
+					//Every digit missing from the unit must have somewhere to go.
+					if((atLeastOnce | placed) != ALL_DIGITS)
+						return false;
+
+					unsigned short exactlyOnce = atLeastOnce & ~moreThanOnce;
+					while(exactlyOnce != 0)
+					{
+						const unsigned short digitBit = exactlyOnce & -exactlyOnce;
+						exactlyOnce ^= digitBit;
+
+						for(const unsigned char index : unitCells)
+						{
+							if(cells[index] != Game::EMPTY_VALUE || (Candidates(index) & digitBit) == 0)
+								continue;
+
+							if(!Place(index,LowestBitIndex(digitBit) + 1))
+								return false;
+							progress = true;
+							break;
+						}
+					}
+				}
+			}
+
+			return true;
 		}
 
-		DigitSet complemented() const
+		//Pick the open cell with the fewest candidates. Returns false if there are no open cells.
+		bool MostConstrainedCell(unsigned int& bestIndex,unsigned short& bestCandidates) const
 		{
-			DigitSet complementedDigitSet;
-			for(unsigned int x = 1;x < choices.size();x++)
+			unsigned int bestCount = UNIT_SIZE + 1;
+			for(unsigned int x = 0;x < openCount;x++)
 			{
-				complementedDigitSet.choices[x] = choices[x] ^ 1;
+				const unsigned int index = openCells[x];
+				const unsigned short candidates = Candidates(index);
+				const unsigned int count = BitCount(candidates);
+				if(count < bestCount)
+				{
+					bestIndex = index;
+					bestCandidates = candidates;
+					bestCount = count;
+					if(count <= 2)
+						break; //Can't do better than two after propagation.
+				}
 			}
 
-			return complementedDigitSet;
+			return bestCount <= UNIT_SIZE;
 		}
 	private:
-		std::array<unsigned char,MAXIMUM_SIZE> choices;
+		std::array<unsigned char,CELL_COUNT> cells;
+		std::array<unsigned char,CELL_COUNT> openCells;
+		std::array<unsigned char,CELL_COUNT> openPositions; //Position of each open cell in openCells.
+		unsigned int openCount;
+		std::array<unsigned short,UNIT_SIZE> rows;
+		std::array<unsigned short,UNIT_SIZE> columns;
+		std::array<unsigned short,UNIT_SIZE> blocks;
+
+		bool Mark(const unsigned int index,const unsigned char digit)
+		{
+			const unsigned short digitBit = 1 << (digit - 1);
+			unsigned short& row = rows[UNITS.cellRow[index]];
+			unsigned short& column = columns[UNITS.cellColumn[index]];
+			unsigned short& block = blocks[UNITS.cellBlock[index]];
+			if(((row | column | block) & digitBit) != 0)
+				return false;
+
+			row |= digitBit;
+			column |= digitBit;
+			block |= digitBit;
+			cells[index] = digit;
+
+			return true;
+		}
 };
 
+#ifdef USE_SIMD_BATCH
+//Candidate masks for the same cell of several puzzles packed into one register, one 16-bit lane
+//per puzzle. SolveLanes.h builds the batch solver out of these for each instruction set.
+namespace SSE2
+{
+
+#define LANE_TARGET TARGET("sse2")
+using Lanes = __m128i;
+constexpr unsigned int LANE_COUNT = 8;
+
+LANE_TARGET Lanes LoadLanes(const unsigned short* values) { return _mm_loadu_si128(reinterpret_cast<const Lanes*>(values)); }
+LANE_TARGET void StoreLanes(unsigned short* values,const Lanes lanes) { _mm_storeu_si128(reinterpret_cast<Lanes*>(values),lanes); }
+LANE_TARGET Lanes SetLanes(const unsigned short value) { return _mm_set1_epi16(value); }
+LANE_TARGET Lanes And(const Lanes a,const Lanes b) { return _mm_and_si128(a,b); }
+LANE_TARGET Lanes AndNot(const Lanes a,const Lanes b) { return _mm_andnot_si128(a,b); } //~a & b
+LANE_TARGET Lanes Or(const Lanes a,const Lanes b) { return _mm_or_si128(a,b); }
+LANE_TARGET Lanes Xor(const Lanes a,const Lanes b) { return _mm_xor_si128(a,b); }
+LANE_TARGET Lanes Subtract(const Lanes a,const Lanes b) { return _mm_sub_epi16(a,b); }
+LANE_TARGET Lanes Equal(const Lanes a,const Lanes b) { return _mm_cmpeq_epi16(a,b); }
+LANE_TARGET bool AllZero(const Lanes a) { return _mm_movemask_epi8(_mm_cmpeq_epi8(a,_mm_setzero_si128())) == 0xFFFF; }
+
+#include "SolveLanes.h"
+#undef LANE_TARGET
+
 }
 
-static void UnavailableRowChoices(const Game& game,const unsigned int y,DigitSet& unavailableChoices)
+#ifdef USE_CPU_DISPATCH
+namespace AVX2
 {
-	for(unsigned int x = 0;x < Game::WIDTH;x++)
-	{
-		unavailableChoices.insert(game.Get(x,y));
-	}
+
+#define LANE_TARGET TARGET("avx2")
+using Lanes = __m256i;
+constexpr unsigned int LANE_COUNT = 16;
+
+LANE_TARGET Lanes LoadLanes(const unsigned short* values) { return _mm256_loadu_si256(reinterpret_cast<const Lanes*>(values)); }
+LANE_TARGET void StoreLanes(unsigned short* values,const Lanes lanes) { _mm256_storeu_si256(reinterpret_cast<Lanes*>(values),lanes); }
+LANE_TARGET Lanes SetLanes(const unsigned short value) { return _mm256_set1_epi16(value); }
+LANE_TARGET Lanes And(const Lanes a,const Lanes b) { return _mm256_and_si256(a,b); }
+LANE_TARGET Lanes AndNot(const Lanes a,const Lanes b) { return _mm256_andnot_si256(a,b); } //~a & b
+LANE_TARGET Lanes Or(const Lanes a,const Lanes b) { return _mm256_or_si256(a,b); }
+LANE_TARGET Lanes Xor(const Lanes a,const Lanes b) { return _mm256_xor_si256(a,b); }
+LANE_TARGET Lanes Subtract(const Lanes a,const Lanes b) { return _mm256_sub_epi16(a,b); }
+LANE_TARGET Lanes Equal(const Lanes a,const Lanes b) { return _mm256_cmpeq_epi16(a,b); }
+LANE_TARGET bool AllZero(const Lanes a) { return _mm256_testz_si256(a,a) != 0; }
+
+#include "SolveLanes.h"
+#undef LANE_TARGET
+
 }
+#endif
+#endif
 
-static void UnavailableColumnChoices(const Game& game,const unsigned int x,DigitSet& unavailableChoices)
+}
+
+//Depth-first search that stops once limit solutions have been found or the budget runs out. The
+//first solution found is stored in game. Returns true when the search should stop.
+static bool Search(Board& board,Game& game,const unsigned int limit,SolveBudget& budget,unsigned int& solutionCount)
 {
-	for(unsigned int y = 0;y < Game::HEIGHT;y++)
+	if(!budget.Spend())
+		return true;
+	else if(!board.Propagate())
+		return false;
+
+	//Branch on the cell with the fewest choices to keep the search tree small.
+	unsigned int index = 0;
+	unsigned short candidates = 0;
+	if(!board.MostConstrainedCell(index,candidates))
 	{
-		unavailableChoices.insert(game.Get(x,y));
+		//No open positions remaining, puzzle is solved.
+		if(solutionCount == 0)
+			board.Store(game);
+		solutionCount += 1;
+		return solutionCount >= limit;
 	}
-}
 
-static void UnavailableBlockChoices(const Game& game,const unsigned int x,const unsigned int y,DigitSet& unavailableChoices)
-{
-	const unsigned int blockStartX = (x / Game::BLOCK_WIDTH) * Game::BLOCK_WIDTH;
-	const unsigned int blockStartY = (y / Game::BLOCK_HEIGHT) * Game::BLOCK_HEIGHT;
-	for(unsigned int y = 0;y < Game::BLOCK_HEIGHT;y++)
+	while(candidates != 0)
 	{
-		for(unsigned int x = 0;x < Game::BLOCK_WIDTH;x++)
-		{
-			unavailableChoices.insert(game.Get(blockStartX + x,blockStartY + y));
-		}
+		const unsigned short digitBit = candidates & -candidates;
+		candidates ^= digitBit;
+
+		//Try this digit on a copy so backtracking is free.
+		Board nextBoard = board;
+		nextBoard.Place(index,LowestBitIndex(digitBit) + 1);
+		if(Search(nextBoard,game,limit,budget,solutionCount))
+			return true;
 	}
+
+	return false;
 }
 
-static DigitSet AvailableChoices(const Game& game,const unsigned int x,const unsigned int y)
+SolveBudget::SolveBudget()
+	: cancelled(nullptr),
+	  maximumNodes(0),
+	  nodeCount(0),
+	  deadline(),
+	  hasDeadline(false),
+	  exhausted(false)
 {
-	DigitSet unavailableChoices;
-	UnavailableRowChoices(game,y,unavailableChoices);
-	UnavailableColumnChoices(game,x,unavailableChoices);
-	UnavailableBlockChoices(game,x,y,unavailableChoices);
+}
+
+void SolveBudget::SetCancelFlag(const std::atomic<bool>* cancelled)
+{
+	this->cancelled = cancelled;
+}
 
-	return unavailableChoices.complemented();
+void SolveBudget::SetMaximumNodes(const unsigned long long maximumNodes)
+{
+	this->maximumNodes = maximumNodes;
+}
+
+void SolveBudget::SetMaximumTime(const std::chrono::steady_clock::duration maximumTime)
+{
+	deadline = std::chrono::steady_clock::now() + maximumTime;
+	hasDeadline = true;
 }
 
-static bool NextOpenPosition(const Game& game,const unsigned int lastX,const unsigned int lastY,unsigned int& nextX,unsigned int& nextY)
+unsigned long long SolveBudget::NodeCount() const
 {
-	for(unsigned int index = lastY * Game::WIDTH + lastX + 1;index < (Game::WIDTH * Game::HEIGHT);index++)
+	return nodeCount;
+}
+
+bool SolveBudget::Exhausted() const
+{
+	return exhausted;
+}
+
+bool SolveBudget::Spend()
+{
+	//The cancel flag and clock are only checked every so often because a search node takes well
+	//under a microsecond.
+	constexpr unsigned long long CHECK_INTERVAL = 256;
+
+	if(exhausted)
+		return false;
+
+	nodeCount += 1;
+	if(maximumNodes != 0 && nodeCount > maximumNodes)
+		exhausted = true;
+	else if((nodeCount % CHECK_INTERVAL) == 0)
 	{
-		nextX = index % Game::WIDTH;
-		nextY = index / Game::HEIGHT;
-		if(game.Get(nextX,nextY) == Game::EMPTY_VALUE)
-			return true;
+		if(cancelled != nullptr && cancelled->load(std::memory_order_relaxed))
+			exhausted = true;
+		else if(hasDeadline && std::chrono::steady_clock::now() >= deadline)
+			exhausted = true;
 	}
 
-	return false;
+	return !exhausted;
 }
 
 bool Solvable(Game game)
 {
-	for(unsigned int y = 0; y < Game::HEIGHT;y++)
-	{
-		for(unsigned int x = 0;x < Game::WIDTH;x++)
-		{
-			const unsigned char digit = game.Get(x,y);
-			if(digit == 0)
-				continue;
+	Board board;
+	return board.Load(game);
+}
 
-			game.Set(x,y,0);
-			const DigitSet choices = AvailableChoices(game,x,y);
-			if(!choices.contains(digit))
-				return false;
-			game.Set(x,y,digit);
-		}
-	}
+bool Solve(Game& game)
+{
+	SolveBudget budget;
+	return Solve(game,budget);
+}
 
-	return true;
+bool Solve(Game& game,SolveBudget& budget)
+{
+	return CountSolutions(game,1,budget) == 1;
 }
 
-static bool SolveNext(Game& game,const unsigned int lastX,const unsigned int lastY)
+unsigned int CountSolutions(Game& game,const unsigned int limit)
 {
-	//Find the next position in the puzzle without a digit.
-	unsigned int positionX = 0;
-	unsigned int positionY = 0;
-	if(!NextOpenPosition(game,lastX,lastY,positionX,positionY))
-		return true; //No open positions, already solved?
+	SolveBudget budget;
+	return CountSolutions(game,limit,budget);
+}
 
-	//Get the set of possible digits for this position.
-	const DigitSet availableChoices = AvailableChoices(game,positionX,positionY);
-	for(const unsigned char choice : availableChoices)
-	{
-		//Try this digit.
-		game.Set(positionX,positionY,choice);
+unsigned int CountSolutions(Game& game,const unsigned int limit,SolveBudget& budget)
+{
+	Board board;
+	if(limit == 0 || !board.Load(game))
+		return 0;
+
+	//Recursively search for solutions in depth-first order.
+	unsigned int solutionCount = 0;
+	Search(board,game,limit,budget,solutionCount);
+	return solutionCount;
+}
 
-		//Recursively keep searching at the next open position.
-		if(SolveNext(game,positionX,positionY))
-			return true;
+static void SolveBatchScalar(Game* games,bool* solved,const unsigned int count)
+{
+	for(unsigned int x = 0;x < count;x++)
+	{
+		solved[x] = Solve(games[x]);
 	}
+}
 
-	//None of the attempted digits for this position were correct, clear it before backtracking so
-	//it doesn't incorrectly influence other paths.
-	game.Set(positionX,positionY,Game::EMPTY_VALUE);
+using SolveBatchFunction = void (*)(Game*,bool*,const unsigned int);
 
-	return false;
+static SolveBatchFunction SelectSolveBatch()
+{
+#ifdef USE_CPU_DISPATCH
+	__builtin_cpu_init();
+	if(__builtin_cpu_supports("avx2"))
+		return AVX2::SolveBatchLanes;
+	else if(__builtin_cpu_supports("sse2"))
+		return SSE2::SolveBatchLanes;
+#elif defined(USE_SIMD_BATCH)
+	return SSE2::SolveBatchLanes;
+#endif
+	return SolveBatchScalar;
 }
 
-bool Solve(Game& game)
-{
-	//Use an overflow to start solving at (0,0).
-	const unsigned int lastX = std::numeric_limits<unsigned int>::max();
-	const unsigned int lastY = 0;
+static const SolveBatchFunction solveBatch = SelectSolveBatch();
 
-	//Recursively search for a solution in depth-first order.
-	return SolveNext(game,lastX,lastY);
+void SolveBatch(Game* games,bool* solved,const unsigned int count)
+{
+	solveBatch(games,solved,count);
 }
-
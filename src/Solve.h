@@ -12,10 +12,49 @@
 #ifndef SOLVE_H
 #define SOLVE_H
 
+#include <atomic>
+#include <chrono>
+
 class Game;
 
+//Limits how much work a solve is allowed to do. A search that is cancelled or runs out of nodes or
+//time gives up early. Exhausted() tells that apart from a puzzle that has no solution.
+class SolveBudget
+{
+	public:
+		SolveBudget();
+
+		void SetCancelFlag(const std::atomic<bool>* cancelled); //Give up once *cancelled is true.
+		void SetMaximumNodes(const unsigned long long maximumNodes);
+		void SetMaximumTime(const std::chrono::steady_clock::duration maximumTime); //Measured from this call.
+
+		unsigned long long NodeCount() const;
+		bool Exhausted() const;
+
+		//Called by the solver for every search node. Returns false once the budget is used up.
+		bool Spend();
+	private:
+		const std::atomic<bool>* cancelled;
+		unsigned long long maximumNodes;
+		unsigned long long nodeCount;
+		std::chrono::steady_clock::time_point deadline;
+		bool hasDeadline;
+		bool exhausted;
+};
+
 bool Solvable(Game game);
 bool Solve(Game& game);
+bool Solve(Game& game,SolveBudget& budget);
+
+//Count solutions, stopping as soon as limit is reached. CountSolutions(game,2) == 1 means the
+//puzzle has exactly one solution. If any solution is found, game is replaced by the first one.
+unsigned int CountSolutions(Game& game,const unsigned int limit);
+unsigned int CountSolutions(Game& game,const unsigned int limit,SolveBudget& budget);
+
+//Solve many puzzles at once. Groups of puzzles are propagated together in SIMD lanes and only the
+//puzzles that still need a guess fall back to Solve(). solved[x] is set for each games[x]. Groups
+//are 16 puzzles with AVX2 or 8 with SSE2, whichever the CPU supports, picked at startup.
+void SolveBatch(Game* games,bool* solved,const unsigned int count);
 
 #endif
 
@@ -0,0 +1,195 @@
+// Copyright 2017 James Bendig. See the COPYRIGHT file at the top-level
+// directory of this distribution.
+//
+// Licensed under:
+//   the MIT license
+//     <LICENSE-MIT or https://opensource.org/licenses/MIT>
+//   or the Apache License, Version 2.0
+//     <LICENSE-APACHE or https://www.apache.org/licenses/LICENSE-2.0>,
+// at your option. This file may not be copied, modified, or distributed
+// except according to those terms.
+
+
+//The batch solver in SolveBatch(), written once for every instruction set it's built for. Solve.cpp
+//includes this inside a namespace after defining, for that instruction set, Lanes, LANE_COUNT, the
+//lane operations (LoadLanes(), And(), ...) and LANE_TARGET, the target attribute every function
+//here needs so the lane operations can be inlined into it. Not a normal header so there is no
+//include guard.
+
+using LaneMasks = std::array<std::array<unsigned short,LANE_COUNT>,CELL_COUNT>;
+
+//Constraint propagation on LANE_COUNT puzzles in lockstep. Every cell holds a candidate mask and a
+//solved cell is just a mask with one bit set. There is no branching per puzzle, every lane runs
+//the same instructions until none of them make progress.
+class LaneBoard
+{
+	public:
+		LANE_TARGET void Load(const Game* games,const unsigned int count)
+		{
+			//Unused lanes repeat the first puzzle and are ignored when storing.
+			LaneMasks masks;
+			for(unsigned int lane = 0;lane < LANE_COUNT;lane++)
+			{
+				const Game& game = games[lane < count ? lane : 0];
+				for(unsigned int index = 0;index < CELL_COUNT;index++)
+				{
+					const unsigned char digit = game.Get(index % Game::WIDTH,index / Game::WIDTH);
+					masks[index][lane] = digit == Game::EMPTY_VALUE ? ALL_DIGITS : 1 << (digit - 1);
+				}
+			}
+
+			for(unsigned int index = 0;index < CELL_COUNT;index++)
+			{
+				cells[index] = LoadLanes(&masks[index][0]);
+			}
+		}
+
+		//Run naked and hidden singles until no lane changes. Returns a mask of the lanes that hit
+		//a contradiction.
+		LANE_TARGET Lanes Propagate()
+		{
+			const Lanes zero = SetLanes(0);
+			const Lanes one = SetLanes(1);
+			const Lanes allDigits = SetLanes(ALL_DIGITS);
+
+			Lanes contradiction = zero;
+			while(1)
+			{
+				Lanes changed = zero;
+
+				//Naked singles: remove the digit of every solved cell from its peers.
+				for(unsigned int index = 0;index < CELL_COUNT;index++)
+				{
+					const Lanes mask = cells[index];
+					const Lanes single = Equal(And(mask,Subtract(mask,one)),zero);
+					const Lanes eliminate = And(mask,single);
+					if(AllZero(eliminate))
+						continue;
+
+					for(const unsigned char peer : UNITS.cellPeers[index])
+					{
+						const Lanes before = cells[peer];
+						const Lanes after = AndNot(eliminate,before);
+						changed = Or(changed,Xor(before,after));
+						cells[peer] = after;
+					}
+				}
+
+				//Hidden singles: a digit that fits in only one cell of a unit must go there.
+				contradiction = zero;
+				for(const std::array<unsigned char,UNIT_SIZE>& unitCells : UNITS.unitCells)
+				{
+					Lanes atLeastOnce = zero;
+					Lanes moreThanOnce = zero;
+					for(const unsigned char index : unitCells)
+					{
+						moreThanOnce = Or(moreThanOnce,And(atLeastOnce,cells[index]));
+						atLeastOnce = Or(atLeastOnce,cells[index]);
+					}
+					contradiction = Or(contradiction,AndNot(Equal(atLeastOnce,allDigits),SetLanes(0xFFFF)));
+
+					const Lanes exactlyOnce = AndNot(moreThanOnce,atLeastOnce);
+					if(AllZero(exactlyOnce))
+						continue;
+
+					for(const unsigned char index : unitCells)
+					{
+						const Lanes before = cells[index];
+						const Lanes hidden = And(before,exactlyOnce);
+						const Lanes hasHidden = AndNot(Equal(hidden,zero),SetLanes(0xFFFF));
+						const Lanes after = Or(And(hasHidden,hidden),AndNot(hasHidden,before));
+						changed = Or(changed,Xor(before,after));
+						cells[index] = after;
+					}
+				}
+
+				if(AllZero(changed))
+					break;
+			}
+
+			//A cell with no candidates left is also a contradiction.
+			for(unsigned int index = 0;index < CELL_COUNT;index++)
+			{
+				contradiction = Or(contradiction,Equal(cells[index],zero));
+			}
+
+			return contradiction;
+		}
+
+		LANE_TARGET void Store(LaneMasks& masks) const
+		{
+			for(unsigned int index = 0;index < CELL_COUNT;index++)
+			{
+				StoreLanes(&masks[index][0],cells[index]);
+			}
+		}
+	private:
+		Lanes cells[CELL_COUNT]; //Plain array because std::array drops the vector type's alignment attributes.
+};
+
+//Copy a lane back into a game. Cells with more than one candidate are left as they were. Returns
+//true if every cell was solved.
+LANE_TARGET bool StoreLane(const LaneMasks& masks,const unsigned int lane,Game& game)
+{
+	bool complete = true;
+	for(unsigned int index = 0;index < CELL_COUNT;index++)
+	{
+		const unsigned short mask = masks[index][lane];
+		if((mask & (mask - 1)) == 0)
+			game.Set(index % Game::WIDTH,index / Game::WIDTH,LowestBitIndex(mask) + 1);
+		else
+			complete = false;
+	}
+
+	return complete;
+}
+
+LANE_TARGET void SolveBatchLanes(Game* games,bool* solved,const unsigned int count)
+{
+	for(unsigned int start = 0;start < count;start += LANE_COUNT)
+	{
+		const unsigned int laneCount = std::min(count - start,LANE_COUNT);
+
+		//Puzzles with conflicting clues would confuse the propagation so handle them up front.
+		bool allValid = true;
+		for(unsigned int lane = 0;lane < laneCount;lane++)
+		{
+			allValid = allValid && Solvable(games[start + lane]);
+		}
+		if(!allValid)
+		{
+			for(unsigned int lane = 0;lane < laneCount;lane++)
+			{
+				solved[start + lane] = Solve(games[start + lane]);
+			}
+			continue;
+		}
+
+		LaneBoard laneBoard;
+		laneBoard.Load(&games[start],laneCount);
+		std::array<unsigned short,LANE_COUNT> contradictions;
+		StoreLanes(&contradictions[0],laneBoard.Propagate());
+		LaneMasks masks;
+		laneBoard.Store(masks);
+
+		for(unsigned int lane = 0;lane < laneCount;lane++)
+		{
+			Game& game = games[start + lane];
+			if(contradictions[lane] != 0)
+			{
+				solved[start + lane] = false;
+				continue;
+			}
+
+			//Anything propagation couldn't finish is searched from the partially solved puzzle.
+			Game partialGame = game;
+			if(StoreLane(masks,lane,partialGame) || Solve(partialGame))
+			{
+				game = partialGame;
+				solved[start + lane] = true;
+			}
+			else
+				solved[start + lane] = false;
+		}
+	}
+}
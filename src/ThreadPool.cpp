@@ -0,0 +1,148 @@
+// Copyright 2017 James Bendig. See the COPYRIGHT file at the top-level
+// directory of this distribution.
+//
+// Licensed under:
+//   the MIT license
+//     <LICENSE-MIT or https://opensource.org/licenses/MIT>
+//   or the Apache License, Version 2.0
+//     <LICENSE-APACHE or https://www.apache.org/licenses/LICENSE-2.0>,
+// at your option. This file may not be copied, modified, or distributed
+// except according to those terms.
+
+#include "ThreadPool.h"
+#include <algorithm>
+
+ThreadPool::ThreadPool(const unsigned int threadCount)
+	: queuedCount(0),
+	  unfinishedCount(0),
+	  nextQueue(0),
+	  stopping(false)
+{
+	const unsigned int workerCount = std::max(threadCount,1u);
+	for(unsigned int x = 0;x < workerCount;x++)
+	{
+		queues.emplace_back(new TaskQueue);
+	}
+	for(unsigned int x = 0;x < workerCount;x++)
+	{
+		threads.emplace_back(&ThreadPool::Work,this,x);
+	}
+}
+
+ThreadPool::~ThreadPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+	}
+	workAvailable.notify_all();
+
+	for(std::thread& thread : threads)
+	{
+		thread.join();
+	}
+}
+
+unsigned int ThreadPool::HardwareThreadCount()
+{
+	return std::max(std::thread::hardware_concurrency(),1u);
+}
+
+unsigned int ThreadPool::ThreadCount() const
+{
+	return threads.size();
+}
+
+void ThreadPool::Submit(std::function<void()> task)
+{
+	//Spread tasks across the queues round-robin. Counting the task before it's visible in a queue
+	//means a worker might briefly look for a task that isn't there yet but never sleeps through one.
+	unsigned int queueIndex = 0;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		queueIndex = nextQueue;
+		nextQueue = (nextQueue + 1) % queues.size();
+		unfinishedCount += 1;
+		queuedCount += 1;
+	}
+
+	{
+		TaskQueue& queue = *queues[queueIndex];
+		std::lock_guard<std::mutex> lock(queue.mutex);
+		queue.tasks.push_back(std::move(task));
+	}
+	workAvailable.notify_one();
+}
+
+void ThreadPool::Wait()
+{
+	std::unique_lock<std::mutex> lock(mutex);
+	workFinished.wait(lock,[this]() {
+		return unfinishedCount == 0;
+	});
+}
+
+bool ThreadPool::PopTask(const unsigned int queueIndex,std::function<void()>& task)
+{
+	//Take the oldest task from our own queue first.
+	{
+		TaskQueue& queue = *queues[queueIndex];
+		std::lock_guard<std::mutex> lock(queue.mutex);
+		if(!queue.tasks.empty())
+		{
+			task = std::move(queue.tasks.front());
+			queue.tasks.pop_front();
+			return true;
+		}
+	}
+
+	//Otherwise steal the newest task from another worker.
+	for(unsigned int x = 1;x < queues.size();x++)
+	{
+		TaskQueue& queue = *queues[(queueIndex + x) % queues.size()];
+		std::lock_guard<std::mutex> lock(queue.mutex);
+		if(!queue.tasks.empty())
+		{
+			task = std::move(queue.tasks.back());
+			queue.tasks.pop_back();
+			return true;
+		}
+	}
+
+	return false;
+}
+
+void ThreadPool::Work(const unsigned int queueIndex)
+{
+	std::function<void()> task;
+	while(1)
+	{
+		if(PopTask(queueIndex,task))
+		{
+			queuedCount -= 1;
+			task();
+			task = nullptr;
+
+			std::lock_guard<std::mutex> lock(mutex);
+			unfinishedCount -= 1;
+			if(unfinishedCount == 0)
+				workFinished.notify_all();
+			continue;
+		}
+
+		std::unique_lock<std::mutex> lock(mutex);
+		if(queuedCount != 0)
+		{
+			//A task was counted but hasn't been pushed yet.
+			lock.unlock();
+			std::this_thread::yield();
+			continue;
+		}
+		else if(stopping)
+			break;
+
+		workAvailable.wait(lock,[this]() {
+			return stopping || queuedCount != 0;
+		});
+	}
+}
@@ -0,0 +1,62 @@
+// Copyright 2017 James Bendig. See the COPYRIGHT file at the top-level
+// directory of this distribution.
+//
+// Licensed under:
+//   the MIT license
+//     <LICENSE-MIT or https://opensource.org/licenses/MIT>
+//   or the Apache License, Version 2.0
+//     <LICENSE-APACHE or https://www.apache.org/licenses/LICENSE-2.0>,
+// at your option. This file may not be copied, modified, or distributed
+// except according to those terms.
+
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+//Long-lived pool of worker threads. Each worker has its own task queue and steals from the back of
+//the other queues when its own runs dry so uneven tasks still keep every core busy.
+class ThreadPool
+{
+	public:
+		ThreadPool(const unsigned int threadCount);
+		~ThreadPool();
+
+		static unsigned int HardwareThreadCount();
+
+		unsigned int ThreadCount() const;
+		void Submit(std::function<void()> task);
+		void Wait(); //Block until every submitted task has finished.
+	private:
+		struct TaskQueue
+		{
+			std::mutex mutex;
+			std::deque<std::function<void()>> tasks;
+		};
+
+		std::vector<std::unique_ptr<TaskQueue>> queues;
+		std::vector<std::thread> threads;
+		std::mutex mutex;
+		std::condition_variable workAvailable;
+		std::condition_variable workFinished;
+		std::atomic<unsigned int> queuedCount;
+		unsigned int unfinishedCount;
+		unsigned int nextQueue;
+		bool stopping;
+
+		bool PopTask(const unsigned int queueIndex,std::function<void()>& task);
+		void Work(const unsigned int queueIndex);
+
+		ThreadPool(const ThreadPool&)=delete;
+		ThreadPool& operator=(ThreadPool&)=delete;
+};
+
+#endif
+
@@ -0,0 +1,290 @@
+// Copyright 2017 James Bendig. See the COPYRIGHT file at the top-level
+// directory of this distribution.
+//
+// Licensed under:
+//   the MIT license
+//     <LICENSE-MIT or https://opensource.org/licenses/MIT>
+//   or the Apache License, Version 2.0
+//     <LICENSE-APACHE or https://www.apache.org/licenses/LICENSE-2.0>,
+// at your option. This file may not be copied, modified, or distributed
+// except according to those terms.
+
+
+#include "TrainingCheckpoint.h"
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include "MappedFile.h"
+
+//Checkpoint layout. Everything is little-endian.
+//  char magic[8], uint32_t version, byteOrder, inputSize, layerCount, outputChoiceCount, optimizer,
+//  stepCount, firstMomentCount, secondMomentCount
+//  unsigned char outputChoices[outputChoiceCount]
+//  Each layer's uint32_t neuronCount, stride and activation followed by its weights.
+//  Each layer's first moments if firstMomentCount is layerCount, then the same for second moments.
+static const char CHECKPOINT_MAGIC[8] = {'S','U','D','O','K','N','N','C'};
+static constexpr uint32_t CHECKPOINT_VERSION = 1;
+static constexpr uint32_t CHECKPOINT_BYTE_ORDER = 0x01020304;
+
+static void AppendBytes(std::vector<unsigned char>& file,const void* data,const size_t size)
+{
+	const unsigned char* bytes = reinterpret_cast<const unsigned char*>(data);
+	file.insert(file.end(),bytes,bytes + size);
+}
+
+static void AppendValue(std::vector<unsigned char>& file,const uint32_t value)
+{
+	AppendBytes(file,&value,sizeof(value));
+}
+
+static bool ReadBytes(const std::vector<unsigned char>& file,size_t& offset,void* data,const size_t size)
+{
+	if(size > file.size() - offset)
+		return false;
+
+	memcpy(data,&file[offset],size);
+	offset += size;
+	return true;
+}
+
+static bool ReadValue(const std::vector<unsigned char>& file,size_t& offset,uint32_t& value)
+{
+	return ReadBytes(file,offset,&value,sizeof(value));
+}
+
+static bool ReadMoments(const std::vector<unsigned char>& file,size_t& offset,const uint32_t count,const Layers& layers,std::vector<AlignedVector>& moments)
+{
+	moments.clear();
+	if(count == 0)
+		return true;
+	else if(count != layers.size())
+		return false;
+
+	for(const Layer& layer : layers)
+	{
+		moments.push_back(AlignedVector(layer.weights.size(),0.0f));
+		if(!ReadBytes(file,offset,&moments.back()[0],layer.weights.size() * sizeof(float)))
+			return false;
+	}
+
+	return true;
+}
+
+TrainingCheckpoint::TrainingCheckpoint()
+	: inputSize(0),
+	  outputChoices(),
+	  layers(),
+	  optimizer(0),
+	  stepCount(0),
+	  firstMoments(),
+	  secondMoments()
+{
+}
+
+TrainingCheckpoint::TrainingCheckpoint(const NeuralNetworkData& data)
+	: inputSize(data.inputSize),
+	  outputChoices(data.outputChoices),
+	  layers(),
+	  optimizer(0),
+	  stepCount(0),
+	  firstMoments(),
+	  secondMoments()
+{
+	for(const Layer& dataLayer : data.layers)
+	{
+		Layer layer(dataLayer.neuronCount,dataLayer.stride,dataLayer.activation);
+		memcpy(&layer.weights[0],dataLayer.Weights(),layer.weights.size() * sizeof(float));
+		layers.push_back(std::move(layer));
+	}
+}
+
+bool TrainingCheckpoint::Matches(const NeuralNetworkData& data) const
+{
+	if(inputSize != data.inputSize || outputChoices != data.outputChoices || layers.size() != data.layers.size())
+		return false;
+
+	for(unsigned int x = 0;x < layers.size();x++)
+	{
+		if(layers[x].neuronCount != data.layers[x].neuronCount || layers[x].stride != data.layers[x].stride)
+			return false;
+	}
+
+	return true;
+}
+
+void TrainingCheckpoint::RestoreWeights(NeuralNetworkData& data) const
+{
+	for(unsigned int x = 0;x < layers.size();x++)
+	{
+		data.layers[x].weights = layers[x].weights;
+		data.layers[x].activation = layers[x].activation;
+	}
+}
+
+void TrainingCheckpoint::Save(const std::string& filePath) const
+{
+	std::vector<unsigned char> file;
+	AppendBytes(file,CHECKPOINT_MAGIC,sizeof(CHECKPOINT_MAGIC));
+	AppendValue(file,CHECKPOINT_VERSION);
+	AppendValue(file,CHECKPOINT_BYTE_ORDER);
+	AppendValue(file,inputSize);
+	AppendValue(file,layers.size());
+	AppendValue(file,outputChoices.size());
+	AppendValue(file,optimizer);
+	AppendValue(file,stepCount);
+	AppendValue(file,firstMoments.size());
+	AppendValue(file,secondMoments.size());
+	AppendBytes(file,outputChoices.data(),outputChoices.size());
+	for(const Layer& layer : layers)
+	{
+		AppendValue(file,layer.neuronCount);
+		AppendValue(file,layer.stride);
+		AppendValue(file,static_cast<uint32_t>(layer.activation));
+		AppendBytes(file,&layer.weights[0],layer.weights.size() * sizeof(float));
+	}
+	for(const std::vector<AlignedVector>* moments : {&firstMoments,&secondMoments})
+	{
+		for(const AlignedVector& moment : *moments)
+		{
+			AppendBytes(file,&moment[0],moment.size() * sizeof(float));
+		}
+	}
+
+	//Write next to the destination and swap it in so a crash never leaves a half written checkpoint.
+	const std::string temporaryPath = filePath + ".tmp";
+	{
+		std::ofstream outFile(temporaryPath,std::ios::binary | std::ios::trunc);
+		outFile.write(reinterpret_cast<const char*>(&file[0]),file.size());
+		if(!outFile)
+		{
+			std::cerr << "Could not save training checkpoint." << std::endl;
+			return;
+		}
+	}
+	if(!ReplaceFileAtomically(temporaryPath,filePath))
+		std::cerr << "Could not replace training checkpoint." << std::endl;
+}
+
+bool TrainingCheckpoint::Load(const std::string& filePath)
+{
+	*this = TrainingCheckpoint();
+
+	std::ifstream inFile(filePath,std::ios::binary);
+	if(!inFile)
+		return false;
+	const std::vector<unsigned char> file((std::istreambuf_iterator<char>(inFile)),std::istreambuf_iterator<char>());
+
+	size_t offset = 0;
+	char magic[8];
+	uint32_t version = 0;
+	uint32_t byteOrder = 0;
+	uint32_t layerCount = 0;
+	uint32_t outputChoiceCount = 0;
+	uint32_t firstMomentCount = 0;
+	uint32_t secondMomentCount = 0;
+	if(!ReadBytes(file,offset,magic,sizeof(magic)) || memcmp(magic,CHECKPOINT_MAGIC,sizeof(magic)) != 0 ||
+	   !ReadValue(file,offset,version) || version != CHECKPOINT_VERSION ||
+	   !ReadValue(file,offset,byteOrder) || byteOrder != CHECKPOINT_BYTE_ORDER ||
+	   !ReadValue(file,offset,inputSize) || !ReadValue(file,offset,layerCount) || !ReadValue(file,offset,outputChoiceCount) ||
+	   !ReadValue(file,offset,optimizer) || !ReadValue(file,offset,stepCount) ||
+	   !ReadValue(file,offset,firstMomentCount) || !ReadValue(file,offset,secondMomentCount))
+	{
+		std::cerr << "Training checkpoint is not supported." << std::endl;
+		return false;
+	}
+
+	outputChoices.resize(outputChoiceCount);
+	if(!ReadBytes(file,offset,outputChoices.data(),outputChoiceCount))
+		return false;
+
+	//Each layer must be fed exactly what the layer before produces.
+	unsigned int expectedStride = inputSize;
+	for(unsigned int x = 0;x < layerCount;x++)
+	{
+		uint32_t neuronCount = 0;
+		uint32_t stride = 0;
+		uint32_t activation = 0;
+		if(!ReadValue(file,offset,neuronCount) || !ReadValue(file,offset,stride) || !ReadValue(file,offset,activation) ||
+		   stride != expectedStride || static_cast<uint64_t>(neuronCount) * stride * sizeof(float) > file.size() - offset)
+		{
+			std::cerr << "Training checkpoint has an invalid layer." << std::endl;
+			return false;
+		}
+
+		Layer layer(neuronCount,stride,static_cast<Activation>(activation));
+		ReadBytes(file,offset,&layer.weights[0],layer.weights.size() * sizeof(float));
+		layers.push_back(std::move(layer));
+		expectedStride = PaddedSize(neuronCount);
+	}
+
+	if(!ReadMoments(file,offset,firstMomentCount,layers,firstMoments) || !ReadMoments(file,offset,secondMomentCount,layers,secondMoments) || offset != file.size())
+	{
+		std::cerr << "Training checkpoint is truncated." << std::endl;
+		return false;
+	}
+
+	return true;
+}
+
+CheckpointWriter::CheckpointWriter(const std::string& filePath)
+	: filePath(filePath),
+	  pending(),
+	  writing(false),
+	  stopping(false),
+	  thread(&CheckpointWriter::Work,this)
+{
+}
+
+CheckpointWriter::~CheckpointWriter()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+	}
+	changed.notify_all();
+	thread.join();
+}
+
+void CheckpointWriter::Write(TrainingCheckpoint&& checkpoint)
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		pending = std::move(checkpoint);
+	}
+	changed.notify_all();
+}
+
+void CheckpointWriter::Flush()
+{
+	std::unique_lock<std::mutex> lock(mutex);
+	changed.wait(lock,[this]() {
+		return !pending && !writing;
+	});
+}
+
+void CheckpointWriter::Work()
+{
+	std::unique_lock<std::mutex> lock(mutex);
+	while(1)
+	{
+		changed.wait(lock,[this]() {
+			return stopping || pending;
+		});
+		if(!pending)
+			break;
+
+		TrainingCheckpoint checkpoint = std::move(*pending);
+		pending.reset();
+		writing = true;
+		lock.unlock();
+
+		checkpoint.Save(filePath);
+
+		lock.lock();
+		writing = false;
+		changed.notify_all();
+	}
+}
+
@@ -0,0 +1,75 @@
+// Copyright 2017 James Bendig. See the COPYRIGHT file at the top-level
+// directory of this distribution.
+//
+// Licensed under:
+//   the MIT license
+//     <LICENSE-MIT or https://opensource.org/licenses/MIT>
+//   or the Apache License, Version 2.0
+//     <LICENSE-APACHE or https://www.apache.org/licenses/LICENSE-2.0>,
+// at your option. This file may not be copied, modified, or distributed
+// except according to those terms.
+
+
+#ifndef TRAININGCHECKPOINT_H
+#define TRAININGCHECKPOINT_H
+
+#include <condition_variable>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+#include "AlignedVector.h"
+#include "NeuralNetworkData.h"
+
+//Everything needed to resume training except the training samples, which never change. Saving
+//writes each array in one go next to the destination and then renames it into place.
+struct TrainingCheckpoint
+{
+	unsigned int inputSize;
+	std::vector<unsigned char> outputChoices;
+	Layers layers;
+
+	//Optimizer state. Trainers without any leave the moments empty.
+	unsigned int optimizer;
+	unsigned int stepCount;
+	std::vector<AlignedVector> firstMoments; //Same layout as each layer's weights.
+	std::vector<AlignedVector> secondMoments;
+
+	TrainingCheckpoint();
+	explicit TrainingCheckpoint(const NeuralNetworkData& data); //Copies the weights only.
+
+	bool Matches(const NeuralNetworkData& data) const; //Same inputs, outputs and layer sizes.
+	void RestoreWeights(NeuralNetworkData& data) const; //Data must match.
+
+	void Save(const std::string& filePath) const;
+	bool Load(const std::string& filePath);
+};
+
+//Saves checkpoints on a background thread so training never waits on the disk. Only the newest
+//checkpoint matters so one that's still waiting when another arrives is replaced.
+class CheckpointWriter
+{
+	public:
+		CheckpointWriter(const std::string& filePath);
+		~CheckpointWriter(); //Finishes writing the last checkpoint handed over.
+
+		void Write(TrainingCheckpoint&& checkpoint);
+		void Flush(); //Block until every checkpoint handed over is saved.
+	private:
+		std::string filePath;
+		std::mutex mutex;
+		std::condition_variable changed;
+		std::optional<TrainingCheckpoint> pending;
+		bool writing;
+		bool stopping;
+		std::thread thread;
+
+		void Work();
+
+		CheckpointWriter(const CheckpointWriter&)=delete;
+		CheckpointWriter& operator=(CheckpointWriter&)=delete;
+};
+
+#endif
+
@@ -0,0 +1,108 @@
+// Copyright 2017 James Bendig. See the COPYRIGHT file at the top-level
+// directory of this distribution.
+//
+// Licensed under:
+//   the MIT license
+//     <LICENSE-MIT or https://opensource.org/licenses/MIT>
+//   or the Apache License, Version 2.0
+//     <LICENSE-APACHE or https://www.apache.org/licenses/LICENSE-2.0>,
+// at your option. This file may not be copied, modified, or distributed
+// except according to those terms.
+
+
+#include "TrainingSampleQueue.h"
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+TrainingSampleQueue::TrainingSampleQueue(const unsigned int sampleSize,const unsigned int capacity)
+	: inputs(sampleSize * std::max(capacity,2u)),
+	  labels(std::max(capacity,2u)),
+	  randomNumberGenerator(std::random_device()()),
+	  sampleSize(sampleSize),
+	  capacity(std::max(capacity,2u)),
+	  head(0),
+	  size(0),
+	  closed(false)
+{
+}
+
+unsigned int TrainingSampleQueue::SampleSize() const
+{
+	return sampleSize;
+}
+
+bool TrainingSampleQueue::Push(const std::vector<unsigned char>& input,const unsigned char label)
+{
+	if(input.size() != sampleSize)
+	{
+		std::cerr << "TrainingSampleQueue::Push(): Got unexpected input data size." << std::endl;
+		std::abort();
+	}
+
+	std::unique_lock<std::mutex> lock(mutex);
+	spaceAvailable.wait(lock,[this]() {
+		return closed || size < capacity;
+	});
+	if(closed)
+		return false;
+
+	const unsigned int slot = (head + size) % capacity;
+	std::copy(input.cbegin(),input.cend(),&inputs[slot * sampleSize]);
+	labels[slot] = label;
+	size += 1;
+
+	if(size >= capacity / 2)
+		samplesAvailable.notify_one();
+	return true;
+}
+
+bool TrainingSampleQueue::PopRandom(const unsigned int count,std::vector<unsigned char>& inputs,std::vector<unsigned char>& labels)
+{
+	if(count > capacity / 2)
+	{
+		std::cerr << "TrainingSampleQueue::PopRandom(): Asked for more than half the capacity." << std::endl;
+		std::abort();
+	}
+
+	std::unique_lock<std::mutex> lock(mutex);
+	samplesAvailable.wait(lock,[this]() {
+		return closed || size >= capacity / 2;
+	});
+	if(closed)
+		return false;
+
+	//Take a random sample and fill its slot with the oldest one so the queued samples stay
+	//contiguous.
+	const unsigned int inputStart = inputs.size();
+	inputs.resize(inputStart + count * sampleSize);
+	for(unsigned int x = 0;x < count;x++)
+	{
+		std::uniform_int_distribution<unsigned int> indexDist(0,size - 1);
+		const unsigned int slot = (head + indexDist(randomNumberGenerator)) % capacity;
+		memcpy(&inputs[inputStart + x * sampleSize],&this->inputs[slot * sampleSize],sampleSize);
+		labels.push_back(this->labels[slot]);
+
+		if(slot != head)
+		{
+			memcpy(&this->inputs[slot * sampleSize],&this->inputs[head * sampleSize],sampleSize);
+			this->labels[slot] = this->labels[head];
+		}
+		head = (head + 1) % capacity;
+		size -= 1;
+	}
+
+	spaceAvailable.notify_one();
+	return true;
+}
+
+void TrainingSampleQueue::Close()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		closed = true;
+	}
+	spaceAvailable.notify_all();
+	samplesAvailable.notify_all();
+}
@@ -0,0 +1,58 @@
+// Copyright 2017 James Bendig. See the COPYRIGHT file at the top-level
+// directory of this distribution.
+//
+// Licensed under:
+//   the MIT license
+//     <LICENSE-MIT or https://opensource.org/licenses/MIT>
+//   or the Apache License, Version 2.0
+//     <LICENSE-APACHE or https://www.apache.org/licenses/LICENSE-2.0>,
+// at your option. This file may not be copied, modified, or distributed
+// except according to those terms.
+
+
+#ifndef TRAININGSAMPLEQUEUE_H
+#define TRAININGSAMPLEQUEUE_H
+
+#include <condition_variable>
+#include <mutex>
+#include <random>
+#include <vector>
+
+//Bounded ring buffer of labelled byte samples passed from the thread generating them to the thread
+//training on them. The producer blocks while it's full so memory use never grows. Samples are
+//taken out in random order once it's at least half full so samples generated together, like the
+//tiles of one rendered puzzle, get spread across many batches.
+class TrainingSampleQueue
+{
+	public:
+		TrainingSampleQueue(const unsigned int sampleSize,const unsigned int capacity);
+
+		unsigned int SampleSize() const;
+
+		//Blocks while the queue is full. Returns false once the queue is closed.
+		bool Push(const std::vector<unsigned char>& input,const unsigned char label);
+
+		//Appends count samples to inputs, back to back, and their labels to labels. Blocks until
+		//enough are queued. Returns false if the queue is closed first. count must be at most half
+		//the capacity.
+		bool PopRandom(const unsigned int count,std::vector<unsigned char>& inputs,std::vector<unsigned char>& labels);
+
+		void Close(); //Fails every waiting and future Push() and PopRandom().
+	private:
+		std::mutex mutex;
+		std::condition_variable spaceAvailable;
+		std::condition_variable samplesAvailable;
+		std::vector<unsigned char> inputs; //capacity samples of sampleSize bytes.
+		std::vector<unsigned char> labels;
+		std::mt19937 randomNumberGenerator;
+		unsigned int sampleSize;
+		unsigned int capacity;
+		unsigned int head;
+		unsigned int size;
+		bool closed;
+
+		TrainingSampleQueue(const TrainingSampleQueue&)=delete;
+		TrainingSampleQueue& operator=(TrainingSampleQueue&)=delete;
+};
+
+#endif
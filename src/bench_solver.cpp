@@ -0,0 +1,269 @@
+// Copyright 2017 James Bendig. See the COPYRIGHT file at the top-level
+// directory of this distribution.
+//
+// Licensed under:
+//   the MIT license
+//     <LICENSE-MIT or https://opensource.org/licenses/MIT>
+//   or the Apache License, Version 2.0
+//     <LICENSE-APACHE or https://www.apache.org/licenses/LICENSE-2.0>,
+// at your option. This file may not be copied, modified, or distributed
+// except according to those terms.
+
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+#include "Game.h"
+#include "PuzzleGenerator.h"
+#include "Solve.h"
+
+static constexpr unsigned int DEFAULT_PUZZLE_COUNT = 200; //Per difficulty.
+static constexpr unsigned int DEFAULT_SEED = 1;
+static constexpr unsigned int MINIMUM_CLUE_COUNT = 17; //Remove as many clues as possible.
+static constexpr unsigned int MAXIMUM_GENERATE_ATTEMPTS = 10000;
+static constexpr unsigned int BATCH_SIZE = 16; //Puzzles handed to SolveBatch() at once.
+
+using Clock = std::chrono::steady_clock;
+
+struct Measurement
+{
+	double microseconds;
+	unsigned long long nodeCount;
+};
+
+//An engine solves puzzles[0..count) and returns one measurement per puzzle. Engines that can't count
+//nodes report zero.
+struct Engine
+{
+	const char* name;
+	bool countsNodes;
+	std::function<void(const std::vector<GeneratedPuzzle>&,std::vector<Measurement>&)> run;
+};
+
+static double ElapsedMicroseconds(const Clock::time_point startTime)
+{
+	return std::chrono::duration<double,std::micro>(Clock::now() - startTime).count();
+}
+
+static void RunSolve(const std::vector<GeneratedPuzzle>& puzzles,std::vector<Measurement>& measurements)
+{
+	for(const GeneratedPuzzle& generatedPuzzle : puzzles)
+	{
+		Game game = generatedPuzzle.puzzle;
+		SolveBudget budget;
+		const Clock::time_point startTime = Clock::now();
+		Solve(game,budget);
+		measurements.push_back({ElapsedMicroseconds(startTime),budget.NodeCount()});
+	}
+}
+
+static void RunCountSolutions(const std::vector<GeneratedPuzzle>& puzzles,std::vector<Measurement>& measurements)
+{
+	for(const GeneratedPuzzle& generatedPuzzle : puzzles)
+	{
+		Game game = generatedPuzzle.puzzle;
+		SolveBudget budget;
+		const Clock::time_point startTime = Clock::now();
+		CountSolutions(game,2,budget);
+		measurements.push_back({ElapsedMicroseconds(startTime),budget.NodeCount()});
+	}
+}
+
+static void RunSolveBatch(const std::vector<GeneratedPuzzle>& puzzles,std::vector<Measurement>& measurements)
+{
+	//Puzzles in a batch finish together so each gets an equal share of the batch's time.
+	Game games[BATCH_SIZE];
+	bool solved[BATCH_SIZE];
+	for(size_t batchStart = 0;batchStart < puzzles.size();batchStart += BATCH_SIZE)
+	{
+		const unsigned int batchSize = std::min<size_t>(BATCH_SIZE,puzzles.size() - batchStart);
+		for(unsigned int x = 0;x < batchSize;x++)
+		{
+			games[x] = puzzles[batchStart + x].puzzle;
+		}
+
+		const Clock::time_point startTime = Clock::now();
+		SolveBatch(games,solved,batchSize);
+		const double microseconds = ElapsedMicroseconds(startTime) / batchSize;
+		for(unsigned int x = 0;x < batchSize;x++)
+		{
+			measurements.push_back({microseconds,0});
+		}
+	}
+}
+
+static bool Verify(const std::vector<GeneratedPuzzle>& puzzles)
+{
+	//Make sure every engine is actually producing the right answer before timing it.
+	std::vector<Game> games;
+	for(const GeneratedPuzzle& generatedPuzzle : puzzles)
+	{
+		games.push_back(generatedPuzzle.puzzle);
+	}
+	std::unique_ptr<bool[]> solved(new bool[games.size()]);
+	SolveBatch(&games[0],&solved[0],games.size());
+
+	for(size_t x = 0;x < puzzles.size();x++)
+	{
+		Game game = puzzles[x].puzzle;
+		if(!Solve(game) || !solved[x])
+			return false;
+
+		for(unsigned int y = 0;y < Game::WIDTH * Game::HEIGHT;y++)
+		{
+			const unsigned int cellX = y % Game::WIDTH;
+			const unsigned int cellY = y / Game::WIDTH;
+			const unsigned char digit = puzzles[x].solution.Get(cellX,cellY);
+			if(game.Get(cellX,cellY) != digit || games[x].Get(cellX,cellY) != digit)
+				return false;
+		}
+	}
+
+	return true;
+}
+
+static double Percentile(const std::vector<double>& sortedValues,const double percentile)
+{
+	const size_t index = std::min<size_t>(sortedValues.size() * percentile,sortedValues.size() - 1);
+	return sortedValues[index];
+}
+
+static void PrintResults(const char* difficultyName,const Engine& engine,const std::vector<Measurement>& measurements)
+{
+	std::vector<double> microseconds;
+	unsigned long long totalNodeCount = 0;
+	unsigned long long maximumNodeCount = 0;
+	for(const Measurement& measurement : measurements)
+	{
+		microseconds.push_back(measurement.microseconds);
+		totalNodeCount += measurement.nodeCount;
+		maximumNodeCount = std::max(maximumNodeCount,measurement.nodeCount);
+	}
+	std::sort(microseconds.begin(),microseconds.end());
+
+	std::cout << std::left << std::setw(10) << difficultyName << std::setw(16) << engine.name << std::right
+			  << std::setw(8) << measurements.size() << std::fixed << std::setprecision(1)
+			  << std::setw(10) << Percentile(microseconds,0.5)
+			  << std::setw(10) << Percentile(microseconds,0.9)
+			  << std::setw(10) << Percentile(microseconds,0.99)
+			  << std::setw(10) << microseconds.back();
+	if(engine.countsNodes)
+		std::cout << std::setw(12) << static_cast<double>(totalNodeCount) / measurements.size() << std::setw(12) << maximumNodeCount;
+	else
+		std::cout << std::setw(12) << "-" << std::setw(12) << "-";
+	std::cout << std::endl;
+}
+
+static bool WriteCorpus(const char* filePath,const std::vector<GeneratedPuzzle> (&corpus)[PUZZLE_DIFFICULTY_COUNT])
+{
+	//Same format sudoku_solver --batch reads.
+	FILE* file = fopen(filePath,"wb");
+	if(file == nullptr)
+		return false;
+
+	for(unsigned int difficulty = 0;difficulty < PUZZLE_DIFFICULTY_COUNT;difficulty++)
+	{
+		fprintf(file,"# %s\n",PuzzleDifficultyName(static_cast<PuzzleDifficulty>(difficulty)));
+		for(const GeneratedPuzzle& generatedPuzzle : corpus[difficulty])
+		{
+			char line[Game::WIDTH * Game::HEIGHT + 1];
+			for(unsigned int x = 0;x < Game::WIDTH * Game::HEIGHT;x++)
+			{
+				const unsigned char digit = generatedPuzzle.puzzle.Get(x % Game::WIDTH,x / Game::WIDTH);
+				line[x] = digit == Game::EMPTY_VALUE ? '.' : '0' + digit;
+			}
+			line[Game::WIDTH * Game::HEIGHT] = '\n';
+			fwrite(line,1,sizeof(line),file);
+		}
+	}
+
+	return fclose(file) == 0;
+}
+
+int main(int argc,char* argv[])
+{
+	unsigned int puzzleCount = DEFAULT_PUZZLE_COUNT;
+	unsigned int seed = DEFAULT_SEED;
+	const char* corpusFilePath = nullptr;
+	for(int x = 1;x < argc;x++)
+	{
+		if(strcmp(argv[x],"--count") == 0 && x + 1 < argc)
+			puzzleCount = std::max(atoi(argv[++x]),1);
+		else if(strcmp(argv[x],"--seed") == 0 && x + 1 < argc)
+			seed = atoi(argv[++x]);
+		else if(strcmp(argv[x],"--write") == 0 && x + 1 < argc)
+			corpusFilePath = argv[++x];
+		else
+		{
+			std::cerr << "Usage: bench_solver [--count <puzzles per difficulty>] [--seed <seed>] [--write <corpus file>]" << std::endl;
+			return 0;
+		}
+	}
+
+	//Build the same corpus every run for a given seed so results can be compared across changes.
+	std::vector<GeneratedPuzzle> corpus[PUZZLE_DIFFICULTY_COUNT];
+	PuzzleGenerator generator(seed);
+	const Clock::time_point generateStartTime = Clock::now();
+	for(unsigned int difficulty = 0;difficulty < PUZZLE_DIFFICULTY_COUNT;difficulty++)
+	{
+		while(corpus[difficulty].size() < puzzleCount)
+		{
+			GeneratedPuzzle generatedPuzzle;
+			if(!generator.Generate(MINIMUM_CLUE_COUNT,static_cast<PuzzleDifficulty>(difficulty),MAXIMUM_GENERATE_ATTEMPTS,generatedPuzzle))
+			{
+				std::cerr << "Could not generate " << PuzzleDifficultyName(static_cast<PuzzleDifficulty>(difficulty)) << " puzzles." << std::endl;
+				return -1;
+			}
+			corpus[difficulty].push_back(generatedPuzzle);
+		}
+	}
+	std::cerr << "Generated " << puzzleCount * PUZZLE_DIFFICULTY_COUNT << " puzzles in " << ElapsedMicroseconds(generateStartTime) / 1000000.0 << " sec(s)" << std::endl;
+
+	if(corpusFilePath != nullptr && !WriteCorpus(corpusFilePath,corpus))
+	{
+		std::cerr << "Could not write corpus." << std::endl;
+		return -1;
+	}
+
+	const Engine engines[] = {
+		{"Solve",true,RunSolve},
+		{"CountSolutions",true,RunCountSolutions},
+		{"SolveBatch",false,RunSolveBatch},
+	};
+
+	std::cout << std::left << std::setw(10) << "level" << std::setw(16) << "engine" << std::right
+			  << std::setw(8) << "puzzles" << std::setw(10) << "p50 us" << std::setw(10) << "p90 us"
+			  << std::setw(10) << "p99 us" << std::setw(10) << "max us" << std::setw(12) << "mean nodes"
+			  << std::setw(12) << "max nodes" << std::endl;
+	for(unsigned int difficulty = 0;difficulty < PUZZLE_DIFFICULTY_COUNT;difficulty++)
+	{
+		const std::vector<GeneratedPuzzle>& puzzles = corpus[difficulty];
+		if(!Verify(puzzles))
+		{
+			std::cerr << "Wrong solution for a " << PuzzleDifficultyName(static_cast<PuzzleDifficulty>(difficulty)) << " puzzle." << std::endl;
+			return -1;
+		}
+
+		for(const Engine& engine : engines)
+		{
+			//Run once to warm up caches and branch predictors and then again to measure.
+			std::vector<Measurement> measurements;
+			engine.run(puzzles,measurements);
+			measurements.clear();
+			engine.run(puzzles,measurements);
+
+			PrintResults(PuzzleDifficultyName(static_cast<PuzzleDifficulty>(difficulty)),engine,measurements);
+		}
+	}
+
+	return 0;
+}
+
@@ -9,10 +9,21 @@
 // at your option. This file may not be copied, modified, or distributed
 // except according to those terms.
 
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
 #include <fstream>
 #include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
 #include "Game.h"
 #include "Solve.h"
+#include "ThreadPool.h"
+
+static constexpr unsigned int BATCH_CHUNK_SIZE = 256; //Puzzles solved per pool task.
+static const char* const INVALID_LINE = "invalid"; //Written for malformed lines and unsolvable puzzles.
 
 static unsigned char AsciiToUChar(const char input)
 {
@@ -47,14 +58,143 @@ static bool LoadFromFile(const char* filePath,Game& game)
 	return true;
 }
 
+static bool ReadAll(const char* filePath,std::string& contents)
+{
+	//Read everything at once. Stream extraction is far slower than the solver for large batches.
+	FILE* file = strcmp(filePath,"-") == 0 ? stdin : fopen(filePath,"rb");
+	if(file == nullptr)
+	{
+		std::cerr << "Could not open file." << std::endl;
+		return false;
+	}
+
+	char buffer[1 << 16];
+	size_t readSize = 0;
+	while((readSize = fread(buffer,1,sizeof(buffer),file)) > 0)
+	{
+		contents.append(buffer,readSize);
+	}
+
+	const bool failed = ferror(file) != 0;
+	if(file != stdin)
+		fclose(file);
+	return !failed;
+}
+
+static void ParseBatch(const std::string& contents,std::vector<Game>& games,std::vector<bool>& malformed)
+{
+	//One puzzle per line as 81 characters in row-major order. Anything other than 1-9 is an empty
+	//cell so both '0' and '.' style puzzles work. Blank lines and lines starting with '#' are
+	//skipped. Shorter lines still get a slot, flagged as malformed, so output line N always
+	//belongs to puzzle N.
+	const unsigned int cellCount = Game::WIDTH * Game::HEIGHT;
+	size_t lineStart = 0;
+	while(lineStart < contents.size())
+	{
+		size_t lineEnd = contents.find('\n',lineStart);
+		if(lineEnd == std::string::npos)
+			lineEnd = contents.size();
+
+		const char* line = &contents[lineStart];
+		size_t lineSize = lineEnd - lineStart;
+		if(lineSize > 0 && line[lineSize - 1] == '\r')
+			lineSize--;
+		if(lineSize > 0 && line[0] != '#')
+		{
+			games.emplace_back();
+			malformed.push_back(lineSize < cellCount);
+			if(lineSize >= cellCount)
+			{
+				Game& game = games.back();
+				for(unsigned int x = 0;x < cellCount;x++)
+				{
+					game.Set(x % Game::WIDTH,x / Game::WIDTH,AsciiToUChar(line[x]));
+				}
+			}
+		}
+
+		lineStart = lineEnd + 1;
+	}
+}
+
+static int SolveBatchFile(const char* filePath)
+{
+	std::string contents;
+	if(!ReadAll(filePath,contents))
+		return -1;
+
+	std::vector<Game> games;
+	std::vector<bool> malformed;
+	ParseBatch(contents,games,malformed);
+	contents.clear();
+	contents.shrink_to_fit();
+
+	//Solve chunks of puzzles across every core. The results are written back in place so output
+	//order matches input order no matter which worker finished first.
+	std::unique_ptr<bool[]> solved(new bool[games.size()]);
+	const auto startTime = std::chrono::steady_clock::now();
+	{
+		ThreadPool threadPool(ThreadPool::HardwareThreadCount());
+		for(size_t chunkStart = 0;chunkStart < games.size();chunkStart += BATCH_CHUNK_SIZE)
+		{
+			const size_t chunkEnd = std::min(chunkStart + BATCH_CHUNK_SIZE,games.size());
+			threadPool.Submit([&games,&solved,chunkStart,chunkEnd]() {
+				SolveBatch(&games[chunkStart],&solved[chunkStart],chunkEnd - chunkStart);
+			});
+		}
+		threadPool.Wait();
+	}
+	const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - startTime;
+
+	//Write solutions in a single block, one line per puzzle. Malformed lines and puzzles without a
+	//solution get INVALID_LINE instead so output line N still matches input puzzle N.
+	const unsigned int cellCount = Game::WIDTH * Game::HEIGHT;
+	std::string output;
+	output.reserve(games.size() * (cellCount + 1));
+	size_t malformedCount = 0;
+	size_t unsolvedCount = 0;
+	for(size_t x = 0;x < games.size();x++)
+	{
+		if(malformed[x] || !solved[x])
+		{
+			malformedCount += malformed[x] ? 1 : 0;
+			unsolvedCount += malformed[x] ? 0 : 1;
+			output += INVALID_LINE;
+			output += '\n';
+			continue;
+		}
+
+		for(unsigned int y = 0;y < cellCount;y++)
+		{
+			const unsigned char digit = games[x].Get(y % Game::WIDTH,y / Game::WIDTH);
+			output += digit == Game::EMPTY_VALUE ? '.' : '0' + digit;
+		}
+		output += '\n';
+	}
+	fwrite(output.data(),1,output.size(),stdout);
+	fflush(stdout);
+
+	const size_t solvedCount = games.size() - malformedCount - unsolvedCount;
+	std::cerr << "Solved " << solvedCount << " of " << games.size() << " puzzles in " << elapsed.count() << " sec(s) ("
+			  << (elapsed.count() > 0.0 ? games.size() / elapsed.count() : 0.0) << " puzzles/sec)" << std::endl;
+	if(malformedCount > 0 || unsolvedCount > 0)
+		std::cerr << malformedCount << " malformed line(s) and " << unsolvedCount << " unsolvable puzzle(s) written as \"" << INVALID_LINE << "\"" << std::endl;
+
+	return solvedCount == games.size() ? 0 : -1;
+}
+
 int main(int argc,char* argv[])
 {
-	if(argc < 2)
+	if(argc < 2 || (strcmp(argv[1],"--batch") == 0 && argc < 3))
 	{
 		std::cerr << "Usage: sudoku_solver <filename>" << std::endl;
+		std::cerr << "       sudoku_solver --batch <filename or - for stdin>" << std::endl;
 		return 0;
 	}
 
+	if(strcmp(argv[1],"--batch") == 0)
+		return SolveBatchFile(argv[2]);
+
 	Game game;
 	if(!LoadFromFile(argv[1],game))
 		return -1;
@@ -10,11 +10,14 @@
 // except according to those terms.
 
 #include <algorithm>
+#include <functional>
 #include <iostream>
 #include <random>
 #include <tuple>
 #include <cassert>
 #include <cmath>
+#include <cstdlib>
+#include <cstring>
 #include <ft2build.h>
 #include FT_FREETYPE_H
 #ifdef __linux
@@ -25,12 +28,16 @@
 #include <GLFW/glfw3.h>
 #include "CachedPuzzleSolver.h"
 #include "Camera.h"
+#include "DeltaTimer.h"
 #include "Geometry.h"
 #include "Image.h"
 #include "ImageProcessing.h"
 #include "NeuralNetwork.h"
+#include "NeuralNetworkData.h"
+#include "NeuralNetworkKernels.h"
 #include "Painter.h"
 #include "PuzzleFinder.h"
+#include "QuantizedNeuralNetwork.h"
 
 static constexpr unsigned int PUZZLE_IMAGE_WIDTH = 144;
 static constexpr unsigned int PUZZLE_IMAGE_HEIGHT = PUZZLE_IMAGE_WIDTH;
@@ -43,6 +50,8 @@ static constexpr char PUZZLE_SOLUTION_FONT[] = "C:/Windows/Fonts/times.ttf";
 #else
 #error Platform not supported
 #endif
+static constexpr char SOLUTION_STORE_BASE_PATH[] = "solutions"; //Creates solutions.log and solutions.idx.
+static constexpr char TRAINING_SAMPLES_FILE_PATH[] = "training_samples.dat"; //Written by --export-samples for train_neural_network.
 
 static bool drawCanny = true;
 static bool drawLines = false;
@@ -50,6 +59,7 @@ static bool drawLineClusters = false;
 static bool drawPossiblePuzzleLineClusters = false;
 static bool drawHoughTransform = false;
 static bool drawRandomPuzzle = false;
+static bool useQuantizedNetwork = false;
 
 void CheckGLError()
 {
@@ -178,29 +188,31 @@ void DrawLineClusters(Painter& painter,const float x,const float y,const float w
 	}
 }
 
-void DrawHoughTransform(Painter& painter,const float windowWidth,const float windowHeight,const Image& houghTransformFrame,const float scale)
+void DrawHoughTransform(Painter& painter,const float windowWidth,const float windowHeight,const Image<Gray16>& houghTransformFrame,const float scale)
 {
 	//Find maximum hough transform value.
 	unsigned short maximumValue = 0;
-	for(unsigned int x = 0;x < houghTransformFrame.width * houghTransformFrame.height;x++)
+	for(unsigned int y = 0;y < houghTransformFrame.height;y++)
 	{
-		const unsigned int index = x * 3;
-		const unsigned short value = *reinterpret_cast<const unsigned short*>(&houghTransformFrame.data[index]);
-		maximumValue = std::max(maximumValue,value);
+		const unsigned short* row = houghTransformFrame.Row(y);
+		for(unsigned int x = 0;x < houghTransformFrame.width;x++)
+		{
+			maximumValue = std::max(maximumValue,row[x]);
+		}
 	}
 
-	Image modifiedHTF = houghTransformFrame;
-
 	//Rescale hough transform into a 0-255 greyscale image so it can be displayed.
+	Image<Gray8> modifiedHTF;
+	modifiedHTF.MatchSize(houghTransformFrame);
 	const float multiplier = 255.0f / static_cast<float>(maximumValue);
-	for(unsigned int x = 0;x < houghTransformFrame.width * houghTransformFrame.height;x++)
+	for(unsigned int y = 0;y < houghTransformFrame.height;y++)
 	{
-		const unsigned int index = x * 3;
-		const unsigned char value = static_cast<float>(*reinterpret_cast<const unsigned short*>(&houghTransformFrame.data[index])) * multiplier;
-
-		modifiedHTF.data[index + 0] = value;
-		modifiedHTF.data[index + 1] = value;
-		modifiedHTF.data[index + 2] = value;
+		const unsigned short* input = houghTransformFrame.Row(y);
+		unsigned char* output = modifiedHTF.Row(y);
+		for(unsigned int x = 0;x < houghTransformFrame.width;x++)
+		{
+			output[x] = static_cast<float>(input[x]) * multiplier;
+		}
 	}
 
 	//Draw hough transform in the lower right corner of window.
@@ -211,7 +223,7 @@ void DrawHoughTransform(Painter& painter,const float windowWidth,const float win
 					  modifiedHTF);
 }
 
-void FitImage(const unsigned int windowWidth,const unsigned int windowHeight,const Image& image,unsigned int& x,unsigned int& y,unsigned int& width,unsigned int& height)
+void FitImage(const unsigned int windowWidth,const unsigned int windowHeight,const Image<RGB8>& image,unsigned int& x,unsigned int& y,unsigned int& width,unsigned int& height)
 {
 	const float hRatio = static_cast<float>(image.width) / static_cast<float>(windowWidth);
 	const float vRatio = static_cast<float>(image.height) / static_cast<float>(windowHeight);
@@ -223,7 +235,7 @@ void FitImage(const unsigned int windowWidth,const unsigned int windowHeight,con
 	y = abs(static_cast<int>(windowHeight) - static_cast<int>(height)) / 2;
 }
 
-void GeneratePlaceholderAnswerImage(Image& image)
+void GeneratePlaceholderAnswerImage(Image<Gray8>& image)
 {
 	constexpr unsigned int IMAGE_WIDTH = 600;
 	constexpr unsigned int IMAGE_HEIGHT = 600;
@@ -232,22 +244,14 @@ void GeneratePlaceholderAnswerImage(Image& image)
 	constexpr float DX = ((IMAGE_WIDTH / 9.0f) - BOX_WIDTH) / 2.0f;
 	constexpr float DY = ((IMAGE_HEIGHT / 9.0f) - BOX_HEIGHT) / 2.0f;
 
-	image.width = IMAGE_WIDTH;
-	image.height = IMAGE_HEIGHT;
-	image.data.resize(image.width * image.height * 3);
+	image.Resize(IMAGE_WIDTH,IMAGE_HEIGHT);
 	std::fill(image.data.begin(),image.data.end(),255);
 
 	auto DrawBox = [&](const unsigned int x,const unsigned int y,const unsigned int width,const unsigned int height)
 	{
 		for(unsigned int v = y;v < y + height;v++)
 		{
-			for(unsigned int h = x;h < x + width;h++)
-			{
-				const unsigned int index = (v * image.width + h) * 3;
-				image.data[index + 0] = 16;
-				image.data[index + 1] = 16;
-				image.data[index + 2] = 16;
-			}
+			std::fill(image.Row(v) + x,image.Row(v) + x + width,16);
 		}
 	};
 
@@ -260,7 +264,7 @@ void GeneratePlaceholderAnswerImage(Image& image)
 	}
 }
 
-static void RenderPuzzle(Painter& painter,const std::string& font,const unsigned int fontSize,const std::vector<unsigned char>& digits,Image& image)
+static void RenderPuzzle(Painter& painter,const std::string& font,const unsigned int fontSize,const std::vector<unsigned char>& digits,Image<Gray8>& image)
 {
 	auto DrawBitmapCentered = [&image](unsigned int offsetX,unsigned int offsetY,const unsigned int targetWidth,const unsigned int targetHeight,FT_Bitmap& bitmap)
 	{
@@ -269,21 +273,17 @@ static void RenderPuzzle(Painter& painter,const std::string& font,const unsigned
 
 		for(unsigned int y = 0;y < bitmap.rows;y++)
 		{
+			const unsigned char* input = &bitmap.buffer[y * bitmap.pitch];
+			unsigned char* output = image.Row(y + offsetY) + offsetX;
 			for(unsigned int x = 0;x < bitmap.width;x++)
 			{
-				const unsigned int inputIndex = (y * bitmap.pitch) + x;
-				const unsigned int outputIndex = ((y + offsetY) * image.width + x + offsetX) * 3;
-				image.data[outputIndex + 0] = 255 - bitmap.buffer[inputIndex];
-				image.data[outputIndex + 1] = 255 - bitmap.buffer[inputIndex];
-				image.data[outputIndex + 2] = 255 - bitmap.buffer[inputIndex];
+				output[x] = 255 - input[x];
 			}
 		}
 	};
 
 	assert(digits.size() == 9*9);
-	image.width = 600;
-	image.height = 600;
-	image.data.resize(image.width * image.height * 3);
+	image.Resize(600,600);
 	std::fill(image.data.begin(),image.data.end(),255);
 
 	FT_Library ftLibrary;
@@ -316,11 +316,11 @@ static void RenderPuzzle(Painter& painter,const std::string& font,const unsigned
 	FT_Done_FreeType(ftLibrary);
 }
 
-static void ExtractPuzzleTiles(const Image& image,std::vector<Image>& tiles)
+static void ExtractPuzzleTiles(const Image<Gray8>& image,std::vector<Image<Gray8>>& tiles)
 {
 	auto ExtractImage = [&image](const unsigned int x,const unsigned int y,unsigned int width,unsigned int height)
 	{
-		Image extractedImage(width,height);
+		Image<Gray8> extractedImage(width,height);
 		std::fill(extractedImage.data.begin(),extractedImage.data.end(),255);
 
 		assert(x < image.width);
@@ -328,12 +328,9 @@ static void ExtractPuzzleTiles(const Image& image,std::vector<Image>& tiles)
 		width = std::min(width,image.width - x);
 		height = std::min(height,image.height - y);
 
-		const unsigned int span = width * 3;
 		for(unsigned int row = 0;row < height;row++)
 		{
-			const unsigned int inputIndex = (((row + y) * image.width) + x) * 3;
-			const unsigned int outputIndex = row * extractedImage.width * 3;
-			memcpy(&extractedImage.data[outputIndex],&image.data[inputIndex],span);
+			memcpy(extractedImage.Row(row),image.Row(row + y) + x,width);
 		}
 
 		return extractedImage;
@@ -349,65 +346,60 @@ static void ExtractPuzzleTiles(const Image& image,std::vector<Image>& tiles)
 	{
 		for(unsigned int x = 0;x < 9;x++)
 		{
-			const Image image = ExtractImage(x * dx,y * dy,dx,dy);
-			tiles.push_back(image);
+			tiles.push_back(ExtractImage(x * dx,y * dy,dx,dy));
 		}
 	}
 }
 
-static void MergePuzzleTiles(Image& image,const std::vector<Image>& tiles)
+static void MergePuzzleTiles(Image<Gray8>& image,const std::vector<Image<Gray8>>& tiles)
 {
 	assert(tiles.size() == 81);
 
-	image.width = tiles[0].width * 9;
-	image.height = tiles[0].height * 9;
-	image.data.resize(image.width * image.height * 3);
+	image.Resize(tiles[0].width * 9,tiles[0].height * 9);
 
 	for(unsigned int y = 0;y < 9;y++)
 	{
 		for(unsigned int x = 0;x < 9;x++)
 		{
 			const unsigned int tileIndex = y * 9 + x;
-			const Image& tileImage = tiles[tileIndex];
+			const Image<Gray8>& tileImage = tiles[tileIndex];
 
-			const unsigned int span = tileImage.width * 3;
 			for(unsigned int row = 0;row < tileImage.height;row++)
 			{
-				const unsigned int inputIndex = row * tileImage.width * 3;
-				const unsigned int outputIndex = (((row + y * tileImage.height) * image.width) + x * tileImage.width) * 3;
-				memcpy(&image.data[outputIndex],&tileImage.data[inputIndex],span);
+				memcpy(image.Row(row + y * tileImage.height) + x * tileImage.width,tileImage.Row(row),tileImage.width);
 			}
 		}
 	}
 }
 
-static void PreprocessNeuralNetworkImage(Image& image,const float a,const unsigned char binaryHigh)
+static void PreprocessNeuralNetworkImage(Image<Gray8>& image,const float a,const unsigned char binaryHigh)
 {
 	if(image.width == 0 || image.height == 0)
 		return;
 
 	//Compute the global mean.
 	float globalMean = 0.0f;
-	for(unsigned int x = 0;x < image.width * image.height;x++)
+	for(unsigned int y = 0;y < image.height;y++)
 	{
-		const unsigned int index = x * 3;
-		globalMean += image.data[index];
+		const unsigned char* row = image.Row(y);
+		for(unsigned int x = 0;x < image.width;x++)
+		{
+			globalMean += row[x];
+		}
 	}
 	globalMean /= static_cast<float>(image.width * image.height);
 
-	//Helper function to get the (greyscale) pixel from an image with the edges clamped to the
-	//nearest pixel.
+	//Helper function to get the pixel from an image with the edges clamped to the nearest pixel.
 	auto GetPixel = [&image](int x,int y)
 	{
 		x = std::min(std::max(0,x),static_cast<int>(image.width) - 1);
 		y = std::min(std::max(0,y),static_cast<int>(image.height) - 1);
-		const unsigned int index = (y * image.width + x) * 3;
-		return image.data[index];
+		return image.Row(y)[x];
 	};
 
 	//Localized thresholding using local standard deviation and global mean. It works well for
 	//solid backgrounds like our digits. The "a" and "b" factors are found through experimentation.
-	Image outputImage;
+	Image<Gray8> outputImage;
 	outputImage.MatchSize(image);
 	float pixels[9];
 	constexpr float b = 0.95f;
@@ -435,25 +427,13 @@ static void PreprocessNeuralNetworkImage(Image& image,const float a,const unsign
 			localVar /= 9.0f;
 			const float localStdDev = sqrtf(localVar);
 
-			const unsigned int index = (y * image.width + x) * 3;
-			if(pixels[4] > a * localStdDev && pixels[4] > b * globalMean)
-			{
-				outputImage.data[index + 0] = binaryHigh;
-				outputImage.data[index + 1] = binaryHigh;
-				outputImage.data[index + 2] = binaryHigh;
-			}
-			else
-			{
-				outputImage.data[index + 0] = 0;
-				outputImage.data[index + 1] = 0;
-				outputImage.data[index + 2] = 0;
-			}
+			outputImage.Row(y)[x] = pixels[4] > a * localStdDev && pixels[4] > b * globalMean ? binaryHigh : 0;
 		}
 	}
-	image = outputImage;
+	image = std::move(outputImage);
 }
 
-static void ShuffleEdgePixels(std::mt19937& randomNumberGenerator,Image& image,const unsigned char binaryHigh)
+static void ShuffleEdgePixels(std::mt19937& randomNumberGenerator,Image<Gray8>& image,const unsigned char binaryHigh)
 {
 	//Each edge pixel is given a random number using keepPixelDist(). If it's greater than the
 	//randomly selected V, the pixel will be copied to a random neighbor's pixel and then the
@@ -469,16 +449,17 @@ static void ShuffleEdgePixels(std::mt19937& randomNumberGenerator,Image& image,c
 	//Threshold used to determine if a pixel is an edge. Generally an edge is anything not zero.
 	const float laplaceThreshold = 0.1f * static_cast<float>(binaryHigh);
 
-	Image tempImage = image;
-	const unsigned int rowSpan = tempImage.width * 3;
+	const Image<Gray8> tempImage = image;
 	for(unsigned int y = 1;y < tempImage.height - 1;y++)
 	{
+		const unsigned char* above = tempImage.Row(y - 1);
+		const unsigned char* center = tempImage.Row(y);
+		const unsigned char* below = tempImage.Row(y + 1);
 		for(unsigned int x = 1;x < tempImage.width - 1;x++)
 		{
-			const unsigned int inputIndex = (y * tempImage.width + x) * 3;
-			const float laplace = static_cast<float>(tempImage.data[inputIndex - rowSpan]) +
-								  static_cast<float>(tempImage.data[inputIndex - 3])       + static_cast<float>(tempImage.data[inputIndex + 3]) * -4.0f + static_cast<float>(tempImage.data[inputIndex + 3]) +
-								  static_cast<float>(tempImage.data[inputIndex + rowSpan]);
+			const float laplace = static_cast<float>(above[x]) +
+								  static_cast<float>(center[x - 1]) + static_cast<float>(center[x + 1]) * -4.0f + static_cast<float>(center[x + 1]) +
+								  static_cast<float>(below[x]);
 			if(fabsf(laplace) > laplaceThreshold)
 			{
 				if(keepPixelDist(randomNumberGenerator) > V)
@@ -486,48 +467,71 @@ static void ShuffleEdgePixels(std::mt19937& randomNumberGenerator,Image& image,c
 					//Move pixel value to a neighbor spot.
 					const int newX = x + -1 + 2 * newPosDist(randomNumberGenerator);
 					const int newY = y + -1 + 2 * newPosDist(randomNumberGenerator);
-					const unsigned int otherIndex = (newY * tempImage.width + newX) * 3;
-					image.data[otherIndex + 0] = image.data[inputIndex + 0];
-					image.data[otherIndex + 1] = image.data[inputIndex + 1];
-					image.data[otherIndex + 2] = image.data[inputIndex + 2];
+					unsigned char& pixel = image.Row(y)[x];
+					image.Row(newY)[newX] = pixel;
 
 					//Invert pixel.
-					image.data[inputIndex + 0] = abs(static_cast<int>(binaryHigh) - static_cast<int>(image.data[inputIndex + 0]));
-					image.data[inputIndex + 1] = abs(static_cast<int>(binaryHigh) - static_cast<int>(image.data[inputIndex + 1]));
-					image.data[inputIndex + 2] = abs(static_cast<int>(binaryHigh) - static_cast<int>(image.data[inputIndex + 2]));
+					pixel = abs(static_cast<int>(binaryHigh) - static_cast<int>(pixel));
 				}
 			}
 		}
 	}
 }
 
-std::vector<unsigned char> ImageToData(const Image& image)
+std::vector<unsigned char> ImageToData(const Image<Gray8>& image)
 {
-	//Assumes image is greyscale and just copies red-channel to data.
 	std::vector<unsigned char> data(image.width * image.height);
-	for(unsigned int x = 0;x < image.width * image.height;x++)
+	for(unsigned int y = 0;y < image.height;y++)
 	{
-		data[x] = image.data[x * 3];
+		memcpy(&data[y * image.width],image.Row(y),image.width);
 	}
 
 	return data;
 }
 
-static void ExtractDigits(NeuralNetwork& nn,const Image& puzzleImage,std::vector<unsigned char>& digits)
+static PackedInput ImageToPackedInput(const Image<Gray8>& image)
+{
+	//Assumes image is binary and sets a bit for every non-zero pixel.
+	PackedInput bits((image.width * image.height + 63) / 64,0);
+	for(unsigned int y = 0;y < image.height;y++)
+	{
+		const unsigned char* row = image.Row(y);
+		for(unsigned int x = 0;x < image.width;x++)
+		{
+			const unsigned int index = y * image.width + x;
+			if(row[x] != 0)
+				bits[index / 64] |= static_cast<uint64_t>(1) << (index % 64);
+		}
+	}
+
+	return bits;
+}
+
+static void ExtractDigits(NeuralNetwork& nn,const QuantizedNeuralNetwork& quantizedNN,const Image<Gray8>& puzzleImage,std::vector<unsigned char>& digits)
 {
 	digits.clear();
 
-	std::vector<Image> puzzleTiles;
+	//Tiles are binary after preprocessing so they're passed to the network as bits.
+	std::vector<Image<Gray8>> puzzleTiles;
 	ExtractPuzzleTiles(puzzleImage,puzzleTiles);
+	std::vector<PackedInput> tileBits;
 	for(unsigned int x = 0;x < puzzleTiles.size();x++)
 	{
 		PreprocessNeuralNetworkImage(puzzleTiles[x],2.0f,1);
-		const unsigned char digit = nn.Run(ImageToData(puzzleTiles[x]));
-		digits.push_back(digit);
+		tileBits.push_back(ImageToPackedInput(puzzleTiles[x]));
 	}
+	if(tileBits.empty())
+		return;
+
+	//Read every tile at once. It's much faster than one at a time.
+	const unsigned int tileSize = puzzleTiles[0].width * puzzleTiles[0].height;
+	if(useQuantizedNetwork && !quantizedNN.Empty())
+		quantizedNN.RunBatch(tileBits,tileSize,digits);
+	else
+		nn.RunBatch(tileBits,tileSize,digits);
 }
 
-static void GenerateRandomPuzzle(Painter& painter,std::mt19937& randomNumberGenerator,Image& puzzleImage,std::vector<unsigned char>& digits,const unsigned int binaryHigh)
+static void GenerateRandomPuzzle(Painter& painter,std::mt19937& randomNumberGenerator,Image<Gray8>& puzzleImage,std::vector<unsigned char>& digits,const unsigned int binaryHigh)
 {
 	//Select a random font.
 	const std::vector<std::string> fonts = {
@@ -569,7 +573,7 @@ static void GenerateRandomPuzzle(Painter& painter,std::mt19937& randomNumberGene
 	RenderPuzzle(painter,font,fontSizeDist(randomNumberGenerator),digits,puzzleImage);
 
 	//Draw a border and grid.
-	Image srcImage = puzzleImage;
+	Image<Gray8> srcImage = puzzleImage;
 	painter.DrawPuzzleGrid(srcImage,
 						   16.0f, //Border line width (px).
 						   4.0f, //Grid minor line width (px).
@@ -594,51 +598,124 @@ static void GenerateRandomPuzzle(Painter& painter,std::mt19937& randomNumberGene
 	ShuffleEdgePixels(randomNumberGenerator,puzzleImage,binaryHigh);
 }
 
-static NeuralNetwork PrepareOCRNeuralNetwork(Painter& painter)
+//Render a random puzzle and split it into labelled tiles. Each puzzle is processed with noise to
+//help improve training results.
+static void GenerateTrainingSamples(Painter& painter,std::mt19937& randomNumberGenerator,std::vector<std::pair<std::vector<unsigned char>,unsigned char>>& samples)
+{
+	Image<Gray8> puzzleImage;
+	std::vector<unsigned char> digits;
+	GenerateRandomPuzzle(painter,randomNumberGenerator,puzzleImage,digits,1);
+
+	std::vector<Image<Gray8>> puzzleTiles;
+	ExtractPuzzleTiles(puzzleImage,puzzleTiles);
+	for(unsigned int x = 0;x < puzzleTiles.size();x++)
+	{
+		samples.push_back({ImageToData(puzzleTiles[x]),digits[x]});
+	}
+}
+
+//Save the tiles of puzzleCount random puzzles, along with a new untrained network sized for them,
+//for train_neural_network to train on.
+static bool ExportTrainingSamples(Painter& painter,const unsigned int puzzleCount)
 {
 	std::random_device randomDevice;
 	std::mt19937 randomNumberGenerator(randomDevice());
 
-	//Render a bunch of random puzzles using the following fonts. Each puzzle is processed with
-	//noise to help improve training results.
-	auto GenerateSampleData = [&painter,&randomNumberGenerator]()
+	std::vector<std::pair<std::vector<unsigned char>,unsigned char>> samples;
+	samples.reserve(puzzleCount * 81);
+	for(unsigned int x = 0;x < puzzleCount;x++)
 	{
-		std::vector<std::pair<std::vector<unsigned char>,unsigned char>> data;
-		for(unsigned int x = 0;x < 3000;x++)
-		{
-			Image puzzleImage;
-			std::vector<unsigned char> digits;
-			GenerateRandomPuzzle(painter,randomNumberGenerator,puzzleImage,digits,1);
+		GenerateTrainingSamples(painter,randomNumberGenerator,samples);
+	}
 
-			std::vector<Image> puzzleTiles;
-			ExtractPuzzleTiles(puzzleImage,puzzleTiles);
-			for(unsigned int x = 0;x < puzzleTiles.size();x++)
-			{
-				data.push_back({ImageToData(puzzleTiles[x]),digits[x]});
-			}
-		}
+	NeuralNetworkData data;
+	data.InitializeWithTrainingData(samples);
+	if(!data.SaveAsBinary(TRAINING_SAMPLES_FILE_PATH))
+		return false;
 
-		return data;
+	std::cout << "Saved " << samples.size() << " training samples to " << TRAINING_SAMPLES_FILE_PATH << std::endl;
+	return true;
+}
+
+static NeuralNetwork PrepareOCRNeuralNetwork(Painter& painter,QuantizedNeuralNetwork& quantizedNN)
+{
+	std::random_device randomDevice;
+	std::mt19937 randomNumberGenerator(randomDevice());
+	auto GenerateSamples = [&painter,&randomNumberGenerator](std::vector<std::pair<std::vector<unsigned char>,unsigned char>>& samples)
+	{
+		GenerateTrainingSamples(painter,randomNumberGenerator,samples);
 	};
 
 	//Train neural network. It will likely take along time unless a pre-trained network is detected
-	//and loaded from file.
-	NeuralNetwork nn = NeuralNetwork::Train([&GenerateSampleData,&randomNumberGenerator](std::vector<std::pair<std::vector<unsigned char>,unsigned char>>& trainingData) {
-		trainingData = GenerateSampleData();
-
-		//Randomize puzzle tiles so NN doesn't over train to a specific font.
-		std::shuffle(trainingData.begin(),trainingData.end(),randomNumberGenerator);
-	});
-
-	//Measure how accurate the NN is.
-	const std::vector<std::pair<std::vector<unsigned char>,unsigned char>> testData = GenerateSampleData();
-	unsigned int correct = 0;
-	for(const auto& td : testData)
+	//and loaded from file. Puzzles are rendered here, on the OpenGL thread, while training runs on
+	//another. Each epoch sees the tiles of 3000 new puzzles.
+	constexpr unsigned int PUZZLES_PER_EPOCH = 3000;
+	NeuralNetwork nn = NeuralNetwork::Train({0,1,2,3,4,5,6,7,8,9},PUZZLES_PER_EPOCH * 81,GenerateSamples);
+
+	quantizedNN = nn.Quantize();
+
+	//Measure how accurate the NN and its quantized copy are on the same data. Tiles are rendered
+	//a batch at a time and each batch is read at once so every core gets a share.
+	struct Measurement
+	{
+		const char* name;
+		std::function<void(const std::vector<std::vector<unsigned char>>&,std::vector<unsigned char>&)> runBatch;
+		unsigned int correct;
+		double seconds;
+	};
+	std::vector<Measurement> measurements;
+	measurements.push_back({"Neural network",[&nn](const std::vector<std::vector<unsigned char>>& inputs,std::vector<unsigned char>& outputs) {
+		nn.RunBatch(inputs,outputs);
+	},0,0.0});
+	if(!quantizedNN.Empty())
+	{
+		measurements.push_back({"Quantized neural network",[&quantizedNN](const std::vector<std::vector<unsigned char>>& inputs,std::vector<unsigned char>& outputs) {
+			quantizedNN.RunBatch(inputs,outputs);
+		},0,0.0});
+	}
+
+	constexpr unsigned int TEST_PUZZLES_PER_BATCH = 12; //972 tiles.
+	unsigned int testCount = 0;
+	std::vector<std::pair<std::vector<unsigned char>,unsigned char>> testData;
+	std::vector<std::vector<unsigned char>> batchInputs;
+	std::vector<unsigned char> batchOutputs;
+	DeltaTimer deltaTimer;
+	for(unsigned int x = 0;x < PUZZLES_PER_EPOCH;x += TEST_PUZZLES_PER_BATCH)
+	{
+		testData.clear();
+		for(unsigned int y = x;y < std::min(x + TEST_PUZZLES_PER_BATCH,PUZZLES_PER_EPOCH);y++)
+		{
+			GenerateSamples(testData);
+		}
+		batchInputs.clear();
+		for(const std::pair<std::vector<unsigned char>,unsigned char>& sample : testData)
+		{
+			batchInputs.push_back(sample.first);
+		}
+		testCount += testData.size();
+
+		for(Measurement& measurement : measurements)
+		{
+			deltaTimer.Update();
+			measurement.runBatch(batchInputs,batchOutputs);
+			deltaTimer.Update();
+			measurement.seconds += deltaTimer.Delta();
+			for(unsigned int y = 0;y < testData.size();y++)
+			{
+				if(batchOutputs[y] == testData[y].second)
+					measurement.correct += 1;
+			}
+		}
+	}
+	for(const Measurement& measurement : measurements)
 	{
-		if(nn.Run(td.first) == td.second)
-			correct += 1;
+		std::cout << measurement.name << " identified " << measurement.correct << " out of " << testCount << " in " << measurement.seconds << " sec(s)" << std::endl;
 	}
-	std::cout << "Identified " << correct << " out of " << testData.size() << std::endl;
+	if(!quantizedNN.Empty())
+		std::cout << "Quantized weights use " << quantizedNN.WeightBytes() << " bytes" << std::endl;
+	else
+		std::cout << "Neural network can't be quantized because a hidden layer doesn't use sigmoid" << std::endl;
+	std::cout << "Single tile inference is using " << DotProductInstructionSet() << " (" << Int8DotProductInstructionSet() << " when quantized)" << std::endl;
 
 	return nn;
 }
@@ -662,6 +739,8 @@ void OnKey(GLFWwindow* window,int key,int scancode,int action,int mode)
 		drawPossiblePuzzleLineClusters = !drawPossiblePuzzleLineClusters;
 	else if(key == GLFW_KEY_5)
 		drawRandomPuzzle = !drawRandomPuzzle;
+	else if(key == GLFW_KEY_6)
+		useQuantizedNetwork = !useQuantizedNetwork;
 }
 
 #ifdef __linux
@@ -670,11 +749,25 @@ int main(int argc,char* argv[])
 int __stdcall WinMain(void*,void*,void*,int)
 #endif
 {
+	//Samples for train_neural_network are rendered with OpenGL so they're exported from here with
+	//"--export-samples <puzzle count>". The window stays hidden then.
+	unsigned int exportPuzzleCount = 0;
+#ifdef __linux
+	if(argc == 3 && strcmp(argv[1],"--export-samples") == 0)
+		exportPuzzleCount = strtoul(argv[2],nullptr,10);
+	if(argc != 1 && exportPuzzleCount == 0)
+	{
+		std::cerr << "Usage: " << argv[0] << " [--export-samples <puzzle count>]" << std::endl;
+		return -1;
+	}
+#endif
+
 	glfwInit();
 	glfwWindowHint(GLFW_CLIENT_API,GLFW_OPENGL_ES_API);
 	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR,3);
 	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR,0);
 	glfwWindowHint(GLFW_RESIZABLE,GL_FALSE);
+	glfwWindowHint(GLFW_VISIBLE,exportPuzzleCount == 0 ? GL_TRUE : GL_FALSE);
 
 	GLFWwindow* window = glfwCreateWindow(800 + PUZZLE_DISPLAY_WIDTH,600,"Sudoku Solver AR",nullptr,nullptr);
 	assert(window != nullptr);
@@ -690,21 +783,30 @@ int __stdcall WinMain(void*,void*,void*,int)
 	glfwGetFramebufferSize(window,&windowWidth,&windowHeight);
 
 	Painter painter;
-	NeuralNetwork nn = PrepareOCRNeuralNetwork(painter);
+	if(exportPuzzleCount != 0)
+	{
+		const bool exported = ExportTrainingSamples(painter,exportPuzzleCount);
+		glfwTerminate();
+		return exported ? 0 : -1;
+	}
+
+	QuantizedNeuralNetwork quantizedNN;
+	NeuralNetwork nn = PrepareOCRNeuralNetwork(painter,quantizedNN);
 	Camera camera = Camera::Open("/dev/video0").value();
-	Image frame;
-	Image downscaledFrame;
-	Image* inputFrame = &frame;
-	Image greyscaleFrame;
-	Image cannyFrame;
+	Image<RGB8> frame;
+	Image<RGB8> downscaledFrame;
+	Image<RGB8>* inputFrame = &frame;
+	Image<Gray8> greyscaleFrame;
+	Image<Gray8> cannyFrame;
 	Canny canny = Canny::WithRadius(5.0f);
-	Image mergedFrame;
-	Image houghTransformFrame;
-	Image puzzleFrame;
-	Image displayPuzzleFrame;
-	Image solutionImage;
+	Image<RGB8> mergedFrame;
+	Image<Gray16> houghTransformFrame;
+	Image<Gray8> puzzleFrame;
+	Image<Gray8> displayPuzzleFrame;
+	Image<Gray8> solutionImage;
+	Image<RGB8> solutionOverlay;
 	PuzzleFinder puzzleFinder;
-	CachedPuzzleSolver puzzleSolver;
+	CachedPuzzleSolver puzzleSolver(SOLUTION_STORE_BASE_PATH);
 
 	while(!glfwWindowShouldClose(window))
 	{
@@ -729,6 +831,7 @@ int __stdcall WinMain(void*,void*,void*,int)
 			inputFrame = &frame;
 
 		//Process frame.
+		assert(inputFrame->Packed());
 		greyscaleFrame.MatchSize(*inputFrame);
 		RGBToGreyscale(&inputFrame->data[0],greyscaleFrame);
 		canny.Process(greyscaleFrame,cannyFrame);
@@ -752,9 +855,9 @@ int __stdcall WinMain(void*,void*,void*,int)
 								 PUZZLE_IMAGE_WIDTH,
 								 PUZZLE_IMAGE_HEIGHT);
 
-			std::vector<Image> puzzleTiles;
+			std::vector<Image<Gray8>> puzzleTiles;
 			ExtractPuzzleTiles(puzzleFrame,puzzleTiles);
-			for(Image& puzzleTile : puzzleTiles)
+			for(Image<Gray8>& puzzleTile : puzzleTiles)
 			{
 				PreprocessNeuralNetworkImage(puzzleTile,2.0f,255);
 			}
@@ -774,7 +877,7 @@ int __stdcall WinMain(void*,void*,void*,int)
 			//Cut puzzle into 9x9 chunks and run neural network on each to extract the respective
 			//digit.
 			std::vector<unsigned char> digits;
-			ExtractDigits(nn,puzzleFrame,digits);
+			ExtractDigits(nn,quantizedNN,puzzleFrame,digits);
 
 			//Render the solution puzzle to a texture. It might fail if the puzzle doesn't have a
 			//solution or if the neural network made a mistake reading the digits. Then, the most
@@ -802,14 +905,19 @@ int __stdcall WinMain(void*,void*,void*,int)
 			//Preprocess they greyscale image (with black text on a white background) so the
 			//numbers are green. This is part of a trick where we draw the image twice using
 			//blending so we don't have to add an alpha channel.
-			for(unsigned int x = 0;x < solutionImage.width * solutionImage.height;x++)
+			solutionOverlay.MatchSize(solutionImage);
+			for(unsigned int y = 0;y < solutionImage.height;y++)
 			{
-				const unsigned int index = x * 3;
-				const unsigned char value = 255 - solutionImage.data[index];
-				const unsigned char invertedValue = 255 - value;
-				solutionImage.data[index + 0] = invertedValue;
-				solutionImage.data[index + 1] = value;
-				solutionImage.data[index + 2] = invertedValue;
+				const unsigned char* input = solutionImage.Row(y);
+				unsigned char* output = solutionOverlay.Row(y);
+				for(unsigned int x = 0;x < solutionImage.width;x++)
+				{
+					const unsigned char value = 255 - input[x];
+					const unsigned char invertedValue = 255 - value;
+					output[x * 3 + 0] = invertedValue;
+					output[x * 3 + 1] = value;
+					output[x * 3 + 2] = invertedValue;
+				}
 			}
 
 			//Render the solution texture right over the original puzzle.
@@ -824,12 +932,12 @@ int __stdcall WinMain(void*,void*,void*,int)
 			glColorMask(GL_FALSE,GL_TRUE,GL_FALSE,GL_FALSE);
 			glBlendEquationSeparate(GL_MAX,GL_MAX);
 			glBlendFuncSeparate(GL_ONE,GL_ONE,GL_ONE,GL_ZERO);
-			painter.DrawImage(puzzlePoints[0],puzzlePoints[1],puzzlePoints[2],puzzlePoints[3],solutionImage);
+			painter.DrawImage(puzzlePoints[0],puzzlePoints[1],puzzlePoints[2],puzzlePoints[3],solutionOverlay);
 
 			glColorMask(GL_TRUE,GL_FALSE,GL_TRUE,GL_FALSE);
 			glBlendEquationSeparate(GL_MIN,GL_MAX);
 			glBlendFuncSeparate(GL_ONE,GL_ONE,GL_ONE,GL_ZERO);
-			painter.DrawImage(puzzlePoints[0],puzzlePoints[1],puzzlePoints[2],puzzlePoints[3],solutionImage);
+			painter.DrawImage(puzzlePoints[0],puzzlePoints[1],puzzlePoints[2],puzzlePoints[3],solutionOverlay);
 
 			glDisable(GL_BLEND);
 			glColorMask(GL_TRUE,GL_TRUE,GL_TRUE,GL_TRUE);
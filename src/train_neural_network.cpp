@@ -0,0 +1,142 @@
+// Copyright 2017 James Bendig. See the COPYRIGHT file at the top-level
+// directory of this distribution.
+//
+// Licensed under:
+//   the MIT license
+//     <LICENSE-MIT or https://opensource.org/licenses/MIT>
+//   or the Apache License, Version 2.0
+//     <LICENSE-APACHE or https://www.apache.org/licenses/LICENSE-2.0>,
+// at your option. This file may not be copied, modified, or distributed
+// except according to those terms.
+
+
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <string>
+#ifdef USE_CUDA_TRAINER
+#include "CUDATrainer.h"
+#endif
+#include "MiniBatchTrainer.h"
+#include "NeuralNetworkData.h"
+#include "NeuralNetworkKernels.h"
+#include "TrainingCheckpoint.h"
+
+
+//Offline trainer for the samples exported by "sudoku_solver_ar --export-samples <puzzle count>".
+//Samples saved in the training data file by older versions are used when nothing was exported.
+//Progress is saved to a separate checkpoint, and resumed from it, so the samples are never
+//rewritten. Both backends read and write the same checkpoint so training can move between machines
+//with and without a GPU.
+//
+//Usage: train_neural_network [--cpu | --cuda]
+//Defaults to CUDA when it was built in and a device is present, otherwise the CPU. The CPU
+//backend uses every core unless OMP_NUM_THREADS says otherwise.
+
+static const char* TRAINING_SAMPLES_FILE_PATH = "training_samples.dat";
+static const char* TRAINING_DATA_FILE_PATH = "training.dat"; //Only read for samples saved by older versions.
+static const char* TRAINING_CHECKPOINT_FILE_PATH = "training_checkpoint.dat";
+
+enum class Backend
+{
+	Default,
+	CPU,
+	CUDA,
+};
+
+static unsigned long long Milliseconds()
+{
+	return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static int TrainWithCPU(NeuralNetworkData& nnData,const TrainingCheckpoint& resumeCheckpoint,CheckpointWriter& checkpointWriter)
+{
+	std::cout << "Training on the CPU using " << DotProductInstructionSet() << std::endl;
+
+	MiniBatchTrainer trainer(nnData,MiniBatchTrainer::Settings());
+	trainer.Restore(resumeCheckpoint);
+	for(unsigned int x = 0;x < 1001;x++)
+	{
+		const auto startMS = Milliseconds();
+		const float totalError = trainer.TrainEpoch();
+		std::cout << "Training " << x << " took " << (Milliseconds() - startMS) << " ms with error " << totalError << std::endl;
+
+		if(totalError < 1.0f || ((x % 100) == 0 && x != 0))
+		{
+			const auto checkpointStartMS = Milliseconds();
+			TrainingCheckpoint checkpoint;
+			trainer.Snapshot(checkpoint);
+			checkpointWriter.Write(std::move(checkpoint));
+			std::cout << "Checkpointed in " << (Milliseconds() - checkpointStartMS) << " ms." << std::endl;
+		}
+	}
+
+	return 0;
+}
+
+int main(int argc,char* argv[])
+{
+	Backend backend = Backend::Default;
+	for(int x = 1;x < argc;x++)
+	{
+		if(strcmp(argv[x],"--cpu") == 0)
+			backend = Backend::CPU;
+		else if(strcmp(argv[x],"--cuda") == 0)
+			backend = Backend::CUDA;
+		else
+		{
+			std::cerr << "Usage: " << argv[0] << " [--cpu | --cuda]" << std::endl;
+			return -1;
+		}
+	}
+
+#ifdef USE_CUDA_TRAINER
+	if(backend == Backend::Default)
+		backend = CUDADeviceAvailable() ? Backend::CUDA : Backend::CPU;
+#else
+	if(backend == Backend::CUDA)
+	{
+		std::cerr << "train_neural_network was built without CUDA." << std::endl;
+		return -1;
+	}
+	backend = Backend::CPU;
+#endif
+
+	//Load the samples and the network they were saved with.
+	NeuralNetworkData nnData;
+	const char* samplesFilePath = TRAINING_SAMPLES_FILE_PATH;
+	if(!nnData.LoadFromBinary(samplesFilePath))
+	{
+		samplesFilePath = TRAINING_DATA_FILE_PATH;
+		if(!nnData.LoadFromBinary(samplesFilePath))
+		{
+			std::cerr << "Could not load " << TRAINING_SAMPLES_FILE_PATH << ". Export samples with \"sudoku_solver_ar --export-samples <puzzle count>\" first." << std::endl;
+			return -1;
+		}
+	}
+	if(nnData.trainingData.empty())
+	{
+		std::cerr << samplesFilePath << " has no training samples. Export them with \"sudoku_solver_ar --export-samples <puzzle count>\"." << std::endl;
+		return -1;
+	}
+	std::cout << "Training on " << nnData.trainingData.size() << " samples from " << samplesFilePath << std::endl;
+
+	//Continue from the last checkpoint when it's for the same network.
+	TrainingCheckpoint resumeCheckpoint;
+	if(resumeCheckpoint.Load(TRAINING_CHECKPOINT_FILE_PATH) && resumeCheckpoint.Matches(nnData))
+	{
+		std::cout << "Resuming from " << TRAINING_CHECKPOINT_FILE_PATH << std::endl;
+		resumeCheckpoint.RestoreWeights(nnData);
+	}
+
+	CheckpointWriter checkpointWriter(TRAINING_CHECKPOINT_FILE_PATH);
+#ifdef USE_CUDA_TRAINER
+	if(backend == Backend::CUDA)
+	{
+		return TrainWithCUDA(nnData,[&checkpointWriter](const NeuralNetworkData& data) {
+			checkpointWriter.Write(TrainingCheckpoint(data));
+		});
+	}
+#endif
+	return TrainWithCPU(nnData,resumeCheckpoint,checkpointWriter);
+}